@@ -0,0 +1,68 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      disk_cache.h
+ \brief     Sector cache between FatFs and the disk drivers
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ A set associative write back cache of single sectors, used by the
+ disk_read() / disk_write() / disk_ioctl() layer in vfs_conf.c.
+****************************************************************************/
+
+#ifndef _DISK_CACHE_H
+#define _DISK_CACHE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ff.h"
+#include "ff_gen_drv.h"
+
+
+// Number of cached sectors and lines per set, the sectors a multiple of the ways
+#ifndef DISK_CACHE_SECTORS
+#define DISK_CACHE_SECTORS      64
+#endif
+#ifndef DISK_CACHE_WAYS
+#define DISK_CACHE_WAYS         4
+#endif
+
+// The sector data goes in SRAM2, see the .ram2 section of the linker scripts
+#ifndef DISK_CACHE_SECTION
+#define DISK_CACHE_SECTION      __attribute__((section(".ram2")))
+#endif
+
+#if (DISK_CACHE_SECTORS < DISK_CACHE_WAYS) || (DISK_CACHE_SECTORS % DISK_CACHE_WAYS)
+#error DISK_CACHE_SECTORS must be a multiple of DISK_CACHE_WAYS
+#endif
+
+
+typedef struct
+{
+    DWORD       hits;
+    DWORD       misses;
+    DWORD       bypassed;   // Multi sector transfers, straight to the drive
+    DWORD       writebacks;
+} DiskCacheStats_t;
+
+
+void     disk_cache_attach(BYTE pdrv, const Diskio_drvTypeDef* drv);
+DRESULT  disk_cache_read(BYTE pdrv, BYTE* buff, DWORD sector, UINT count);
+DRESULT  disk_cache_write(BYTE pdrv, const BYTE* buff, DWORD sector, UINT count);
+DRESULT  disk_cache_sync(BYTE pdrv);
+void     disk_cache_discard(BYTE pdrv, DWORD start, DWORD end);
+void     disk_cache_stats(BYTE pdrv, DiskCacheStats_t* stats);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*_DISK_CACHE_H */
@@ -0,0 +1,39 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      mtp_event.h
+ \brief     Events on the MTP interrupt endpoint
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ Unsolicited PTP events for the host, sent from the main loop through the
+ interrupt endpoint of the MTP class.
+****************************************************************************/
+
+#ifndef _MTP_EVENT_H
+#define _MTP_EVENT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+
+#define MTP_EC_StorageInfoChanged       0x400C
+
+
+int      mtp_event_send(uint16_t code, uint32_t param);
+int      mtp_event_storage_changed(int storage);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*_MTP_EVENT_H */
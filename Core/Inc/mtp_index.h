@@ -0,0 +1,108 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      mtp_index.h
+ \brief     Object handle index for the MTP responder
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ Maps MTP object handles to the location of their FatFs directory entry,
+ so handle based operations do not have to rebuild and follow a path.
+****************************************************************************/
+
+#ifndef _MTP_INDEX_H
+#define _MTP_INDEX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ff.h"
+#include "vfs_conf.h"
+#include "mtp_ring.h"
+
+
+// Number of cached handles, power of 2
+#ifndef MTP_INDEX_SIZE
+#define MTP_INDEX_SIZE          256
+#endif
+
+#if (MTP_INDEX_SIZE & (MTP_INDEX_SIZE - 1))
+#error MTP_INDEX_SIZE must be a power of 2
+#endif
+
+// Handle layout: | storage | folder | file |, file 0 is the folder itself
+#define MTP_HANDLE_FILE_BITS    (32 - INODE_STORAGE_BITS - INODE_FOLDER_BITS)
+#define MTP_HANDLE_STORAGES     (1 << INODE_STORAGE_BITS)
+#define MTP_HANDLE_FOLDERS      (1 << INODE_FOLDER_BITS)
+
+#define MTP_HANDLE(s, d, f)     (((uint32_t)(s) << (32 - INODE_STORAGE_BITS)) | ((uint32_t)(d) << MTP_HANDLE_FILE_BITS) | (uint32_t)(f))
+#define MTP_HANDLE_STORAGE(h)   ((uint32_t)(h) >> (32 - INODE_STORAGE_BITS))
+#define MTP_HANDLE_FOLDER(h)    (((uint32_t)(h) >> MTP_HANDLE_FILE_BITS) & (MTP_HANDLE_FOLDERS - 1))
+#define MTP_HANDLE_FILE(h)      ((uint32_t)(h) & ((1UL << MTP_HANDLE_FILE_BITS) - 1))
+
+// "." and ".." of a subfolder, f_readdir() returns them with _FS_RPATH 2. They are no objects.
+#define MTP_DOT_ENTRY(fno)      (((fno)->fname[0] == '.') && (((fno)->fname[1] == 0) || (((fno)->fname[1] == '.') && ((fno)->fname[2] == 0))))
+
+
+typedef struct
+{
+    uint32_t    handle;     // 0 for a free slot
+    FILLOC      loc;        // Where the directory entry is
+    FSIZE_t     size;
+    WORD        fsid;       // Mount ID of the volume, the entry is void after a remount
+    BYTE        attr;
+} MtpIndexEntry_t;
+
+// GetObjectHandles dataset generator
+typedef struct
+{
+    DIR         dir;
+    FILINFO     fno;
+    int         storage;
+    int         folder;
+    uint32_t    count;      // Number of handles
+    uint32_t    length;     // Size of the dataset
+    uint32_t    next;       // 0 for the count, then the file number
+    bool        open;
+} MtpHandles_t;
+
+// Called by mtp_index_scan() for every item of a folder
+typedef void (*MtpIndexScan_t)(void* ctx, uint32_t handle, const FILINFO* fno);
+
+
+void     mtp_index_clear(int storage);
+
+int      mtp_index_add(uint32_t handle, const FILLOC* loc, const FILINFO* fno);
+const MtpIndexEntry_t* mtp_index_find(uint32_t handle);
+void     mtp_index_forget(uint32_t handle);
+
+int      mtp_index_set_folder(int storage, int folder, uint32_t handle);
+void     mtp_index_drop_folder(int storage, int folder);
+void     mtp_index_dirty(int storage, int folder);
+int      mtp_index_folder_of(int storage, uint32_t handle);
+int      mtp_index_opendir(int storage, int folder, DIR* dir, uint32_t* parent);
+
+int      mtp_index_stat(uint32_t handle, FILINFO* fno);
+int      mtp_index_open(uint32_t handle, FIL* fil);
+int      mtp_index_scan(int storage, int folder, FILINFO* fno, MtpIndexScan_t cb, void* ctx);
+int      mtp_index_count(int storage, int folder);
+
+int      mtp_handles_begin(MtpHandles_t* hs, int storage, int folder);
+int32_t  mtp_handles_fill(MtpHandles_t* hs, MtpRing_t* ring);
+bool     mtp_handles_done(const MtpHandles_t* hs);
+void     mtp_handles_end(MtpHandles_t* hs);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*_MTP_INDEX_H */
@@ -0,0 +1,86 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      mtp_object.h
+ \brief     Object data access for the MTP responder
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ Ranged object reads (GetPartialObject / GetPartialObject64) and object
+ uploads (SendObject) on top of FatFs, through the MTP transfer ring.
+****************************************************************************/
+
+#ifndef _MTP_OBJECT_H
+#define _MTP_OBJECT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "ff.h"
+#include "vfs_conf.h"
+#include "mtp_ring.h"
+
+
+#ifndef PTP_OC_GetPartialObject
+#define PTP_OC_GetPartialObject         0x101B
+#endif
+#ifndef PTP_OC_ANDROID_GetPartialObject64
+#define PTP_OC_ANDROID_GetPartialObject64   0x95C1
+#endif
+
+// Files from this size on get a cluster link map for ranged reads
+#ifndef MTP_FASTSEEK_THRESHOLD
+#define MTP_FASTSEEK_THRESHOLD          (256UL * 1024UL)
+#endif
+
+// Number of DWORDs in the cluster link map, 2 per fragment plus 2
+#ifndef MTP_FASTSEEK_CLMT_SIZE
+#define MTP_FASTSEEK_CLMT_SIZE          64
+#endif
+
+
+typedef struct
+{
+    FIL         fil;
+    uint32_t    length;     // Bytes in this data phase
+    uint32_t    remaining;  // Bytes still to be read from disk
+} MtpPartial_t;
+
+typedef struct
+{
+    FIL         fil;
+    FSIZE_t     size;       // Size announced by SendObjectInfo
+    FSIZE_t     written;
+    bool        contiguous; // The file got a contiguous preallocation
+} MtpUpload_t;
+
+
+int      mtp_errno(FRESULT res);
+
+int      mtp_partial_open(MtpPartial_t* obj, const char* path, uint64_t offset, uint32_t maxlen);
+int      mtp_partial_open_handle(MtpPartial_t* obj, uint32_t handle, uint64_t offset, uint32_t maxlen);
+int32_t  mtp_partial_read(void* obj, uint8_t* data, uint32_t len);
+int32_t  mtp_partial_fill(MtpPartial_t* obj, MtpRing_t* ring);
+void     mtp_partial_close(MtpPartial_t* obj);
+void     mtp_partial_forget(void);
+
+int      mtp_upload_open(MtpUpload_t* obj, const char* path, uint64_t size);
+int32_t  mtp_upload_write(void* obj, uint8_t* data, uint32_t len);
+int32_t  mtp_upload_drain(MtpUpload_t* obj, MtpRing_t* ring, bool final);
+int      mtp_upload_close(MtpUpload_t* obj);
+
+int      mtp_object_delete(uint32_t handle, const char* path);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*_MTP_OBJECT_H */
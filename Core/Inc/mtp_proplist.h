@@ -0,0 +1,89 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      mtp_proplist.h
+ \brief     Folder wide GetObjectPropList for the MTP responder
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ Streams the ObjectPropList dataset of all items in a folder into the MTP
+ transfer ring.
+****************************************************************************/
+
+#ifndef _MTP_PROPLIST_H
+#define _MTP_PROPLIST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ff.h"
+#include "vfs_conf.h"
+#include "mtp_ring.h"
+
+
+#ifndef MTP_OC_GetObjectPropList
+#define MTP_OC_GetObjectPropList        0x9805
+#endif
+
+#define MTP_PROPLIST_ALL                0xFFFFFFFF
+
+// Largest encoding of one item: all properties with two names of _MAX_LFN characters
+#define MTP_PROPLIST_ITEM_MAX           (10 * 8 + 4 + 2 + 2 + 8 + 2 * (1 + 2 * (_MAX_LFN + 1)) + 2 * 33 + 4 + 16)
+
+
+typedef struct
+{
+    DIR         dir;
+    FILINFO     fno;
+#if VFS_LFNAME
+    TCHAR       lfn[_MAX_LFN + 1];
+#endif
+    int         storage;
+    int         folder;
+    uint32_t    parent;     // Handle of the folder object
+    uint32_t    prop;       // Property code or MTP_PROPLIST_ALL
+    uint32_t    count;      // Number of elements in the dataset
+    uint32_t    length;     // Size of the dataset, the container adds its 12 byte header
+    uint32_t    sent;       // Bytes of the dataset put into the ring so far
+    uint32_t    next;       // File number of the next item
+    uint32_t    elements;   // Elements of the dataset encoded so far
+    // Copies of elements of the item with the shortest name stand in for
+    // items that went missing since the sizing pass, see PadBegin()
+    uint32_t    pad_handle; // That item, 0 before the first
+    FILLOC      pad_loc;
+    uint16_t    pad_len;    // and the length of its encoding
+    uint32_t    pad_names;  // Name elements still to send
+    uint32_t    pad_fixed;  // Other elements still to send
+    uint32_t    pad_chars;  // Terminators still to add to the names
+    int8_t      pad_iname;  // Property of the name elements
+    int8_t      pad_ifixed; // Property of the other elements
+    bool        padding;
+    uint16_t    pending;    // Bytes of 'buf' not yet in the ring
+    uint16_t    offset;
+    bool        open;
+    uint8_t     buf[MTP_PROPLIST_ITEM_MAX];
+} MtpPropList_t;
+
+
+extern MtpPropList_t vMtpPropList;
+
+
+int      mtp_proplist_begin(MtpPropList_t* pl, int storage, int folder, uint32_t prop, uint32_t depth);
+int32_t  mtp_proplist_fill(MtpPropList_t* pl, MtpRing_t* ring);
+bool     mtp_proplist_done(const MtpPropList_t* pl);
+void     mtp_proplist_end(MtpPropList_t* pl);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*_MTP_PROPLIST_H */
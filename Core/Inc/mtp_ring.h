@@ -0,0 +1,96 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      mtp_ring.h
+ \brief     Streaming transfer ring for MTP data phases
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ Sector aligned ring buffer that sits between the VFS and the MTP bulk
+ endpoints. The disk side moves whole sectors per call, the USB side moves
+ as many packets per transfer as are contiguous in the ring.
+****************************************************************************/
+
+#ifndef _MTP_RING_H
+#define _MTP_RING_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "usbd_conf.h"
+
+
+#ifndef MTP_MEDIA_PACKET
+#define MTP_MEDIA_PACKET        8192U
+#endif
+
+#define MTP_RING_ALIGN          512U    // Disk side granularity (one sector)
+
+#if (MTP_MEDIA_PACKET < 4096U) || (MTP_MEDIA_PACKET > 32768U) || (MTP_MEDIA_PACKET % MTP_RING_ALIGN)
+#error MTP_MEDIA_PACKET must be a multiple of 512 in the range 4096..32768
+#endif
+
+
+// Disk side transfer, returns number of bytes moved or a negative error code
+typedef int32_t (*MtpRingIo_t)(void* ctx, uint8_t* data, uint32_t len);
+
+typedef struct
+{
+    uint32_t    disk_calls;     // Number of VFS read/write calls
+    uint32_t    disk_bytes;     // Payload moved through those calls
+    uint32_t    usb_calls;      // Number of USB transmit/receive requests
+    uint32_t    usb_bytes;      // Payload requested through those requests
+} MtpRingStats_t;
+
+typedef struct
+{
+    uint8_t*        buf;
+    uint32_t        size;       // Capacity, multiple of MTP_RING_ALIGN
+    uint32_t        head;       // Consumer index
+    uint32_t        tail;       // Producer index
+    uint32_t        end;        // End of valid data in the upper part once the producer has wrapped
+    uint32_t        count;      // Bytes currently held
+    bool            wrapped;
+    MtpRingStats_t  stats;
+} MtpRing_t;
+
+
+extern MtpRing_t vMtpRing;
+
+
+void     mtp_ring_init(MtpRing_t* ring, uint8_t* buf, uint32_t size);
+void     mtp_ring_reset(MtpRing_t* ring);
+
+uint32_t mtp_ring_used(const MtpRing_t* ring);
+uint32_t mtp_ring_free(const MtpRing_t* ring);
+
+uint8_t* mtp_ring_reserve(MtpRing_t* ring, uint32_t min, uint32_t* len);
+void     mtp_ring_commit(MtpRing_t* ring, uint32_t len);
+uint8_t* mtp_ring_peek(MtpRing_t* ring, uint32_t* len);
+void     mtp_ring_consume(MtpRing_t* ring, uint32_t len);
+
+uint32_t mtp_ring_put(MtpRing_t* ring, const void* data, uint32_t len);
+
+int32_t  mtp_ring_fill(MtpRing_t* ring, MtpRingIo_t read, void* ctx, uint32_t remaining);
+int32_t  mtp_ring_drain(MtpRing_t* ring, MtpRingIo_t write, void* ctx, bool final);
+
+uint8_t* mtp_ring_tx(MtpRing_t* ring, uint32_t max, uint32_t* len);
+uint8_t* mtp_ring_rx(MtpRing_t* ring, uint32_t mps, uint32_t* len);
+
+uint32_t mtp_ring_bytes_per_call(const MtpRing_t* ring);
+void     mtp_ring_report(MtpRing_t* ring, const char* what);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*_MTP_RING_H */
@@ -0,0 +1,142 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      mtp_trace.h
+ \brief     Cycle counter trace of the USB, MTP and disk hot paths
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ Events are written with a timestamp into a fixed RAM ring at the entry
+ and exit of the USB data stages, the PTP opcode handlers, the transfer
+ ring and the disk layer. The vendor operation MTP_OC_WB_GetTrace reads
+ the ring out, Host/trace_decode turns it into per-transaction timelines.
+****************************************************************************/
+
+#ifndef _MTP_TRACE_H
+#define _MTP_TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mtp_ring.h"
+
+
+#ifndef MTP_TRACE
+#define MTP_TRACE               1
+#endif
+
+// Number of events in the ring, power of 2, 16 bytes each
+#ifndef MTP_TRACE_SIZE
+#define MTP_TRACE_SIZE          512
+#endif
+
+#if (MTP_TRACE_SIZE & (MTP_TRACE_SIZE - 1))
+#error MTP_TRACE_SIZE must be a power of 2
+#endif
+
+// Vendor operation: data phase is the trace dump, parameter 1 non-zero clears the ring after reading
+#ifndef MTP_OC_WB_GetTrace
+#define MTP_OC_WB_GetTrace      0x9A01
+#endif
+
+#define MTP_TRACE_MAGIC         0x52544257  // "WBTR"
+#define MTP_TRACE_VERSION       1
+
+#define MTP_TRACE_EXIT_FLAG     0x8000
+
+
+typedef enum
+{
+    TRACE_USB_SETUP = 1,        // a0: bmRequest | bRequest << 8
+    TRACE_USB_DATAIN,           // a0: endpoint
+    TRACE_USB_DATAOUT,          // a0: endpoint, a1: received bytes
+    TRACE_PTP_OPCODE,           // a0: operation code, a1: transaction ID; exit a0: response code
+    TRACE_RING_FILL,            // a0: bytes wanted; exit a0: bytes added
+    TRACE_RING_DRAIN,           // a0: bytes held; exit a0: bytes written
+    TRACE_DISK_READ,            // a0: pdrv << 24 | count, a1: sector; exit a0: result
+    TRACE_DISK_WRITE,           // a0: pdrv << 24 | count, a1: sector; exit a0: result
+    TRACE_SD_DONE,              // a0: SD_Request_t status, a1: sector
+    TRACE_USER = 0x100          // Ad hoc events from TRACE_USER on
+} MtpTraceId_t;
+
+typedef struct
+{
+    uint32_t    stamp;      // Cycles on the target, nanoseconds on the host
+    uint16_t    id;         // MtpTraceId_t, MTP_TRACE_EXIT_FLAG on the exit event
+    uint16_t    seq;        // Event number, shows where the ring was overwritten
+    uint32_t    a0;
+    uint32_t    a1;
+} MtpTraceEvent_t;
+
+// Dump header, followed by the events oldest first
+typedef struct
+{
+    uint32_t    magic;
+    uint16_t    version;
+    uint16_t    size;       // Bytes per event
+    uint32_t    hz;         // Timestamp clock
+    uint32_t    count;      // Events in the dump
+    uint32_t    lost;       // Events overwritten before this dump
+} MtpTraceHeader_t;
+
+typedef struct
+{
+    MtpTraceEvent_t ev[MTP_TRACE_SIZE];
+    uint32_t        head;   // Total number of events written
+    uint32_t        tail;   // Event number of the oldest event not yet dumped
+    bool            on;
+} MtpTrace_t;
+
+// Data phase generator of MTP_OC_WB_GetTrace
+typedef struct
+{
+    MtpTraceHeader_t    hdr;
+    uint32_t            next;   // Event number of the next event to send
+    uint32_t            end;
+    uint32_t            offset; // Bytes of the current item already in the ring
+    bool                clear;
+    bool                was_on;
+    bool                open;
+} MtpTraceDump_t;
+
+
+extern MtpTrace_t vMtpTrace;
+
+
+void     mtp_trace_init(void);
+void     mtp_trace_enable(bool on);
+void     mtp_trace_clear(void);
+void     mtp_trace_event(uint16_t id, uint32_t a0, uint32_t a1);
+uint32_t mtp_trace_hz(void);
+
+
+int      mtp_trace_begin(MtpTraceDump_t* dump, bool clear);
+int32_t  mtp_trace_fill(MtpTraceDump_t* dump, MtpRing_t* ring);
+bool     mtp_trace_done(const MtpTraceDump_t* dump);
+void     mtp_trace_end(MtpTraceDump_t* dump);
+
+
+#if MTP_TRACE
+#define MTP_TRACE_ENTER(id, a0, a1)     mtp_trace_event((id), (uint32_t)(a0), (uint32_t)(a1))
+#define MTP_TRACE_EXIT(id, a0, a1)      mtp_trace_event((id) | MTP_TRACE_EXIT_FLAG, (uint32_t)(a0), (uint32_t)(a1))
+#define MTP_TRACE_MARK(id, a0, a1)      mtp_trace_event((id), (uint32_t)(a0), (uint32_t)(a1))
+#else
+#define MTP_TRACE_ENTER(id, a0, a1)
+#define MTP_TRACE_EXIT(id, a0, a1)
+#define MTP_TRACE_MARK(id, a0, a1)
+#endif
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*_MTP_TRACE_H */
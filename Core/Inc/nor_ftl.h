@@ -0,0 +1,109 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      nor_ftl.h
+ \brief     Flash translation layer for the octal NOR
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ Presents the MX25LM51245G as a disk of 512 byte sectors, see nor_ftl.c.
+****************************************************************************/
+
+#ifndef _NOR_FTL_H
+#define _NOR_FTL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+#define FTL_SECTOR_SIZE         512
+#define FTL_PAGE_SIZE           4096        // Mapping unit
+#define FTL_BLOCK_SIZE          65536       // Erase unit, a summary page and FTL_DATA_PAGES data pages
+#define FTL_DATA_PAGES          (FTL_BLOCK_SIZE / FTL_PAGE_SIZE - 1)
+#define FTL_PAGE_SECTORS        (FTL_PAGE_SIZE / FTL_SECTOR_SIZE)
+
+// Part of the NOR used, in erase blocks from FTL_BASE
+#ifndef FTL_BASE
+#define FTL_BASE                0
+#endif
+#ifndef FTL_BLOCKS
+#define FTL_BLOCKS              1024
+#endif
+
+// Blocks kept back from the capacity so the garbage collector always has room
+#ifndef FTL_SPARE_BLOCKS
+#define FTL_SPARE_BLOCKS        16
+#endif
+
+// Foreground collection below FTL_GC_LOW free blocks, ftl_poll() works up to FTL_GC_HIGH
+#ifndef FTL_GC_LOW
+#define FTL_GC_LOW              2
+#endif
+#ifndef FTL_GC_HIGH
+#define FTL_GC_HIGH             8
+#endif
+
+// Erase count spread at which ftl_poll() moves the data out of the least worn block
+#ifndef FTL_WEAR_DELTA
+#define FTL_WEAR_DELTA          256
+#endif
+
+// Write back cache in pages, written out when evicted, on ftl_sync() or FTL_FLUSH_MS after the last write
+#ifndef FTL_CACHE_PAGES
+#define FTL_CACHE_PAGES         4
+#endif
+#ifndef FTL_FLUSH_MS
+#define FTL_FLUSH_MS            500
+#endif
+
+#define FTL_LOGICAL_PAGES       ((FTL_BLOCKS - FTL_SPARE_BLOCKS) * FTL_DATA_PAGES)
+
+#if (FTL_SPARE_BLOCKS < FTL_GC_LOW + 2)
+#error FTL_SPARE_BLOCKS too small for FTL_GC_LOW
+#endif
+
+// The FTL is used from the USB interrupt, ftl_poll() keeps that out while it works.
+// Nests: the interrupt is only enabled again if it was enabled at FTL_LOCK().
+#ifndef FTL_LOCK
+#define FTL_LOCK(state)         do { state = NVIC_GetEnableIRQ(USB_FS_IRQn); NVIC_DisableIRQ(USB_FS_IRQn); } while (0)
+#define FTL_UNLOCK(state)       do { if (state) NVIC_EnableIRQ(USB_FS_IRQn); } while (0)
+#endif
+
+
+typedef struct
+{
+    uint32_t    free;           // Erased blocks
+    uint32_t    dirty;          // Blocks waiting for the collector
+    uint32_t    erases_min;
+    uint32_t    erases_max;
+    uint32_t    relocated;      // Pages moved by the collector
+    uint32_t    programmed;     // Pages written
+} FtlStats_t;
+
+
+int      ftl_init(void);
+bool     ftl_ready(void);
+uint32_t ftl_sectors(void);
+int      ftl_read(uint8_t* buf, uint32_t sector, uint32_t count);
+int      ftl_write(const uint8_t* buf, uint32_t sector, uint32_t count);
+int      ftl_sync(void);
+int      ftl_trim(uint32_t sector, uint32_t count);
+int      ftl_format(void);
+void     ftl_poll(void);
+void     ftl_stats(FtlStats_t* st);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*_NOR_FTL_H */
@@ -0,0 +1,61 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      nor_io.h
+ \brief     Access to the octal NOR
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ Keeps the MX25LM51245G memory mapped for reads and takes it to indirect
+ mode only to program, erase or poll it. Erases run in the background and
+ are suspended for reads.
+****************************************************************************/
+
+#ifndef _NOR_IO_H
+#define _NOR_IO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "stm32l562e_discovery_ospi.h"
+
+
+// Least time an erase runs between a resume and the next suspend
+#ifndef NOR_RESUME_MS
+#define NOR_RESUME_MS       1
+#endif
+
+// A suspended erase resumes after this long without reads
+#ifndef NOR_QUIET_MS
+#define NOR_QUIET_MS        5
+#endif
+
+// The NOR is used from the USB interrupt, keep that out while it is in indirect mode
+#ifndef NOR_LOCK
+#define NOR_LOCK(state)     do { state = NVIC_GetEnableIRQ(USB_FS_IRQn); NVIC_DisableIRQ(USB_FS_IRQn); } while (0)
+#define NOR_UNLOCK(state)   do { if (state) NVIC_EnableIRQ(USB_FS_IRQn); } while (0)
+#endif
+
+
+int      nor_init(void);
+int      nor_info(BSP_OSPI_NOR_Info_t* info);
+int      nor_read(uint32_t addr, void* buf, uint32_t len);
+int      nor_program(uint32_t addr, const void* buf, uint32_t len);
+int      nor_erase(uint32_t addr, uint32_t size);
+int      nor_busy(void);
+int      nor_wait(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*_NOR_IO_H */
@@ -0,0 +1,67 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      nor_lfs.h
+ \brief     LittleFS block device on the octal NOR
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ Fills a lfs_config for the MX25LM51245G: geometry from the BSP, reads from
+ the memory mapped window, program and erase through indirect mode.
+****************************************************************************/
+
+#ifndef _NOR_LFS_H
+#define _NOR_LFS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if !__has_include("lfs.h")
+#error "LittleFS v2.9.3 belongs in Middlewares/Third_Party/littlefs, see 'make littlefs' in Host/Makefile"
+#endif
+#include "lfs.h"
+
+
+// Part of the NOR used, from NOR_LFS_BASE to the end
+#ifndef NOR_LFS_BASE
+#define NOR_LFS_BASE            0
+#endif
+
+// Smallest read and program, DTR transfers come in pairs of bytes
+#ifndef NOR_LFS_READ_SIZE
+#define NOR_LFS_READ_SIZE       16
+#endif
+#ifndef NOR_LFS_PROG_SIZE
+#define NOR_LFS_PROG_SIZE       16
+#endif
+
+// Read, program and per file cache, four program pages
+#ifndef NOR_LFS_CACHE_SIZE
+#define NOR_LFS_CACHE_SIZE      1024
+#endif
+
+// Largest lookahead bitmap in bytes, 2048 covers the 16384 blocks of the 64 MB part in one pass
+#ifndef NOR_LFS_LOOKAHEAD_MAX
+#define NOR_LFS_LOOKAHEAD_MAX   2048
+#endif
+
+// Erases of a metadata pair before LittleFS moves it
+#ifndef NOR_LFS_BLOCK_CYCLES
+#define NOR_LFS_BLOCK_CYCLES    500
+#endif
+
+
+int      nor_lfs_config(struct lfs_config* cfg);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*_NOR_LFS_H */
@@ -47,7 +47,7 @@ extern "C" {
 #define BSP_AUDIO_IN_IT_PRIORITY    0x07UL  /* Default is lowest priority level */
 
 /* SD card interrupt priority */
-#define BSP_SD_IT_PRIORITY          0x07UL  /* Default is lowest priority level */
+#define BSP_SD_IT_PRIORITY          0x01UL  /* Above USB (2), transfers are waited for in the USB interrupt */
 
 /* Bus frequencies */
 #define BUS_I2C1_FREQUENCY          100000UL /* Frequency of I2C1 = 100 KHz */
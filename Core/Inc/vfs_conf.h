@@ -26,6 +26,19 @@ extern "C" {
 //#define USE_JESFS
 //#define USE_LITTLEFS
 
+// Octal NOR "SPI:" as a second storage, FatFs through the flash translation layer or LittleFS
+#ifndef USE_SPIFLASH
+#ifdef USE_LITTLEFS
+#define USE_SPIFLASH        0
+#else
+#define USE_SPIFLASH        1
+#endif
+#endif
+
+#if USE_SPIFLASH && defined(USE_LITTLEFS)
+#error "SPI:" is either FatFs over the FTL or LittleFS, select one
+#endif
+
 //#define CIA_DISK	"SPI:"
 
 //#define _WHITEBREAM_H
@@ -35,6 +48,12 @@ extern "C" {
 //#include "project.h"
 #include "ff_gen_drv.h"
 #include "sd_diskio.h"
+#if USE_SPIFLASH
+#include "spiflash_diskio.h"
+#endif
+#ifdef USE_LITTLEFS
+#include "nor_lfs.h"
+#endif
 
 
 #define VFS_POSIX           0
@@ -57,6 +76,28 @@ extern "C" {
 #define SECTOR_ERASE    	105
 #define DISK_ERASE      	106
 
+#ifdef USE_FATFS
+// R0.11 and the R0.12c core (FatFs68300, exFAT) differ in where a file keeps its volume and start
+// cluster, in the file size type and in R0.11 returning long names in the caller's FILINFO.lfname
+#if _FATFS == 32020
+typedef DWORD FSIZE_t;
+#define VFS_LFNAME          _USE_LFN
+#define f_volume(fp)        ((fp)->fs)
+#define f_sclust(fp)        ((fp)->sclust)
+#else
+#define VFS_LFNAME          0
+#define f_volume(fp)        ((fp)->obj.fs)
+#define f_sclust(fp)        ((fp)->obj.sclust)
+#endif
+
+DWORD disk_writes(BYTE pdrv);
+FATFS* disk_volume(int index);
+void disk_poll(void);
+#endif
+#ifdef USE_LITTLEFS
+extern struct lfs_config vLfsCfg;
+#endif
+
 //#define vfs_malloc              pvPortMalloc
 //#define vfs_free                vPortFree
 //#define vfs_malloc_usable_size  vPortMallocUsableSize
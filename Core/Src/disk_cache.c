@@ -0,0 +1,238 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      disk_cache.c
+ \brief     Sector cache between FatFs and the disk drivers
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ FatFs has one sector window per volume. Allocating a cluster, adding a
+ directory entry or answering MTP object queries moves it between FAT,
+ directory and data sectors, and every move back is another read of a
+ sector that was just there. These single sector transfers go through a
+ cache of DISK_CACHE_SECTORS sectors, DISK_CACHE_WAYS lines per set, the
+ least recently used line of the set is replaced.
+
+ Writes of a single sector stay in the cache until CTRL_SYNC, which FatFs
+ issues from f_sync() and f_close(), or until their line is replaced. Multi
+ sector transfers are file data and go straight to the drive: a read is
+ patched with the dirty lines it covers, a write drops the lines it
+ overwrites.
+****************************************************************************/
+
+#include "disk_cache.h"
+#include <string.h>
+
+
+#define SETS        (DISK_CACHE_SECTORS / DISK_CACHE_WAYS)
+
+
+typedef struct
+{
+    DWORD       sector;
+    DWORD       used;       // Access stamp, 0 for a free line
+    BYTE        pdrv;
+    BYTE        dirty;
+} Line_t;
+
+
+static Line_t vLine[DISK_CACHE_SECTORS];
+static DWORD vData[DISK_CACHE_SECTORS][_MAX_SS / 4] DISK_CACHE_SECTION;
+static DWORD vStamp;
+static const Diskio_drvTypeDef* pDrv[_VOLUMES];
+static DiskCacheStats_t vStats[_VOLUMES];
+
+
+static Line_t*
+Find(BYTE pdrv, DWORD sector)
+{
+    Line_t* line = &vLine[((sector ^ ((DWORD)pdrv << 4)) % SETS) * DISK_CACHE_WAYS];
+
+    for (int i = 0; i < DISK_CACHE_WAYS; i++, line++)
+    {
+        if ((line->used != 0) && (line->sector == sector) && (line->pdrv == pdrv))
+            return(line);
+    }
+    return(NULL);
+}
+
+
+static DRESULT
+WriteBack(Line_t* line)
+{
+    DRESULT res;
+
+    if (res = pDrv[line->pdrv]->disk_write((const BYTE*)vData[line - vLine], line->sector, 1), res == RES_OK)
+    {
+        line->dirty = 0;
+        vStats[line->pdrv].writebacks++;
+    }
+    return(res);
+}
+
+
+/*! Free the least recently used line of the set of 'sector', writing it
+ * back first when it is dirty.
+ */
+static Line_t*
+Replace(BYTE pdrv, DWORD sector)
+{
+    Line_t* line = &vLine[((sector ^ ((DWORD)pdrv << 4)) % SETS) * DISK_CACHE_WAYS];
+    Line_t* victim = line;
+
+    for (int i = 0; i < DISK_CACHE_WAYS; i++, line++)
+    {
+        if (line->used < victim->used)
+            victim = line;
+    }
+    if (victim->dirty && (WriteBack(victim) != RES_OK))
+        return(NULL);
+    victim->used = 0;
+    return(victim);
+}
+
+
+static void
+Touch(Line_t* line)
+{
+    if (++vStamp == 0)
+    {
+        // Wrapped, age everything to 1
+        for (int i = 0; i < DISK_CACHE_SECTORS; i++)
+        {
+            if (vLine[i].used != 0)
+                vLine[i].used = 1;
+        }
+        vStamp = 2;
+    }
+    line->used = vStamp;
+}
+
+
+/*! Cache 'pdrv' on driver 'drv', forgetting what was cached of it before,
+ * when the drive is (re)initialised.
+ */
+void
+disk_cache_attach(BYTE pdrv, const Diskio_drvTypeDef* drv)
+{
+    disk_cache_discard(pdrv, 0, 0xFFFFFFFF);
+    pDrv[pdrv] = drv;
+}
+
+
+DRESULT
+disk_cache_read(BYTE pdrv, BYTE* buff, DWORD sector, UINT count)
+{
+    DRESULT res;
+    Line_t* line;
+
+    if (count > 1)
+    {
+        vStats[pdrv].bypassed++;
+        if (res = pDrv[pdrv]->disk_read(buff, sector, count), res != RES_OK)
+            return(res);
+        for (int i = 0; i < DISK_CACHE_SECTORS; i++)
+        {
+            line = &vLine[i];
+            if (line->dirty && (line->pdrv == pdrv) && (line->sector - sector < count))
+                memcpy(buff + (line->sector - sector) * _MAX_SS, vData[i], _MAX_SS);
+        }
+        return(RES_OK);
+    }
+
+    if (line = Find(pdrv, sector), line != NULL)
+        vStats[pdrv].hits++;
+    else
+    {
+        vStats[pdrv].misses++;
+        // No line to spare, read past the cache
+        if (line = Replace(pdrv, sector), line == NULL)
+            return(pDrv[pdrv]->disk_read(buff, sector, 1));
+        if (res = pDrv[pdrv]->disk_read((BYTE*)vData[line - vLine], sector, 1), res != RES_OK)
+            return(res);
+        line->sector = sector;
+        line->pdrv = pdrv;
+        line->dirty = 0;
+    }
+    Touch(line);
+    memcpy(buff, vData[line - vLine], _MAX_SS);
+    return(RES_OK);
+}
+
+
+DRESULT
+disk_cache_write(BYTE pdrv, const BYTE* buff, DWORD sector, UINT count)
+{
+    Line_t* line;
+
+    if (count > 1)
+    {
+        vStats[pdrv].bypassed++;
+        disk_cache_discard(pdrv, sector, sector + count - 1);
+        return(pDrv[pdrv]->disk_write(buff, sector, count));
+    }
+
+    if (line = Find(pdrv, sector), line == NULL)
+    {
+        if (line = Replace(pdrv, sector), line == NULL)
+            return(pDrv[pdrv]->disk_write(buff, sector, 1));
+        line->sector = sector;
+        line->pdrv = pdrv;
+    }
+    memcpy(vData[line - vLine], buff, _MAX_SS);
+    line->dirty = 1;
+    Touch(line);
+    return(RES_OK);
+}
+
+
+/*! Write back the dirty sectors of 'pdrv' in ascending order.
+ */
+DRESULT
+disk_cache_sync(BYTE pdrv)
+{
+    DRESULT res;
+    Line_t* next;
+
+    do
+    {
+        next = NULL;
+        for (int i = 0; i < DISK_CACHE_SECTORS; i++)
+        {
+            if (vLine[i].dirty && (vLine[i].pdrv == pdrv) && ((next == NULL) || (vLine[i].sector < next->sector)))
+                next = &vLine[i];
+        }
+        if ((next != NULL) && (res = WriteBack(next), res != RES_OK))
+            return(res);
+    } while (next != NULL);
+    return(RES_OK);
+}
+
+
+/*! Drop sectors 'start' to 'end' of 'pdrv', written back or not, for
+ * CTRL_TRIM, erases and overwrites.
+ */
+void
+disk_cache_discard(BYTE pdrv, DWORD start, DWORD end)
+{
+    for (int i = 0; i < DISK_CACHE_SECTORS; i++)
+    {
+        if ((vLine[i].used != 0) && (vLine[i].pdrv == pdrv) && (vLine[i].sector >= start) && (vLine[i].sector <= end))
+        {
+            vLine[i].used = 0;
+            vLine[i].dirty = 0;
+        }
+    }
+}
+
+
+void
+disk_cache_stats(BYTE pdrv, DiskCacheStats_t* stats)
+{
+    *stats = vStats[pdrv];
+}
@@ -25,7 +25,8 @@
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
-
+#include "mtp_trace.h"
+#include "vfs_conf.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -131,7 +132,7 @@ int main(void)
   PeriphCommonClock_Config();
 
   /* USER CODE BEGIN SysInit */
-
+  mtp_trace_init();
   /* USER CODE END SysInit */
 
   /* Initialize all configured peripherals */
@@ -155,6 +156,9 @@ int main(void)
   MX_UCPD1_Init();
   //if (MX_FATFS_Init() != APP_OK) {
   //}
+#ifdef USE_LITTLEFS
+  nor_lfs_config(&vLfsCfg);
+#endif
   vfs_init();
   MX_USB_Device_Init();
   /* USER CODE BEGIN 2 */
@@ -168,6 +172,12 @@ int main(void)
     /* USER CODE END WHILE */
 
     /* USER CODE BEGIN 3 */
+#if USE_SPIFLASH
+    ftl_poll();
+#endif
+#ifdef USE_FATFS
+    disk_poll();
+#endif
   }
   /* USER CODE END 3 */
 }
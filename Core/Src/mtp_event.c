@@ -0,0 +1,81 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      mtp_event.c
+ \brief     Events on the MTP interrupt endpoint
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ An event is a PTP container of type 4 with one parameter. It is not part
+ of a transaction, so the TransactionID is 0xFFFFFFFF. The interrupt
+ endpoint holds one event at a time; when it is busy the caller keeps the
+ event and tries again later.
+****************************************************************************/
+
+#include "mtp_event.h"
+#include "usb_device.h"
+#include "usbd_mtp.h"
+#include <errno.h>
+
+
+#define PTP_CONTAINER_EVENT     4
+#define PTP_EVENT_LENGTH        16      // Header of 12 bytes and one parameter
+
+
+extern USBD_HandleTypeDef hUsbDeviceFS;
+
+// Sent from here by the endpoint, must stay put until the transfer is done
+static uint8_t vEvent[PTP_EVENT_LENGTH];
+
+
+static uint8_t*
+Put32(uint8_t* p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+    return(p + 4);
+}
+
+
+/*! Send event 'code' with one parameter.
+ * Returns 0 or -EBUSY when the endpoint or the session cannot take it now.
+ */
+int
+mtp_event_send(uint16_t code, uint32_t param)
+{
+    uint8_t* p = vEvent;
+    uint32_t irq;
+    uint8_t res;
+
+    p = Put32(p, PTP_EVENT_LENGTH);
+    *p++ = PTP_CONTAINER_EVENT;
+    *p++ = 0;
+    *p++ = code;
+    *p++ = code >> 8;
+    p = Put32(p, 0xFFFFFFFF);
+    Put32(p, param);
+
+    // The class also sends from the USB interrupt
+    irq = NVIC_GetEnableIRQ(USB_FS_IRQn);
+    NVIC_DisableIRQ(USB_FS_IRQn);
+    res = USBD_MTP_SendInterruptData(&hUsbDeviceFS, vEvent, PTP_EVENT_LENGTH);
+    if (irq)
+        NVIC_EnableIRQ(USB_FS_IRQn);
+    return((res == USBD_OK) ? 0 : -EBUSY);
+}
+
+
+/*! Tell the host to read StorageInfo of 'storage' (vFileSystem[] index) again.
+ */
+int
+mtp_event_storage_changed(int storage)
+{
+    return(mtp_event_send(MTP_EC_StorageInfoChanged, ((uint32_t)(storage + 1) << 16) | 1));
+}
@@ -0,0 +1,472 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      mtp_index.c
+ \brief     Object handle index for the MTP responder
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ GetFileById used to turn a handle into a path in vWorkPath, after which
+ FatFs followed that path from the root, scanning every directory on the
+ way. This index keeps, per handle, the cluster of the parent directory and
+ the index of the entry in it, plus the size and attributes. GetObjectInfo
+ and GetObjectPropValue are served from the table, a stat or open of the
+ object costs one directory sector read.
+
+ The handle is split according to INODE_STORAGE_BITS and INODE_FOLDER_BITS.
+ Every folder number has a row holding the entry location of that directory,
+ row 0 being the root, so a folder is enumerated without its path either. On
+ FAT its start cluster is enough to open it, on exFAT FatFs reads the entry
+ for the size and chain status of the directory.
+ Handles live in a direct mapped table; a collision evicts the older entry
+ and the caller falls back to the path lookup, which adds it again.
+
+ Every folder row also caches the number of items in the folder, so
+ GetObjectHandles can send the count and stream the handles as the
+ directory is read. Adding, deleting or renaming an object must call
+ mtp_index_dirty() for its folder, alongside setting vFolderCacheDirty;
+ mtp_upload_open() and mtp_object_delete() do so. A count is also void
+ once the drive was written to (disk_writes()), which covers changes made
+ past the MTP responder.
+
+ Entries are checked against the mount ID of the volume and FatFs checks
+ that the entry is still at its location. Operations that move or remove a
+ directory entry must still tell the index: delete and rename call
+ mtp_index_forget(), deleting a folder calls mtp_index_drop_folder().
+****************************************************************************/
+
+#include "mtp_index.h"
+#include "mtp_object.h"
+#include <errno.h>
+#include <string.h>
+
+
+typedef struct
+{
+    uint32_t    handle;     // Handle of the folder object, 0 for the root row
+    FILLOC      loc;        // Entry of the directory, unused in the root row
+    uint32_t    count;      // Number of items, when 'counted'
+    DWORD       writes;     // disk_writes() of the drive when counted
+    WORD        fsid;
+    bool        valid;
+    bool        counted;
+} MtpIndexFolder_t;
+
+
+static MtpIndexEntry_t vIndex[MTP_INDEX_SIZE];
+static MtpIndexFolder_t vFolders[MTP_HANDLE_STORAGES][MTP_HANDLE_FOLDERS];
+
+
+static inline uint32_t
+Slot(uint32_t handle)
+{
+    return(((uint32_t)(handle * 2654435761UL) >> 16) & (MTP_INDEX_SIZE - 1));
+}
+
+
+static MtpIndexFolder_t*
+Folder(int storage, int folder, FATFS* fs)
+{
+    MtpIndexFolder_t* row = &vFolders[storage][folder];
+
+    if ((folder == 0) && (!row->valid || (row->fsid != fs->id)))
+    {
+        // The root row is always there, it is set up on first use after a (re)mount
+        memset(row, 0, sizeof(*row));
+        row->fsid = fs->id;
+        row->valid = true;
+    }
+    if (!row->valid || (row->fsid != fs->id))
+        return(NULL);
+    return(row);
+}
+
+
+/*! Forget the handles of one storage, or all of them with 'storage' -1.
+ * To be called on session open and close, unmount and format.
+ */
+void
+mtp_index_clear(int storage)
+{
+    for (int i = 0; i < MTP_INDEX_SIZE; i++)
+    {
+        if ((storage < 0) || (MTP_HANDLE_STORAGE(vIndex[i].handle) == storage))
+            vIndex[i].handle = 0;
+    }
+    if (storage < 0)
+        memset(vFolders, 0, sizeof(vFolders));
+    else if (storage < MTP_HANDLE_STORAGES)
+        memset(vFolders[storage], 0, sizeof(vFolders[storage]));
+}
+
+
+/*! Record where the directory entry of 'handle' is.
+ */
+int
+mtp_index_add(uint32_t handle, const FILLOC* loc, const FILINFO* fno)
+{
+    FATFS* fs = disk_volume(MTP_HANDLE_STORAGE(handle));
+    MtpIndexEntry_t* e = &vIndex[Slot(handle)];
+
+    if ((handle == 0) || (fs == NULL))
+        return(-EINVAL);
+    e->handle = handle;
+    e->loc = *loc;
+    e->size = fno->fsize;
+    e->attr = fno->fattrib;
+    e->fsid = fs->id;
+    return(0);
+}
+
+
+/*! Look up a handle, NULL when it is not (or no longer) in the index.
+ */
+const MtpIndexEntry_t*
+mtp_index_find(uint32_t handle)
+{
+    MtpIndexEntry_t* e = &vIndex[Slot(handle)];
+    FATFS* fs;
+
+    if ((handle == 0) || (e->handle != handle))
+        return(NULL);
+    if (fs = disk_volume(MTP_HANDLE_STORAGE(handle)), (fs == NULL) || (fs->id != e->fsid))
+    {
+        e->handle = 0;
+        return(NULL);
+    }
+    return(e);
+}
+
+
+/*! Drop a handle whose directory entry was removed or moved (rename).
+ */
+void
+mtp_index_forget(uint32_t handle)
+{
+    MtpIndexEntry_t* e = &vIndex[Slot(handle)];
+
+    if (e->handle == handle)
+        e->handle = 0;
+}
+
+
+/*! Assign folder number 'folder' to the directory object 'handle', which
+ * must be in the index.
+ */
+int
+mtp_index_set_folder(int storage, int folder, uint32_t handle)
+{
+    const MtpIndexEntry_t* e = mtp_index_find(handle);
+    MtpIndexFolder_t* row;
+
+    if ((storage >= MTP_HANDLE_STORAGES) || (folder <= 0) || (folder >= MTP_HANDLE_FOLDERS))
+        return(-EINVAL);
+    if (e == NULL)
+        return(-ENOENT);
+    if (!(e->attr & AM_DIR))
+        return(-ENOTDIR);
+    row = &vFolders[storage][folder];
+    row->handle = handle;
+    row->loc = e->loc;
+    row->fsid = e->fsid;
+    row->valid = true;
+    row->counted = false;
+    return(0);
+}
+
+
+/*! Drop a folder row and the handles of the items in it, after the folder
+ * was deleted or its numbering changed.
+ */
+void
+mtp_index_drop_folder(int storage, int folder)
+{
+    for (int i = 0; i < MTP_INDEX_SIZE; i++)
+    {
+        uint32_t h = vIndex[i].handle;
+
+        if ((h != 0) && (MTP_HANDLE_STORAGE(h) == storage) && (MTP_HANDLE_FOLDER(h) == folder))
+            vIndex[i].handle = 0;
+    }
+    if ((storage < MTP_HANDLE_STORAGES) && (folder >= 0) && (folder < MTP_HANDLE_FOLDERS))
+    {
+        vFolders[storage][folder].counted = false;
+        if (folder > 0)
+            vFolders[storage][folder].valid = false;
+    }
+}
+
+
+/*! The content of a folder changed (object added, deleted or renamed) and
+ * its item count is void, 'folder' -1 voids the counts of all folders of
+ * the storage. This is what vFolderCacheDirty flags for the folder cache
+ * of the MTP class.
+ */
+void
+mtp_index_dirty(int storage, int folder)
+{
+    if ((storage < 0) || (storage >= MTP_HANDLE_STORAGES) || (folder >= MTP_HANDLE_FOLDERS))
+        return;
+    if (folder >= 0)
+        vFolders[storage][folder].counted = false;
+    else
+    {
+        for (folder = 0; folder < MTP_HANDLE_FOLDERS; folder++)
+            vFolders[storage][folder].counted = false;
+    }
+}
+
+
+/*! Read the directory entry of 'handle' and refresh the cached size and
+ * attributes. Returns 0, -ENOENT when the handle is not in the index, or
+ * another negative error code.
+ */
+int
+mtp_index_stat(uint32_t handle, FILINFO* fno)
+{
+    MtpIndexEntry_t* e = (MtpIndexEntry_t*)mtp_index_find(handle);
+    FRESULT res;
+
+    if (e == NULL)
+        return(-ENOENT);
+    if (res = f_stat_loc(disk_volume(MTP_HANDLE_STORAGE(handle)), &e->loc, fno), res != FR_OK)
+    {
+        e->handle = 0;
+        return(-mtp_errno(res));
+    }
+    e->size = fno->fsize;
+    e->attr = fno->fattrib;
+    return(0);
+}
+
+
+/*! Open the file 'handle' for reading. Returns -ENOENT when the handle is
+ * not in the index, the caller then goes by the path.
+ */
+int
+mtp_index_open(uint32_t handle, FIL* fil)
+{
+    MtpIndexEntry_t* e = (MtpIndexEntry_t*)mtp_index_find(handle);
+    FRESULT res;
+
+    if (e == NULL)
+        return(-ENOENT);
+    if (res = f_open_loc(fil, disk_volume(MTP_HANDLE_STORAGE(handle)), &e->loc), res != FR_OK)
+    {
+        e->handle = 0;
+        return(-mtp_errno(res));
+    }
+    if (f_sclust(fil) != e->loc.sclust)
+    {
+        // Another object took the place of this entry
+        f_close(fil);
+        e->handle = 0;
+        return(-ENOENT);
+    }
+    e->size = f_size(fil);
+    return(0);
+}
+
+
+/*! Folder number of the directory object 'handle', 0 for the root (handle
+ * 0 or 0xFFFFFFFF), -ENOENT when no folder row refers to it.
+ */
+int
+mtp_index_folder_of(int storage, uint32_t handle)
+{
+    if ((handle == 0) || (handle == 0xFFFFFFFF))
+        return(0);
+    if ((storage < 0) || (storage >= MTP_HANDLE_STORAGES))
+        return(-EINVAL);
+    for (int folder = 1; folder < MTP_HANDLE_FOLDERS; folder++)
+    {
+        if (vFolders[storage][folder].valid && (vFolders[storage][folder].handle == handle))
+            return(folder);
+    }
+    return(-ENOENT);
+}
+
+
+/*! Open a folder by its number. 'parent' receives the handle of the folder
+ * object, 0 for the root.
+ */
+int
+mtp_index_opendir(int storage, int folder, DIR* dir, uint32_t* parent)
+{
+    FATFS* fs = disk_volume(storage);
+    MtpIndexFolder_t* row;
+    FRESULT res;
+
+    if ((fs == NULL) || (storage >= MTP_HANDLE_STORAGES) || (folder < 0) || (folder >= MTP_HANDLE_FOLDERS))
+        return(-ENODEV);
+    if (row = Folder(storage, folder, fs), row == NULL)
+        return(-ENOENT);
+    if (res = f_opendir_loc(dir, fs, (folder == 0) ? NULL : &row->loc), res != FR_OK)
+        return(-mtp_errno(res));
+    if (parent != NULL)
+        *parent = row->handle;
+    return(0);
+}
+
+
+/*! Enumerate a folder and index its items, file number n being the n-th
+ * item. 'fno' is the caller's FILINFO (with its LFN buffer), passed to 'cb'
+ * for every item. Returns the number of items or a negative error code.
+ */
+int
+mtp_index_scan(int storage, int folder, FILINFO* fno, MtpIndexScan_t cb, void* ctx)
+{
+    FILLOC loc;
+    FRESULT res;
+    DIR dir;
+    DWORD writes;
+    int err, n = 0;
+
+    if (err = mtp_index_opendir(storage, folder, &dir, NULL), err < 0)
+        return(err);
+    writes = disk_writes(disk_volume(storage)->drv);
+
+    while (res = f_readdir_loc(&dir, fno, &loc), (res == FR_OK) && (fno->fname[0] != 0))
+    {
+        uint32_t handle;
+
+        if (MTP_DOT_ENTRY(fno))
+            continue;
+        handle = MTP_HANDLE(storage, folder, ++n);
+        mtp_index_add(handle, &loc, fno);
+        if (cb != NULL)
+            cb(ctx, handle, fno);
+    }
+    f_closedir(&dir);
+    if (res != FR_OK)
+        return(-mtp_errno(res));
+    vFolders[storage][folder].count = n;
+    vFolders[storage][folder].writes = writes;
+    vFolders[storage][folder].counted = true;
+    return(n);
+}
+
+
+/*! Number of items in a folder, from the count cache or by enumerating it.
+ */
+int
+mtp_index_count(int storage, int folder)
+{
+    FATFS* fs = disk_volume(storage);
+    MtpIndexFolder_t* row;
+    FILINFO fno;
+
+    if ((fs == NULL) || (storage >= MTP_HANDLE_STORAGES) || (folder < 0) || (folder >= MTP_HANDLE_FOLDERS))
+        return(-ENODEV);
+    if (row = Folder(storage, folder, fs), row == NULL)
+        return(-ENOENT);
+    if (row->counted && (row->writes == disk_writes(fs->drv)))
+        return(row->count);
+#if VFS_LFNAME
+    fno.lfname = NULL;
+    fno.lfsize = 0;
+#endif
+    return(mtp_index_scan(storage, folder, &fno, NULL, NULL));
+}
+
+
+/*! Start a GetObjectHandles of 'folder'. The count comes from the count
+ * cache, the handles follow as the directory is read, so the first packet
+ * goes out without a full enumeration when the folder was counted before.
+ * Returns 0 or a negative error code, the dataset is 'hs->length' bytes.
+ */
+int
+mtp_handles_begin(MtpHandles_t* hs, int storage, int folder)
+{
+    int err, count;
+
+    hs->open = false;
+    if (count = mtp_index_count(storage, folder), count < 0)
+        return(count);
+    if (err = mtp_index_opendir(storage, folder, &hs->dir, NULL), err < 0)
+        return(err);
+#if VFS_LFNAME
+    hs->fno.lfname = NULL;  // The handles only need the entry location
+    hs->fno.lfsize = 0;
+#endif
+    hs->storage = storage;
+    hs->folder = folder;
+    hs->count = count;
+    hs->length = 4 + 4 * count;
+    hs->next = 0;
+    hs->open = true;
+    return(0);
+}
+
+
+/*! Move the next handles into the ring. Returns the number of bytes added
+ * or a negative error code.
+ */
+int32_t
+mtp_handles_fill(MtpHandles_t* hs, MtpRing_t* ring)
+{
+    int32_t total = 0;
+    uint32_t len;
+    uint8_t* p;
+
+    while (hs->open && (hs->next <= hs->count) && (p = mtp_ring_reserve(ring, 4, &len), p != NULL))
+    {
+        uint32_t n = 0;
+
+        for (; (len >= 4) && (hs->next <= hs->count); len -= 4, n += 4, hs->next++)
+        {
+            uint32_t value = hs->count;
+
+            if (hs->next > 0)
+            {
+                FILLOC loc;
+                FRESULT res;
+
+                do
+                {
+                    if (res = f_readdir_loc(&hs->dir, &hs->fno, &loc), res != FR_OK)
+                    {
+                        mtp_ring_commit(ring, n);
+                        return(-mtp_errno(res));
+                    }
+                } while ((hs->fno.fname[0] != 0) && MTP_DOT_ENTRY(&hs->fno));
+                if (hs->fno.fname[0] != 0)
+                {
+                    value = MTP_HANDLE(hs->storage, hs->folder, hs->next);
+                    mtp_index_add(value, &loc, &hs->fno);
+                }
+                else
+                {
+                    // The folder lost items while the handles went out, the count is sent already
+                    mtp_index_dirty(hs->storage, hs->folder);
+                    value = 0;
+                }
+            }
+            memcpy(&p[n], &value, 4);
+        }
+        mtp_ring_commit(ring, n);
+        total += n;
+    }
+    return(total);
+}
+
+
+bool
+mtp_handles_done(const MtpHandles_t* hs)
+{
+    return(!hs->open || (hs->next > hs->count));
+}
+
+
+void
+mtp_handles_end(MtpHandles_t* hs)
+{
+    if (hs->open)
+        f_closedir(&hs->dir);
+    hs->open = false;
+}
@@ -0,0 +1,354 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      mtp_object.c
+ \brief     Object data access for the MTP responder
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ GetPartialObject (0x101B) and GetPartialObject64 (0x95C1) let a host read
+ a byte range of an object, e.g. the tail of a log file or the rest of a
+ transfer that was cut short. The opcode handlers open the object with
+ mtp_partial_open_handle(), or resolve the handle to a path and call
+ mtp_partial_open() when it is not in the handle index, and stream the
+ range through the transfer ring; the response parameter is
+ MtpPartial_t.length.
+
+ SendObject creates the file announced by SendObjectInfo with its full
+ size allocated as one contiguous cluster run (f_expand), so FatFs neither
+ reads nor updates the FAT while the data comes in and writes whole ring
+ drains in a single multi-sector disk write. When there is no free run
+ long enough the file grows cluster by cluster as before. With the R0.12c
+ core on an exFAT volume the run is found in the allocation bitmap and the
+ file is flagged contiguous, FatFs then has no cluster chain to follow at
+ all; objects of 4 GB and more are accepted there only.
+
+ DeleteObject goes through mtp_object_delete(), which keeps the handle
+ index and the folder item counts in step with the volume.
+
+ Large files get a FatFs fast-seek cluster link map, so the seek does not
+ follow the FAT chain from the start. The map of the last file is kept
+ until the drive is written to, a host reading a file in consecutive ranges
+ only builds it once. A file too fragmented for it gets a map from the
+ FatFs pool (_FASTSEEK_POOL) for as long as it is open.
+****************************************************************************/
+
+#include "mtp_object.h"
+#include "mtp_index.h"
+#include "vfs_conf.h"
+#include <errno.h>
+#include <string.h>
+
+
+#if _USE_FASTSEEK
+static DWORD vClmt[MTP_FASTSEEK_CLMT_SIZE];
+static struct
+{
+    FATFS*  fs;
+    WORD    id;         // Mount ID, the map is void after a remount
+    DWORD   writes;     // Write count of the drive, the map is void after any write
+    DWORD   sclust;
+    FSIZE_t fsize;
+} vClmtOwner;
+#endif
+
+
+/*! Map a FatFs result to an errno value.
+ */
+int
+mtp_errno(FRESULT res)
+{
+    switch (res)
+    {
+    case FR_OK:                 return(0);
+    case FR_NO_FILE:
+    case FR_NO_PATH:            return(ENOENT);
+    case FR_INVALID_NAME:
+    case FR_INVALID_DRIVE:
+    case FR_INVALID_PARAMETER:  return(EINVAL);
+    case FR_DENIED:
+    case FR_EXIST:
+    case FR_WRITE_PROTECTED:    return(EACCES);
+    case FR_LOCKED:             return(EBUSY);
+    case FR_NOT_ENOUGH_CORE:    return(ENOMEM);
+    case FR_TOO_MANY_OPEN_FILES: return(EMFILE);
+    case FR_NOT_READY:
+    case FR_NOT_ENABLED:
+    case FR_NO_FILESYSTEM:      return(ENODEV);
+    default:                    return(EIO);
+    }
+}
+
+
+#if _USE_FASTSEEK
+/*! Attach the cluster link map to an opened file, building it if the map
+ * does not already describe this file.
+ */
+static void
+FastSeekAttach(FIL* fil)
+{
+    FATFS* fs = f_volume(fil);
+    DWORD writes = disk_writes(fs->drv);
+
+    if ((vClmtOwner.fs == fs) && (vClmtOwner.id == fs->id) && (vClmtOwner.writes == writes) &&
+        (vClmtOwner.sclust == f_sclust(fil)) && (vClmtOwner.fsize == f_size(fil)))
+    {
+        fil->cltbl = vClmt;
+        return;
+    }
+
+    vClmtOwner.fs = NULL;
+    vClmt[0] = MTP_FASTSEEK_CLMT_SIZE;
+    fil->cltbl = vClmt;
+    if (f_lseek(fil, CREATE_LINKMAP) != FR_OK)
+    {
+        // Too fragmented for the map, f_lseek() takes one from its pool or follows the chain
+        fil->cltbl = NULL;
+        fil->err = 0;
+        return;
+    }
+    vClmtOwner.fs = fs;
+    vClmtOwner.id = fs->id;
+    vClmtOwner.writes = writes;
+    vClmtOwner.sclust = f_sclust(fil);
+    vClmtOwner.fsize = f_size(fil);
+}
+#endif
+
+
+static int
+PartialSeek(MtpPartial_t* obj, uint64_t offset, uint32_t maxlen)
+{
+    FRESULT res;
+
+    if (offset < f_size(&obj->fil))
+    {
+        FSIZE_t avail = f_size(&obj->fil) - (FSIZE_t)offset;
+
+        obj->length = (maxlen < avail) ? maxlen : (uint32_t)avail;
+#if _USE_FASTSEEK
+        if ((offset > 0) && (f_size(&obj->fil) >= MTP_FASTSEEK_THRESHOLD))
+            FastSeekAttach(&obj->fil);
+#endif
+        if (res = f_lseek(&obj->fil, (FSIZE_t)offset), res != FR_OK)
+        {
+            f_close(&obj->fil);
+            obj->length = 0;
+            return(-mtp_errno(res));
+        }
+    }
+    obj->remaining = obj->length;
+    return(0);
+}
+
+
+/*! Open 'path' for reading 'maxlen' bytes from 'offset'. An offset beyond
+ * the end of the object gives an empty range.
+ * Returns 0 or a negative error code.
+ */
+int
+mtp_partial_open(MtpPartial_t* obj, const char* path, uint64_t offset, uint32_t maxlen)
+{
+    FRESULT res;
+
+    obj->length = 0;
+    obj->remaining = 0;
+
+    if (res = f_open(&obj->fil, path, FA_READ), res != FR_OK)
+        return(-mtp_errno(res));
+    return(PartialSeek(obj, offset, maxlen));
+}
+
+
+/*! As mtp_partial_open(), by handle through the handle index. Returns
+ * -ENOENT when the handle is not indexed, the caller then goes by the path.
+ */
+int
+mtp_partial_open_handle(MtpPartial_t* obj, uint32_t handle, uint64_t offset, uint32_t maxlen)
+{
+    int err;
+
+    obj->length = 0;
+    obj->remaining = 0;
+
+    if (err = mtp_index_open(handle, &obj->fil), err < 0)
+        return(err);
+    return(PartialSeek(obj, offset, maxlen));
+}
+
+
+/*! MtpRingIo_t reader for the range opened by mtp_partial_open().
+ */
+int32_t
+mtp_partial_read(void* obj, uint8_t* data, uint32_t len)
+{
+    MtpPartial_t* part = (MtpPartial_t*)obj;
+    FRESULT res;
+    UINT br;
+
+    if (len > part->remaining)
+        len = part->remaining;
+    if (res = f_read(&part->fil, data, len, &br), res != FR_OK)
+        return(-mtp_errno(res));
+    part->remaining -= br;
+    return(br);
+}
+
+
+/*! Top up the transfer ring with the next part of the range.
+ */
+int32_t
+mtp_partial_fill(MtpPartial_t* obj, MtpRing_t* ring)
+{
+    return(mtp_ring_fill(ring, mtp_partial_read, obj, obj->remaining));
+}
+
+
+void
+mtp_partial_close(MtpPartial_t* obj)
+{
+    f_close(&obj->fil);
+}
+
+
+/*! Drop the cached cluster link map, to be called when objects are
+ * written, deleted or the store is formatted.
+ */
+void
+mtp_partial_forget(void)
+{
+#if _USE_FASTSEEK
+    vClmtOwner.fs = NULL;
+#endif
+}
+
+
+/*! Storage (vFileSystem[] index) of a mounted volume, -1 when not found.
+ */
+static int
+StorageOf(const FATFS* fs)
+{
+    for (int storage = 0; storage < MTP_HANDLE_STORAGES; storage++)
+    {
+        if (disk_volume(storage) == fs)
+            return(storage);
+    }
+    return(-1);
+}
+
+
+/*! Create 'path' for the SendObject data phase of 'size' bytes.
+ * Returns 0 or a negative error code.
+ */
+int
+mtp_upload_open(MtpUpload_t* obj, const char* path, uint64_t size)
+{
+    FRESULT res;
+
+    obj->size = 0;
+    obj->written = 0;
+    obj->contiguous = false;
+
+    if ((FSIZE_t)size != size)
+        return(-EFBIG);
+    if (res = f_open(&obj->fil, path, FA_WRITE | FA_CREATE_ALWAYS), res != FR_OK)
+        return(-mtp_errno(res));
+    // The folder of 'path' has no number here, the counts of the storage go
+    mtp_index_dirty(StorageOf(f_volume(&obj->fil)), -1);
+#if _FS_EXFAT
+    if ((size > 0xFFFFFFFFULL) && (f_volume(&obj->fil)->fs_type != FS_EXFAT))
+    {
+        // Only exFAT holds files of 4 GB and more
+        f_close(&obj->fil);
+        f_unlink(path);
+        return(-EFBIG);
+    }
+#endif
+    obj->size = (FSIZE_t)size;
+
+#if _USE_EXPAND
+    if (size > 0)
+    {
+        res = f_expand(&obj->fil, obj->size, 1);
+        if (res == FR_OK)
+            obj->contiguous = true;
+        else if (res != FR_DENIED)  // FR_DENIED: no contiguous run free, grow as we go
+        {
+            // The host sees the object fail, it must not stay behind empty
+            f_close(&obj->fil);
+            f_unlink(path);
+            return(-mtp_errno(res));
+        }
+    }
+#endif
+    return(0);
+}
+
+
+/*! MtpRingIo_t writer for the object opened by mtp_upload_open().
+ */
+int32_t
+mtp_upload_write(void* obj, uint8_t* data, uint32_t len)
+{
+    MtpUpload_t* up = (MtpUpload_t*)obj;
+    FRESULT res;
+    UINT bw;
+
+    if (res = f_write(&up->fil, data, len, &bw), res != FR_OK)
+        return(-mtp_errno(res));
+    up->written += bw;
+    return(bw);
+}
+
+
+/*! Write out the received data in the ring, see mtp_ring_drain().
+ */
+int32_t
+mtp_upload_drain(MtpUpload_t* obj, MtpRing_t* ring, bool final)
+{
+    return(mtp_ring_drain(ring, mtp_upload_write, obj, final));
+}
+
+
+/*! Close the object, giving back the preallocation that was not used when
+ * fewer bytes came in than announced.
+ */
+int
+mtp_upload_close(MtpUpload_t* obj)
+{
+    FRESULT res = FR_OK;
+
+    if (obj->written < f_size(&obj->fil))
+        res = f_truncate(&obj->fil);
+    if (res == FR_OK)
+        res = f_close(&obj->fil);
+    else
+        f_close(&obj->fil);
+    return(-mtp_errno(res));
+}
+
+
+/*! DeleteObject: remove object 'handle' at 'path', an empty folder
+ * included, and update the handle index. Returns 0 or a negative error
+ * code.
+ */
+int
+mtp_object_delete(uint32_t handle, const char* path)
+{
+    int storage = MTP_HANDLE_STORAGE(handle);
+    int folder;
+    FRESULT res;
+
+    if (res = f_unlink(path), res != FR_OK)
+        return(-mtp_errno(res));
+    if (folder = mtp_index_folder_of(storage, handle), folder > 0)
+        mtp_index_drop_folder(storage, folder);
+    mtp_index_forget(handle);
+    mtp_index_dirty(storage, MTP_HANDLE_FOLDER(handle));
+    return(0);
+}
@@ -0,0 +1,542 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      mtp_proplist.c
+ \brief     Folder wide GetObjectPropList for the MTP responder
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ Explorer and libmtp fill a folder view with one GetObjectPropValue per
+ object and property. GetObjectPropList with the folder (or 0 / 0xFFFFFFFF
+ for the root), property code 0xFFFFFFFF and depth 1 answers all of that in
+ one transaction.
+
+ The dataset opens with the number of elements and the container with its
+ length, so mtp_proplist_begin() first runs over the directory entries to
+ size it. mtp_proplist_fill() then encodes one item at a time into 'buf'
+ and moves it into the transfer ring as space comes free; nothing but the
+ item being sent is held in RAM. Items are entered in the handle index on
+ the way, file number n being the n-th item as with mtp_index_scan().
+ When the folder changed in between, the dataset still ends with the
+ announced number of elements and bytes, see PadBegin().
+****************************************************************************/
+
+#include "mtp_proplist.h"
+#include "mtp_index.h"
+#include "mtp_object.h"
+#include <errno.h>
+#include <string.h>
+
+
+#ifndef MIN
+#define MIN(a, b)   (((a) < (b)) ? (a) : (b))
+#endif
+
+// Datatype codes
+#define MTP_TYPE_UINT16     0x0004
+#define MTP_TYPE_UINT32     0x0006
+#define MTP_TYPE_UINT64     0x0008
+#define MTP_TYPE_UINT128    0x000A
+#define MTP_TYPE_STR        0xFFFF
+
+// Object property codes
+#define MTP_OPC_StorageID           0xDC01
+#define MTP_OPC_ObjectFormat        0xDC02
+#define MTP_OPC_ProtectionStatus    0xDC03
+#define MTP_OPC_ObjectSize          0xDC04
+#define MTP_OPC_ObjectFileName      0xDC07
+#define MTP_OPC_DateCreated         0xDC08
+#define MTP_OPC_DateModified        0xDC09
+#define MTP_OPC_ParentObject        0xDC0B
+#define MTP_OPC_PersistentUniqueObjectIdentifier 0xDC41
+#define MTP_OPC_Name                0xDC44
+
+
+MtpPropList_t vMtpPropList;
+
+static const struct
+{
+    uint16_t    code;
+    uint16_t    type;
+} vProps[] =
+{
+    {MTP_OPC_StorageID,         MTP_TYPE_UINT32},
+    {MTP_OPC_ObjectFormat,      MTP_TYPE_UINT16},
+    {MTP_OPC_ProtectionStatus,  MTP_TYPE_UINT16},
+    {MTP_OPC_ObjectSize,        MTP_TYPE_UINT64},
+    {MTP_OPC_ObjectFileName,    MTP_TYPE_STR},
+    {MTP_OPC_DateCreated,       MTP_TYPE_STR},
+    {MTP_OPC_DateModified,      MTP_TYPE_STR},
+    {MTP_OPC_ParentObject,      MTP_TYPE_UINT32},
+    {MTP_OPC_PersistentUniqueObjectIdentifier, MTP_TYPE_UINT128},
+    {MTP_OPC_Name,              MTP_TYPE_STR},
+};
+
+#define PROP_COUNT  (sizeof(vProps) / sizeof(vProps[0]))
+
+// Largest name element: handle, code, type, count and 255 characters
+#define NAME_ELEMENT_MAX    (8 + 1 + 2 * 255)
+// Smallest element: handle, code, type and an empty string
+#define ELEMENT_MIN         (8 + 1)
+
+static const struct
+{
+    const char  ext[4];
+    uint16_t    format;
+} vFormats[] =
+{
+    {"TXT", 0x3004}, {"HTM", 0x3005}, {"WAV", 0x3008}, {"MP3", 0x3009},
+    {"AVI", 0x300A}, {"MPG", 0x300B}, {"JPG", 0x3801}, {"BMP", 0x3804},
+    {"GIF", 0x3807}, {"PNG", 0x380B}, {"TIF", 0x380D},
+};
+
+
+static uint8_t*
+Put16(uint8_t* p, uint16_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    return(p + 2);
+}
+
+
+static uint8_t*
+Put32(uint8_t* p, uint32_t v)
+{
+    p = Put16(p, v);
+    return(Put16(p, v >> 16));
+}
+
+
+static uint8_t*
+Put64(uint8_t* p, uint64_t v)
+{
+    p = Put32(p, v);
+    return(Put32(p, v >> 32));
+}
+
+
+static uint8_t*
+PutStr(uint8_t* p, const TCHAR* s)
+{
+    uint8_t* n = p++;
+    int len = 0;
+
+    // Number of characters including the terminator, a string has at most 255
+    while ((*s != 0) && (len < 254))
+    {
+#if _USE_LFN && !_LFN_UNICODE
+        p = Put16(p, ff_convert((BYTE)*s++, 1));
+#else
+        p = Put16(p, *s++);
+#endif
+        len++;
+    }
+    if (len == 0)
+    {
+        *n = 0;
+        return(p);
+    }
+    *n = len + 1;
+    return(Put16(p, 0));
+}
+
+
+// FAT date and time as "YYYYMMDDThhmmss"
+static uint8_t*
+PutDate(uint8_t* p, WORD date, WORD time)
+{
+    TCHAR s[16];
+    unsigned v[6] = {1980 + (date >> 9), (date >> 5) & 15, date & 31, time >> 11, (time >> 5) & 63, (time & 31) * 2};
+
+    s[0] = '0' + (v[0] / 1000) % 10;
+    s[1] = '0' + (v[0] / 100) % 10;
+    s[2] = '0' + (v[0] / 10) % 10;
+    s[3] = '0' + v[0] % 10;
+    for (int i = 1, j = 4; i < 6; i++, j += 2)
+    {
+        if (i == 3)
+            s[j++] = 'T';
+        s[j] = '0' + (v[i] / 10) % 10;
+        s[j + 1] = '0' + v[i] % 10;
+    }
+    s[15] = 0;
+    return(PutStr(p, s));
+}
+
+
+static uint16_t
+FormatOf(const FILINFO* fno)
+{
+    const TCHAR* ext;
+
+    if (fno->fattrib & AM_DIR)
+        return(0x3001);     // Association
+    if (ext = strchr(fno->fname, '.'), ext != NULL)
+    {
+        for (int i = 0; i < sizeof(vFormats) / sizeof(vFormats[0]); i++)
+        {
+            if (strncmp(ext + 1, vFormats[i].ext, 3) == 0)
+                return(vFormats[i].format);
+        }
+    }
+    return(0x3000);         // Undefined
+}
+
+
+/*! Encode property 'i' of the item in 'pl->fno' at 'p'. Returns the end
+ * of the element.
+ */
+static uint8_t*
+Element(MtpPropList_t* pl, uint32_t handle, const FILLOC* loc, int i, uint8_t* p)
+{
+    const FILINFO* fno = &pl->fno;
+    const TCHAR* name = fno->fname;
+
+#if VFS_LFNAME
+    if (fno->lfname[0] != 0)
+        name = fno->lfname;
+#endif
+
+    p = Put32(p, handle);
+    p = Put16(p, vProps[i].code);
+    p = Put16(p, vProps[i].type);
+    switch (vProps[i].code)
+    {
+    case MTP_OPC_StorageID:
+        p = Put32(p, ((uint32_t)(pl->storage + 1) << 16) | 1);
+        break;
+    case MTP_OPC_ObjectFormat:
+        p = Put16(p, FormatOf(fno));
+        break;
+    case MTP_OPC_ProtectionStatus:
+        p = Put16(p, (fno->fattrib & AM_RDO) ? 0x0001 : 0x0000);
+        break;
+    case MTP_OPC_ObjectSize:
+        p = Put64(p, (fno->fattrib & AM_DIR) ? 0 : fno->fsize);
+        break;
+    case MTP_OPC_ObjectFileName:
+    case MTP_OPC_Name:
+        p = PutStr(p, name);
+        break;
+    case MTP_OPC_DateCreated:
+        p = PutDate(p, fno->fcdate, fno->fctime);
+        break;
+    case MTP_OPC_DateModified:
+        p = PutDate(p, fno->fdate, fno->ftime);
+        break;
+    case MTP_OPC_ParentObject:
+        p = Put32(p, pl->parent);
+        break;
+    case MTP_OPC_PersistentUniqueObjectIdentifier:
+        // Location of the object on the volume, stable while it is not moved
+        p = Put32(p, handle);
+        p = Put32(p, loc->sclust);
+        p = Put32(p, loc->dclust);
+        p = Put32(p, ((uint32_t)pl->storage << 16) + loc->index);
+        break;
+    }
+    return(p);
+}
+
+
+/*! Add up to '*chars' terminators to the name element that starts at 'e'
+ * and ends at 'p', a string of at most 255 characters. It then takes 2 more
+ * bytes per terminator and still reads as the same name. Returns the new
+ * end of the element.
+ */
+static uint8_t*
+Stretch(uint8_t* e, uint8_t* p, uint32_t* chars)
+{
+    uint32_t add = MIN(*chars, 255 - e[8]);
+
+    e[8] += add;
+    memset(p, 0, 2 * add);
+    *chars -= add;
+    return(p + 2 * add);
+}
+
+
+static bool
+IsName(int i)
+{
+    return((vProps[i].code == MTP_OPC_ObjectFileName) || (vProps[i].code == MTP_OPC_Name));
+}
+
+
+/*! Encode the requested properties of one item into 'pl->buf', with
+ * 'chars' terminators added to its names. Returns the number of bytes,
+ * 'elements' receives the number of elements.
+ */
+static uint16_t
+Encode(MtpPropList_t* pl, uint32_t handle, const FILLOC* loc, uint32_t* elements, uint32_t chars)
+{
+    uint8_t* p = pl->buf;
+
+    *elements = 0;
+    for (int i = 0; i < PROP_COUNT; i++)
+    {
+        uint8_t* e = p;
+
+        if ((pl->prop != MTP_PROPLIST_ALL) && (pl->prop != vProps[i].code))
+            continue;
+        p = Element(pl, handle, loc, i, p);
+        if (IsName(i))
+            p = Stretch(e, p, &chars);
+        (*elements)++;
+    }
+    return(p - pl->buf);
+}
+
+
+/*! The folder changed between the sizing pass and this one and the items
+ * left do not make up the announced elements and bytes. The rest is made
+ * up of copies of elements of the item with the shortest name sent so far:
+ * its name element, stretched as needed, and its smallest other element.
+ * Returns 0 or -EAGAIN when the rest cannot be made up that way, when no
+ * item was sent for one.
+ */
+static int
+PadBegin(MtpPropList_t* pl)
+{
+    uint32_t elements = pl->count - pl->elements;
+    uint32_t bytes = pl->length - pl->sent;
+    uint32_t fixed = 0;
+    uint32_t name = 0;
+    uint32_t k;
+    uint32_t kmax;
+
+    pl->padding = true;
+    if ((elements == 0) || (pl->pad_handle == 0))
+        return(-EAGAIN);
+    if (f_stat_loc(disk_volume(pl->storage), &pl->pad_loc, &pl->fno) != FR_OK)
+        return(-EAGAIN);
+
+    for (int i = 0; i < PROP_COUNT; i++)
+    {
+        uint32_t len;
+
+        if ((pl->prop != MTP_PROPLIST_ALL) && (pl->prop != vProps[i].code))
+            continue;
+        len = Element(pl, pl->pad_handle, &pl->pad_loc, i, pl->buf) - pl->buf;
+        if (IsName(i))
+        {
+            name = len;
+            pl->pad_iname = i;
+        }
+        else if ((fixed == 0) || (len < fixed))
+        {
+            fixed = len;
+            pl->pad_ifixed = i;
+        }
+    }
+
+    // The fewest name elements that bring the bytes within reach
+    k = (fixed == 0) ? elements : 0;
+    kmax = (name == 0) ? 0 : elements;
+    for (; k <= kmax; k++)
+    {
+        uint32_t base = (elements - k) * fixed + k * name;
+
+        if ((bytes >= base) && (((bytes - base) & 1) == 0) &&
+            ((bytes - base) / 2 <= k * ((NAME_ELEMENT_MAX - name) / 2)))
+        {
+            pl->pad_names = k;
+            pl->pad_fixed = elements - k;
+            pl->pad_chars = (bytes - base) / 2;
+            return(0);
+        }
+    }
+    return(-EAGAIN);
+}
+
+
+/*! Encode the next padding element into 'pl->buf'. Returns the number of
+ * bytes.
+ */
+static uint16_t
+Pad(MtpPropList_t* pl)
+{
+    uint8_t* p;
+
+    if (pl->pad_names != 0)
+    {
+        p = Element(pl, pl->pad_handle, &pl->pad_loc, pl->pad_iname, pl->buf);
+        p = Stretch(pl->buf, p, &pl->pad_chars);
+        pl->pad_names--;
+    }
+    else
+    {
+        p = Element(pl, pl->pad_handle, &pl->pad_loc, pl->pad_ifixed, pl->buf);
+        pl->pad_fixed--;
+    }
+    pl->elements++;
+    return(p - pl->buf);
+}
+
+
+/*! Start a GetObjectPropList of all items in 'folder' (see
+ * mtp_index_folder_of()). Returns 0, -EINVAL for a depth other than 1,
+ * -ENOTSUP for an unknown property code or another negative error code.
+ * The dataset is 'pl->length' bytes.
+ */
+int
+mtp_proplist_begin(MtpPropList_t* pl, int storage, int folder, uint32_t prop, uint32_t depth)
+{
+    FILLOC loc;
+    FRESULT res;
+    uint32_t n;
+    int err;
+
+    pl->open = false;
+    if (depth != 1)
+        return(-EINVAL);
+    if (prop != MTP_PROPLIST_ALL)
+    {
+        int i;
+
+        for (i = 0; (i < PROP_COUNT) && (vProps[i].code != prop); i++);
+        if (i == PROP_COUNT)
+            return(-ENOTSUP);
+    }
+
+    if (err = mtp_index_opendir(storage, folder, &pl->dir, &pl->parent), err < 0)
+        return(err);
+#if VFS_LFNAME
+    pl->fno.lfname = pl->lfn;
+    pl->fno.lfsize = sizeof(pl->lfn) / sizeof(pl->lfn[0]);
+#endif
+    pl->storage = storage;
+    pl->folder = folder;
+    pl->prop = prop;
+    pl->count = 0;
+    pl->length = 4;
+
+    // Sizing pass
+    while (res = f_readdir_loc(&pl->dir, &pl->fno, &loc), (res == FR_OK) && (pl->fno.fname[0] != 0))
+    {
+        if (MTP_DOT_ENTRY(&pl->fno))
+            continue;
+        pl->length += Encode(pl, MTP_HANDLE(storage, folder, 1), &loc, &n, 0);
+        pl->count += n;
+    }
+    if ((res != FR_OK) || (res = f_readdir(&pl->dir, NULL), res != FR_OK))
+    {
+        f_closedir(&pl->dir);
+        return(-mtp_errno(res));
+    }
+
+    Put32(pl->buf, pl->count);
+    pl->pending = 4;
+    pl->offset = 0;
+    pl->sent = 0;
+    pl->next = 1;
+    pl->elements = 0;
+    pl->pad_handle = 0;
+    pl->padding = false;
+    pl->open = true;
+    return(0);
+}
+
+
+/*! Move the next part of the dataset into the ring. Returns the number of
+ * bytes added or a negative error code.
+ */
+int32_t
+mtp_proplist_fill(MtpPropList_t* pl, MtpRing_t* ring)
+{
+    int32_t total = 0;
+    FILLOC loc;
+    FRESULT res;
+    uint32_t n;
+    int err;
+
+    while (pl->open && (pl->sent < pl->length))
+    {
+        if (pl->pending == 0)
+        {
+            uint32_t handle = MTP_HANDLE(pl->storage, pl->folder, pl->next);
+
+            while (!pl->padding)
+            {
+                uint32_t elements = pl->count - pl->elements;
+                uint32_t bytes = pl->length - pl->sent;
+
+                do
+                {
+                    if (res = f_readdir_loc(&pl->dir, &pl->fno, &loc), res != FR_OK)
+                        return(-mtp_errno(res));
+                } while ((pl->fno.fname[0] != 0) && MTP_DOT_ENTRY(&pl->fno));
+                if (pl->fno.fname[0] != 0)
+                {
+                    uint16_t len = Encode(pl, handle, &loc, &n, 0);
+
+                    // The last item takes up what its names can of bytes left over
+                    if ((n == elements) && (len < bytes) && (((bytes - len) & 1) == 0))
+                        len = Encode(pl, handle, &loc, &n, (bytes - len) / 2);
+                    if (((n < elements) && (len + (elements - n) * ELEMENT_MIN <= bytes)) ||
+                        ((n == elements) && (len == bytes)))
+                    {
+                        mtp_index_add(handle, &loc, &pl->fno);
+                        if ((pl->pad_handle == 0) || (len < pl->pad_len))
+                        {
+                            pl->pad_handle = handle;
+                            pl->pad_loc = loc;
+                            pl->pad_len = len;
+                        }
+                        pl->pending = len;
+                        pl->elements += n;
+                        pl->next++;
+                        break;
+                    }
+                }
+                // The folder changed since the sizing pass
+                if (err = PadBegin(pl), err < 0)
+                {
+                    pl->open = false;
+                    f_closedir(&pl->dir);
+                    return(err);
+                }
+            }
+            if (pl->padding)
+                pl->pending = Pad(pl);
+            pl->offset = 0;
+        }
+
+        uint32_t len;
+        uint8_t* p = mtp_ring_reserve(ring, 1, &len);
+
+        if (p == NULL)
+            break;
+        len = MIN(len, pl->pending);
+        len = MIN(len, pl->length - pl->sent);
+        memcpy(p, &pl->buf[pl->offset], len);
+        mtp_ring_commit(ring, len);
+        pl->offset += len;
+        pl->pending -= len;
+        pl->sent += len;
+        total += len;
+    }
+    return(total);
+}
+
+
+bool
+mtp_proplist_done(const MtpPropList_t* pl)
+{
+    return(!pl->open || (pl->sent >= pl->length));
+}
+
+
+void
+mtp_proplist_end(MtpPropList_t* pl)
+{
+    if (pl->open)
+        f_closedir(&pl->dir);
+    pl->open = false;
+}
@@ -0,0 +1,314 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      mtp_ring.c
+ \brief     Streaming transfer ring for MTP data phases
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ GetObject fills the ring with whole sectors from the VFS and hands
+ contiguous runs of it to USBD_LL_Transmit, so a single FatFs call feeds
+ many bulk packets. SendObject receives straight into the ring and writes
+ it out in sector multiples.
+
+ The ring is a bip-buffer: the producer only ever gets a contiguous area,
+ when the upper part is too small it wraps to the start and the upper part
+ is marked as ending at 'end'. Producer and consumer must run from the same
+ context (the USB interrupt), there is no locking.
+****************************************************************************/
+
+#include "mtp_ring.h"
+#include "mtp_trace.h"
+#include <string.h>
+
+
+#ifndef syslog
+#define syslog(x,...)
+#endif
+
+#ifndef MIN
+#define MIN(a, b)   (((a) < (b)) ? (a) : (b))
+#endif
+
+
+static uint8_t vMtpRingBuffer[MTP_MEDIA_PACKET] __attribute__((aligned(4)));
+
+MtpRing_t vMtpRing = {vMtpRingBuffer, MTP_MEDIA_PACKET, 0, 0, MTP_MEDIA_PACKET, 0, false, {0}};
+
+
+void
+mtp_ring_init(MtpRing_t* ring, uint8_t* buf, uint32_t size)
+{
+    ring->buf = buf;
+    ring->size = size - (size % MTP_RING_ALIGN);
+    mtp_ring_reset(ring);
+}
+
+
+void
+mtp_ring_reset(MtpRing_t* ring)
+{
+    ring->head = 0;
+    ring->tail = 0;
+    ring->end = ring->size;
+    ring->count = 0;
+    ring->wrapped = false;
+    memset(&ring->stats, 0, sizeof(ring->stats));
+}
+
+
+uint32_t
+mtp_ring_used(const MtpRing_t* ring)
+{
+    return(ring->count);
+}
+
+
+uint32_t
+mtp_ring_free(const MtpRing_t* ring)
+{
+    return(ring->size - ring->count);
+}
+
+
+/*! Get a contiguous area of at least 'min' bytes for the producer, or NULL
+ * when there is none. The whole contiguous area is returned in 'len'.
+ */
+uint8_t*
+mtp_ring_reserve(MtpRing_t* ring, uint32_t min, uint32_t* len)
+{
+    if (ring->count == 0)
+    {
+        // Restart at the bottom so the next transfer gets the full buffer
+        ring->head = 0;
+        ring->tail = 0;
+        ring->end = ring->size;
+        ring->wrapped = false;
+    }
+
+    if (!ring->wrapped)
+    {
+        if (ring->size - ring->tail >= min)
+        {
+            *len = ring->size - ring->tail;
+            return(&ring->buf[ring->tail]);
+        }
+        if (ring->head >= min)
+        {
+            ring->end = ring->tail;
+            ring->tail = 0;
+            ring->wrapped = true;
+            *len = ring->head;
+            return(&ring->buf[0]);
+        }
+    }
+    else if (ring->head - ring->tail >= min)
+    {
+        *len = ring->head - ring->tail;
+        return(&ring->buf[ring->tail]);
+    }
+    *len = 0;
+    return(NULL);
+}
+
+
+void
+mtp_ring_commit(MtpRing_t* ring, uint32_t len)
+{
+    ring->tail += len;
+    ring->count += len;
+}
+
+
+/*! Get the contiguous run of data at the consumer side.
+ */
+uint8_t*
+mtp_ring_peek(MtpRing_t* ring, uint32_t* len)
+{
+    if (ring->count == 0)
+    {
+        *len = 0;
+        return(NULL);
+    }
+    if (ring->wrapped && (ring->head == ring->end))
+    {
+        ring->head = 0;
+        ring->wrapped = false;
+    }
+    *len = (ring->wrapped ? ring->end : ring->tail) - ring->head;
+    return(&ring->buf[ring->head]);
+}
+
+
+void
+mtp_ring_consume(MtpRing_t* ring, uint32_t len)
+{
+    ring->head += len;
+    ring->count -= len;
+    if (ring->wrapped && (ring->head == ring->end))
+    {
+        ring->head = 0;
+        ring->wrapped = false;
+    }
+}
+
+
+/*! Copy a small block (e.g. a container header) into the ring.
+ */
+uint32_t
+mtp_ring_put(MtpRing_t* ring, const void* data, uint32_t len)
+{
+    uint32_t avail;
+    uint8_t* p = mtp_ring_reserve(ring, len, &avail);
+
+    if (p == NULL)
+        return(0);
+    memcpy(p, data, len);
+    mtp_ring_commit(ring, len);
+    return(len);
+}
+
+
+/*! Top up the ring from the disk side. Every call reads whole sectors,
+ * as much as is contiguous, except for the last piece of the object.
+ * Returns the number of bytes added or a negative error code.
+ */
+int32_t
+mtp_ring_fill(MtpRing_t* ring, MtpRingIo_t read, void* ctx, uint32_t remaining)
+{
+    int32_t total = 0;
+
+    MTP_TRACE_ENTER(TRACE_RING_FILL, remaining, ring->count);
+    while (remaining > 0)
+    {
+        uint32_t len;
+        uint8_t* p = mtp_ring_reserve(ring, MIN(remaining, MTP_RING_ALIGN), &len);
+
+        if (p == NULL)
+            break;
+
+        len = MIN(len, remaining);
+        if (len < remaining)
+            len -= len % MTP_RING_ALIGN;
+        if (len == 0)
+            break;
+
+        int32_t n = read(ctx, p, len);
+        ring->stats.disk_calls++;
+        if (n < 0)
+        {
+            MTP_TRACE_EXIT(TRACE_RING_FILL, n, ring->count);
+            return(n);
+        }
+
+        mtp_ring_commit(ring, n);
+        ring->stats.disk_bytes += n;
+        total += n;
+        remaining -= n;
+        if ((uint32_t)n < len)
+            break;  // End of file
+    }
+    MTP_TRACE_EXIT(TRACE_RING_FILL, total, ring->count);
+    return(total);
+}
+
+
+/*! Write out the ring to the disk side in sector multiples once it is at
+ * least half full. With 'final' set, or at the upper end of a wrapped ring,
+ * the remainder goes too.
+ * Returns the number of bytes written or a negative error code.
+ */
+int32_t
+mtp_ring_drain(MtpRing_t* ring, MtpRingIo_t write, void* ctx, bool final)
+{
+    int32_t total = 0;
+    uint32_t len;
+    uint8_t* p;
+
+    if (!final && (ring->count < ring->size / 2))
+        return(0);
+
+    MTP_TRACE_ENTER(TRACE_RING_DRAIN, ring->count, final);
+    while (p = mtp_ring_peek(ring, &len), p != NULL)
+    {
+        if (!final && !ring->wrapped)
+            len -= len % MTP_RING_ALIGN;
+        if (len == 0)
+            break;
+
+        int32_t n = write(ctx, p, len);
+        ring->stats.disk_calls++;
+        if (n < 0)
+        {
+            MTP_TRACE_EXIT(TRACE_RING_DRAIN, n, ring->count);
+            return(n);
+        }
+
+        mtp_ring_consume(ring, n);
+        ring->stats.disk_bytes += n;
+        total += n;
+        if ((uint32_t)n < len)
+            break;  // Disk full
+    }
+    MTP_TRACE_EXIT(TRACE_RING_DRAIN, total, ring->count);
+    return(total);
+}
+
+
+/*! Get the next run to pass to USBD_LL_Transmit, limited to 'max' bytes.
+ * The caller consumes it once the DataIn stage reports completion.
+ */
+uint8_t*
+mtp_ring_tx(MtpRing_t* ring, uint32_t max, uint32_t* len)
+{
+    uint8_t* p = mtp_ring_peek(ring, len);
+
+    if (p != NULL)
+    {
+        *len = MIN(*len, max);
+        ring->stats.usb_calls++;
+        ring->stats.usb_bytes += *len;
+    }
+    return(p);
+}
+
+
+/*! Get an area to pass to USBD_LL_PrepareReceive, a multiple of the
+ * endpoint packet size 'mps'. The caller commits USBD_LL_GetRxDataSize()
+ * bytes from the DataOut stage.
+ */
+uint8_t*
+mtp_ring_rx(MtpRing_t* ring, uint32_t mps, uint32_t* len)
+{
+    uint8_t* p = mtp_ring_reserve(ring, mps, len);
+
+    if (p != NULL)
+    {
+        *len -= *len % mps;
+        ring->stats.usb_calls++;
+        ring->stats.usb_bytes += *len;
+    }
+    return(p);
+}
+
+
+uint32_t
+mtp_ring_bytes_per_call(const MtpRing_t* ring)
+{
+    if (ring->stats.disk_calls == 0)
+        return(0);
+    return(ring->stats.disk_bytes / ring->stats.disk_calls);
+}
+
+
+void
+mtp_ring_report(MtpRing_t* ring, const char* what)
+{
+    syslog(NULL, "%s: %lu bytes in %lu disk calls (%lu B/call), %lu USB requests\n", what,
+           ring->stats.disk_bytes, ring->stats.disk_calls, mtp_ring_bytes_per_call(ring), ring->stats.usb_calls);
+}
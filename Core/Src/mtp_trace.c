@@ -0,0 +1,211 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      mtp_trace.c
+ \brief     Cycle counter trace of the USB, MTP and disk hot paths
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ An event costs a PRIMASK save, a counter read and a few stores, cheap
+ enough to leave on in the field. On the target the timestamp is the DWT
+ cycle counter, which wraps every 39 s at 110 MHz; the decoder works with
+ differences only. The host build has no DWT and takes CLOCK_MONOTONIC in
+ nanoseconds instead.
+
+ The ring keeps the last MTP_TRACE_SIZE events. Tracing pauses while it is
+ being dumped, so the transfer does not overwrite what it is sending.
+****************************************************************************/
+
+#include "mtp_trace.h"
+#include "main.h"
+#include <string.h>
+#if !defined(DWT)
+#include <time.h>
+#endif
+
+
+#ifndef MIN
+#define MIN(a, b)   (((a) < (b)) ? (a) : (b))
+#endif
+
+
+MtpTrace_t vMtpTrace;
+
+
+static inline uint32_t
+Stamp(void)
+{
+#if defined(DWT)
+    return(DWT->CYCCNT);
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return((uint32_t)(ts.tv_sec * 1000000000ULL + ts.tv_nsec));
+#endif
+}
+
+
+void
+mtp_trace_init(void)
+{
+#if defined(DWT)
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+    mtp_trace_clear();
+    vMtpTrace.on = true;
+}
+
+
+void
+mtp_trace_enable(bool on)
+{
+    vMtpTrace.on = on;
+}
+
+
+void
+mtp_trace_clear(void)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    vMtpTrace.head = 0;
+    vMtpTrace.tail = 0;
+    __set_PRIMASK(primask);
+}
+
+
+/*! Timestamp clock in Hz.
+ */
+uint32_t
+mtp_trace_hz(void)
+{
+#if defined(DWT)
+    return(SystemCoreClock);
+#else
+    return(1000000000UL);
+#endif
+}
+
+
+/*! Record an event, see MTP_TRACE_ENTER() and MTP_TRACE_EXIT(). Callable
+ * from any interrupt level.
+ */
+void
+mtp_trace_event(uint16_t id, uint32_t a0, uint32_t a1)
+{
+    MtpTraceEvent_t* ev;
+    uint32_t primask;
+
+    if (!vMtpTrace.on)
+        return;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    ev = &vMtpTrace.ev[vMtpTrace.head & (MTP_TRACE_SIZE - 1)];
+    ev->stamp = Stamp();
+    ev->id = id;
+    ev->seq = (uint16_t)vMtpTrace.head++;
+    ev->a0 = a0;
+    ev->a1 = a1;
+    __set_PRIMASK(primask);
+}
+
+
+/*! Start the data phase of MTP_OC_WB_GetTrace: all events since the last
+ * clearing dump that are still in the ring. Returns the dataset length.
+ */
+int
+mtp_trace_begin(MtpTraceDump_t* dump, bool clear)
+{
+    dump->was_on = vMtpTrace.on;
+    vMtpTrace.on = false;
+
+    dump->end = vMtpTrace.head;
+    dump->next = vMtpTrace.tail;
+    if (dump->end - dump->next > MTP_TRACE_SIZE)
+        dump->next = dump->end - MTP_TRACE_SIZE;
+
+    dump->hdr.magic = MTP_TRACE_MAGIC;
+    dump->hdr.version = MTP_TRACE_VERSION;
+    dump->hdr.size = sizeof(MtpTraceEvent_t);
+    dump->hdr.hz = mtp_trace_hz();
+    dump->hdr.count = dump->end - dump->next;
+    dump->hdr.lost = dump->next - vMtpTrace.tail;
+    dump->offset = 0;
+    dump->clear = clear;
+    dump->open = true;
+    return(sizeof(MtpTraceHeader_t) + dump->hdr.count * sizeof(MtpTraceEvent_t));
+}
+
+
+/*! Move the next part of the dump into the ring. Returns the number of
+ * bytes added.
+ */
+int32_t
+mtp_trace_fill(MtpTraceDump_t* dump, MtpRing_t* ring)
+{
+    int32_t total = 0;
+
+    while (!mtp_trace_done(dump))
+    {
+        const uint8_t* item;
+        uint32_t size, len;
+        uint8_t* p;
+
+        if (dump->offset < sizeof(MtpTraceHeader_t))
+        {
+            item = (const uint8_t*)&dump->hdr + dump->offset;
+            size = sizeof(MtpTraceHeader_t) - dump->offset;
+        }
+        else
+        {
+            uint32_t at = dump->offset - sizeof(MtpTraceHeader_t);
+
+            item = (const uint8_t*)&vMtpTrace.ev[dump->next & (MTP_TRACE_SIZE - 1)] + at;
+            size = sizeof(MtpTraceEvent_t) - at;
+        }
+
+        if (p = mtp_ring_reserve(ring, 1, &len), p == NULL)
+            break;
+        len = MIN(len, size);
+        memcpy(p, item, len);
+        mtp_ring_commit(ring, len);
+        total += len;
+
+        dump->offset += len;
+        if (dump->offset == sizeof(MtpTraceHeader_t) + sizeof(MtpTraceEvent_t))
+        {
+            dump->offset = sizeof(MtpTraceHeader_t);
+            dump->next++;
+        }
+    }
+    return(total);
+}
+
+
+bool
+mtp_trace_done(const MtpTraceDump_t* dump)
+{
+    return(!dump->open || ((dump->offset >= sizeof(MtpTraceHeader_t)) && (dump->next == dump->end)));
+}
+
+
+/*! End the dump, a complete clearing dump consumes the events it sent.
+ */
+void
+mtp_trace_end(MtpTraceDump_t* dump)
+{
+    if (dump->open && dump->clear && mtp_trace_done(dump))
+        vMtpTrace.tail = dump->end;
+    dump->open = false;
+    vMtpTrace.on = dump->was_on;
+}
@@ -0,0 +1,918 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      nor_ftl.c
+ \brief     Flash translation layer for the octal NOR
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ The 64 MB MX25LM51245G erases in 64 KB blocks and writes in pages, a disk
+ of 512 byte sectors on top of it has to avoid rewriting a block for every
+ sector. The FTL is log structured: data goes in 4 KB pages to the next
+ free page of the active block, a RAM map gives the current location of
+ every logical page, and a superseded page is only marked dead. The
+ collector reclaims blocks by moving their live pages to the active block
+ and erasing them.
+
+ Every block starts with a summary page:
+
+   0    magic, erase count      written after the erase
+   16   sequence, base          written when the block is opened
+   32   15 x logical page       written after the page data
+   272  15 x dead marker        zeroed when the page is superseded
+
+ Each 16 byte unit is programmed once. At start up the summaries rebuild
+ the map; of two copies of a page the one in the block with the higher
+ sequence wins. ftl_format() raises the base, blocks below it are void.
+
+ Sectors are gathered in a small write back cache of pages, so FatFs
+ writing a FAT or directory sector at a time does not cost a page each.
+ ftl_poll(), from the main loop, flushes the cache when writes stop,
+ collects free blocks ahead of demand and evens out wear by moving the
+ data of the least erased block when the spread grows too large.
+
+ The FTL runs in the USB interrupt, ftl_poll() works with it masked. The
+ erases it starts run on in the background; a read suspends them (see
+ nor_io.c), a program waits for them.
+****************************************************************************/
+
+#include "nor_ftl.h"
+#include "main.h"
+#include "nor_io.h"
+#include <errno.h>
+#include <string.h>
+
+
+#ifndef MIN
+#define MIN(a, b)   (((a) < (b)) ? (a) : (b))
+#endif
+
+#define FTL_MAGIC           0x314C5446  // "FTL1"
+#define FTL_NONE            0xFFFF
+#define FTL_FREE            0xFFFFFFFF
+#define FTL_NO_BLOCK        0xFFFFFFFF
+#define FTL_FULL            ((1 << FTL_PAGE_SECTORS) - 1)
+
+#define BLOCK_ADDR(b)       (FTL_BASE + (uint32_t)(b) * FTL_BLOCK_SIZE)
+#define PAGE_ADDR(ppn)      (BLOCK_ADDR((ppn) / FTL_DATA_PAGES) + ((ppn) % FTL_DATA_PAGES + 1) * FTL_PAGE_SIZE)
+#define UNIT_ADDR(b, u)     (BLOCK_ADDR(b) + (u) * sizeof(FtlUnit_t))
+
+#if (FTL_BLOCKS * FTL_DATA_PAGES >= FTL_NONE)
+#error FTL_BLOCKS too large for 16 bit page numbers
+#endif
+
+typedef enum
+{
+    BLK_BLANK = 0,      // Reads erased but has no header, checked before use
+    BLK_ERASED,
+    BLK_ACTIVE,
+    BLK_USED,
+    BLK_DIRTY,          // Invalid or void, to be erased
+    BLK_ERASING,
+    BLK_BAD,
+} FtlBlock_t;
+
+typedef struct
+{
+    uint32_t    w[4];
+} FtlUnit_t;
+
+// First 512 bytes of a block
+typedef struct
+{
+    uint32_t    magic;
+    uint32_t    erases;
+    uint32_t    pad0[2];
+    uint32_t    seq;
+    uint32_t    base;
+    uint32_t    pad1[2];
+    FtlUnit_t   lpn[FTL_DATA_PAGES];
+    FtlUnit_t   dead[FTL_DATA_PAGES];
+} FtlSummary_t;
+
+#define UNIT_SEQ            1
+#define UNIT_LPN(p)         (2 + (p))
+#define UNIT_DEAD(p)        (2 + FTL_DATA_PAGES + (p))
+
+typedef struct
+{
+    uint32_t    lpn;        // FTL_FREE for an unused slot
+    uint32_t    used;       // LRU stamp
+    uint8_t     have;       // Sectors present
+    uint8_t     dirty;      // Sectors written
+    uint32_t    data[FTL_PAGE_SIZE / 4];
+} FtlCache_t;
+
+
+static uint16_t vMap[FTL_LOGICAL_PAGES];    // Physical page of every logical page or FTL_NONE
+static uint32_t vErases[FTL_BLOCKS];
+static uint32_t vSeqOf[FTL_BLOCKS];
+static uint8_t  vValid[FTL_BLOCKS];         // Live pages per block
+static uint8_t  vState[FTL_BLOCKS];
+static FtlCache_t vCache[FTL_CACHE_PAGES];
+static uint32_t vScratch[FTL_PAGE_SIZE / 4];
+static FtlSummary_t vSummary;
+
+static struct
+{
+    bool        ready;
+    bool        collecting;     // Blocks opened by the collector do not collect themselves
+    uint32_t    seq;
+    uint32_t    base;
+    uint32_t    active;
+    uint32_t    next;           // Next free page of the active block
+    uint32_t    erasing;
+    uint32_t    victim;         // Block being emptied by ftl_poll()
+    uint32_t    victim_page;
+    uint32_t    victim_lpn[FTL_DATA_PAGES];
+    uint32_t    tick;
+    uint32_t    last_write;
+    uint32_t    relocated;
+    uint32_t    programmed;
+} vFtl = {.active = FTL_NO_BLOCK, .erasing = FTL_NO_BLOCK, .victim = FTL_NO_BLOCK};
+
+
+static int  FinishErase(int result);
+
+
+/*! Wait for an erase started by the collector, the NOR does not read while
+ * it erases.
+ */
+static int
+NorIdle(void)
+{
+    if (vFtl.erasing == FTL_NO_BLOCK)
+        return(0);
+    return(FinishErase(nor_wait()));
+}
+
+
+// Live pages are never in the block being erased, nor_read() suspends the erase
+static int
+NorRead(uint32_t addr, void* buf, uint32_t len)
+{
+    return(nor_read(addr, buf, len));
+}
+
+
+static int
+NorProgram(uint32_t addr, const void* buf, uint32_t len)
+{
+    NorIdle();
+    return(nor_program(addr, buf, len));
+}
+
+
+static int
+NorUnit(uint32_t block, uint32_t unit, uint32_t a, uint32_t b)
+{
+    FtlUnit_t u = {{a, b, FTL_FREE, FTL_FREE}};
+
+    return(NorProgram(UNIT_ADDR(block, unit), &u, sizeof(u)));
+}
+
+
+static bool
+IsErased(const uint32_t* p, uint32_t len)
+{
+    for (uint32_t i = 0; i < len / 4; i++)
+    {
+        if (p[i] != FTL_FREE)
+            return(false);
+    }
+    return(true);
+}
+
+
+/*! Start erasing 'block', FinishErase() completes it with the result of
+ * nor_wait() or nor_busy().
+ */
+static int
+StartErase(uint32_t block)
+{
+    NorIdle();
+    if (vFtl.victim == block)
+        vFtl.victim = FTL_NO_BLOCK;
+    if (nor_erase(BLOCK_ADDR(block), FTL_BLOCK_SIZE) < 0)
+    {
+        vState[block] = BLK_BAD;
+        return(-EIO);
+    }
+    vState[block] = BLK_ERASING;
+    vFtl.erasing = block;
+    return(0);
+}
+
+
+static int
+FinishErase(int result)
+{
+    uint32_t block = vFtl.erasing;
+
+    vFtl.erasing = FTL_NO_BLOCK;
+    if (result < 0)
+    {
+        vState[block] = BLK_BAD;
+        return(-EIO);
+    }
+    vErases[block]++;
+    if (NorUnit(block, 0, FTL_MAGIC, vErases[block]) < 0)
+    {
+        vState[block] = BLK_BAD;
+        return(-EIO);
+    }
+    vState[block] = BLK_ERASED;
+    return(0);
+}
+
+
+static uint32_t
+CountBlocks(FtlBlock_t state)
+{
+    uint32_t n = 0;
+
+    for (uint32_t b = 0; b < FTL_BLOCKS; b++)
+    {
+        if (vState[b] == state)
+            n++;
+    }
+    return(n);
+}
+
+
+static uint32_t
+FreeBlocks(void)
+{
+    return(CountBlocks(BLK_ERASED) + CountBlocks(BLK_BLANK) + CountBlocks(BLK_ERASING));
+}
+
+
+/*! The block to collect: a void one, else the one with the fewest live
+ * pages, or with 'wear' the least erased one.
+ */
+static uint32_t
+PickVictim(bool wear)
+{
+    uint32_t victim = FTL_NO_BLOCK;
+
+    for (uint32_t b = 0; b < FTL_BLOCKS; b++)
+    {
+        if (vState[b] == BLK_DIRTY)
+            return(b);
+        if (vState[b] != BLK_USED)
+            continue;
+        if ((victim == FTL_NO_BLOCK) ||
+            (wear ? (vErases[b] < vErases[victim]) : (vValid[b] < vValid[victim])))
+            victim = b;
+    }
+    if ((victim != FTL_NO_BLOCK) && !wear && (vValid[victim] == FTL_DATA_PAGES))
+        return(FTL_NO_BLOCK);   // Nothing to gain
+    return(victim);
+}
+
+
+static int OpenBlock(void);
+
+
+/*! Write 'data' as logical page 'lpn' to the next free page. The previous
+ * copy is marked dead unless 'relocate', the collector erases it anyway.
+ */
+static int
+WritePage(uint32_t lpn, const void* data, bool relocate)
+{
+    uint32_t old, ppn;
+    int err;
+
+    if ((vFtl.active == FTL_NO_BLOCK) || (vFtl.next == FTL_DATA_PAGES))
+    {
+        if (err = OpenBlock(), err < 0)
+            return(err);
+    }
+    ppn = vFtl.active * FTL_DATA_PAGES + vFtl.next;
+    vFtl.next++;
+
+    if ((err = NorProgram(PAGE_ADDR(ppn), data, FTL_PAGE_SIZE), err < 0) ||
+        (err = NorUnit(vFtl.active, UNIT_LPN(ppn % FTL_DATA_PAGES), lpn, FTL_FREE), err < 0))
+        return(err);
+
+    old = vMap[lpn];
+    if (old != FTL_NONE)
+    {
+        vValid[old / FTL_DATA_PAGES]--;
+        if (!relocate)
+            NorUnit(old / FTL_DATA_PAGES, UNIT_DEAD(old % FTL_DATA_PAGES), 0, FTL_FREE);
+    }
+    vMap[lpn] = ppn;
+    vValid[vFtl.active]++;
+    vFtl.programmed++;
+    return(0);
+}
+
+
+/*! Take the live pages out of 'victim', 'count' at most. Returns the
+ * number of live pages left.
+ */
+static int
+Relocate(uint32_t victim, uint32_t* page, const uint32_t* lpns, int count)
+{
+    int err;
+
+    while ((*page < FTL_DATA_PAGES) && (vValid[victim] > 0) && (count > 0))
+    {
+        uint32_t ppn = victim * FTL_DATA_PAGES + *page;
+        uint32_t lpn = lpns[*page];
+
+        (*page)++;
+        if ((lpn >= FTL_LOGICAL_PAGES) || (vMap[lpn] != ppn))
+            continue;
+        if ((err = NorRead(PAGE_ADDR(ppn), vScratch, FTL_PAGE_SIZE), err < 0) ||
+            (err = WritePage(lpn, vScratch, true), err < 0))
+            return(err);
+        vFtl.relocated++;
+        count--;
+    }
+    return(vValid[victim]);
+}
+
+
+static int
+ReadLpns(uint32_t victim, uint32_t* lpns)
+{
+    int err;
+
+    if (err = NorRead(BLOCK_ADDR(victim), &vSummary, sizeof(vSummary)), err < 0)
+        return(err);
+    for (int p = 0; p < FTL_DATA_PAGES; p++)
+        lpns[p] = vSummary.lpn[p].w[0];
+    return(0);
+}
+
+
+/*! Reclaim one block, waiting for its erase.
+ */
+static int
+Collect(void)
+{
+    uint32_t lpns[FTL_DATA_PAGES];
+    uint32_t victim = PickVictim(false);
+    uint32_t page = 0;
+    int err;
+
+    if (victim == FTL_NO_BLOCK)
+        return(-ENOSPC);
+    if (vFtl.victim == victim)
+        vFtl.victim = FTL_NO_BLOCK;
+
+    vFtl.collecting = true;
+    if (vValid[victim] > 0)
+    {
+        if ((err = ReadLpns(victim, lpns), err < 0) ||
+            (err = Relocate(victim, &page, lpns, FTL_DATA_PAGES), err < 0))
+        {
+            vFtl.collecting = false;
+            return(err);
+        }
+    }
+    vFtl.collecting = false;
+    if (err = StartErase(victim), err < 0)
+        return(err);
+    return(NorIdle());
+}
+
+
+/*! Open the erased block with the fewest erases for writing.
+ */
+static int
+OpenBlock(void)
+{
+    uint32_t block = FTL_NO_BLOCK;
+    int err;
+
+    if (!vFtl.collecting)
+    {
+        while (FreeBlocks() <= FTL_GC_LOW)
+        {
+            if (err = Collect(), err < 0)
+                break;
+        }
+    }
+    NorIdle();
+
+    for (uint32_t b = 0; b < FTL_BLOCKS; b++)
+    {
+        if (((vState[b] == BLK_ERASED) || (vState[b] == BLK_BLANK)) &&
+            ((block == FTL_NO_BLOCK) || (vErases[b] < vErases[block])))
+            block = b;
+    }
+    if (block == FTL_NO_BLOCK)
+        return(-ENOSPC);
+
+    if (vState[block] == BLK_BLANK)
+    {
+        // Looked erased at start up, make sure all of it is
+        for (uint32_t off = 0; off < FTL_BLOCK_SIZE; off += FTL_PAGE_SIZE)
+        {
+            if (err = NorRead(BLOCK_ADDR(block) + off, vScratch, FTL_PAGE_SIZE), err < 0)
+                return(err);
+            if (!IsErased(vScratch, FTL_PAGE_SIZE))
+            {
+                vErases[block]--;   // FinishErase() counts it
+                if ((err = StartErase(block), err < 0) || (err = NorIdle(), err < 0))
+                    return(err);
+                break;
+            }
+        }
+        if (vState[block] == BLK_BLANK)
+        {
+            if (err = NorUnit(block, 0, FTL_MAGIC, vErases[block]), err < 0)
+                return(err);
+        }
+    }
+
+    if (err = NorUnit(block, UNIT_SEQ, vFtl.seq + 1, vFtl.base), err < 0)
+    {
+        vState[block] = BLK_BAD;
+        return(err);
+    }
+    vFtl.seq++;
+    if (vFtl.active != FTL_NO_BLOCK)
+        vState[vFtl.active] = BLK_USED;
+    vSeqOf[block] = vFtl.seq;
+    vState[block] = BLK_ACTIVE;
+    vValid[block] = 0;
+    vFtl.active = block;
+    vFtl.next = 0;
+    return(0);
+}
+
+
+static FtlCache_t*
+CacheFind(uint32_t lpn)
+{
+    for (int i = 0; i < FTL_CACHE_PAGES; i++)
+    {
+        if (vCache[i].lpn == lpn)
+            return(&vCache[i]);
+    }
+    return(NULL);
+}
+
+
+/*! Read sectors 'first' to 'first + n' of a page from the NOR.
+ */
+static int
+LoadSectors(uint32_t lpn, uint32_t first, uint32_t n, uint8_t* buf)
+{
+    if (vMap[lpn] == FTL_NONE)
+    {
+        memset(buf, 0, n * FTL_SECTOR_SIZE);
+        return(0);
+    }
+    return(NorRead(PAGE_ADDR(vMap[lpn]) + first * FTL_SECTOR_SIZE, buf, n * FTL_SECTOR_SIZE));
+}
+
+
+static int
+CacheFlush(FtlCache_t* c)
+{
+    uint8_t* data = (uint8_t*)c->data;
+    int err;
+
+    if ((c->lpn == FTL_FREE) || (c->dirty == 0))
+        return(0);
+    for (uint32_t s = 0; s < FTL_PAGE_SECTORS; s++)
+    {
+        if ((c->have & (1 << s)) == 0)
+        {
+            if (err = LoadSectors(c->lpn, s, 1, data + s * FTL_SECTOR_SIZE), err < 0)
+                return(err);
+        }
+    }
+    c->have = FTL_FULL;
+    if (err = WritePage(c->lpn, c->data, false), err < 0)
+        return(err);
+    c->dirty = 0;
+    return(0);
+}
+
+
+static FtlCache_t*
+CacheGet(uint32_t lpn, int* err)
+{
+    FtlCache_t* c = CacheFind(lpn);
+
+    *err = 0;
+    if (c != NULL)
+        return(c);
+
+    c = &vCache[0];
+    for (int i = 1; i < FTL_CACHE_PAGES; i++)
+    {
+        if ((vCache[i].lpn == FTL_FREE) || ((c->lpn != FTL_FREE) && (vCache[i].used < c->used)))
+            c = &vCache[i];
+    }
+    if ((c->lpn != FTL_FREE) && (*err = CacheFlush(c), *err < 0))
+        return(NULL);
+    c->lpn = lpn;
+    c->have = 0;
+    c->dirty = 0;
+    return(c);
+}
+
+
+/*! Rebuild the map from the block summaries.
+ */
+int
+ftl_init(void)
+{
+    uint32_t known = 0, total = 0;
+    uint32_t top = FTL_NO_BLOCK;
+
+    if (vFtl.ready)
+        return(0);
+    if (nor_init() < 0)
+        return(-EIO);
+
+    memset(vMap, 0xFF, sizeof(vMap));
+    memset(vValid, 0, sizeof(vValid));
+    for (int i = 0; i < FTL_CACHE_PAGES; i++)
+        vCache[i].lpn = FTL_FREE;
+    vFtl.seq = 0;
+    vFtl.base = 0;
+    vFtl.active = FTL_NO_BLOCK;
+    vFtl.erasing = FTL_NO_BLOCK;
+    vFtl.victim = FTL_NO_BLOCK;
+
+    // Headers
+    for (uint32_t b = 0; b < FTL_BLOCKS; b++)
+    {
+        if (NorRead(BLOCK_ADDR(b), &vSummary, 32) < 0)
+            return(-EIO);
+        vErases[b] = 0;
+        vSeqOf[b] = 0;
+        if (vSummary.magic == FTL_MAGIC)
+        {
+            vErases[b] = vSummary.erases;
+            known++;
+            total += vSummary.erases;
+            if (vSummary.seq == FTL_FREE)
+            {
+                vState[b] = BLK_ERASED;
+                continue;
+            }
+            vState[b] = BLK_USED;
+            vSeqOf[b] = vSummary.seq;
+            if ((top == FTL_NO_BLOCK) || (vSummary.seq > vFtl.seq))
+            {
+                top = b;
+                vFtl.seq = vSummary.seq;
+                vFtl.base = vSummary.base;
+            }
+        }
+        else if (IsErased(&vSummary.magic, 32))
+            vState[b] = BLK_BLANK;
+        else
+            vState[b] = BLK_DIRTY;
+    }
+
+    // Pages, the newest copy wins
+    for (uint32_t b = 0; b < FTL_BLOCKS; b++)
+    {
+        if ((vState[b] == BLK_ERASED) || (vState[b] == BLK_BLANK))
+            continue;
+        if (vState[b] == BLK_DIRTY)
+        {
+            vErases[b] = known ? total / known : 0;
+            continue;
+        }
+        if (vSeqOf[b] < vFtl.base)
+        {
+            vState[b] = BLK_DIRTY;  // Formatted away
+            continue;
+        }
+        if (NorRead(BLOCK_ADDR(b), &vSummary, sizeof(vSummary)) < 0)
+            return(-EIO);
+        for (uint32_t p = 0; p < FTL_DATA_PAGES; p++)
+        {
+            uint32_t lpn = vSummary.lpn[p].w[0];
+            uint32_t ppn = b * FTL_DATA_PAGES + p;
+            uint32_t old;
+
+            if ((lpn >= FTL_LOGICAL_PAGES) || (vSummary.dead[p].w[0] != FTL_FREE))
+                continue;
+            old = vMap[lpn];
+            if (old != FTL_NONE)
+            {
+                if ((vSeqOf[old / FTL_DATA_PAGES] > vSeqOf[b]) || ((old / FTL_DATA_PAGES == b) && (old > ppn)))
+                    continue;
+                vValid[old / FTL_DATA_PAGES]--;
+            }
+            vMap[lpn] = ppn;
+            vValid[b]++;
+        }
+    }
+    for (uint32_t b = 0; b < FTL_BLOCKS; b++)
+    {
+        if ((vState[b] == BLK_BLANK) && known)
+            vErases[b] = total / known;
+    }
+
+    // Carry on in the newest block, past a page that was cut short
+    if ((top != FTL_NO_BLOCK) && (vState[top] == BLK_USED))
+    {
+        if (NorRead(BLOCK_ADDR(top), &vSummary, sizeof(vSummary)) < 0)
+            return(-EIO);
+        vFtl.next = FTL_DATA_PAGES;
+        for (uint32_t p = FTL_DATA_PAGES; p > 0; p--)
+        {
+            if ((vSummary.lpn[p - 1].w[0] != FTL_FREE) || (vSummary.dead[p - 1].w[0] != FTL_FREE))
+                break;
+            vFtl.next = p - 1;
+        }
+        if (vFtl.next < FTL_DATA_PAGES)
+        {
+            vFtl.active = top;
+            vState[top] = BLK_ACTIVE;
+            if (NorRead(PAGE_ADDR(top * FTL_DATA_PAGES + vFtl.next), vScratch, FTL_PAGE_SIZE) < 0)
+                return(-EIO);
+            if (!IsErased(vScratch, FTL_PAGE_SIZE))
+                NorUnit(top, UNIT_DEAD(vFtl.next++), 0, FTL_FREE);
+        }
+    }
+
+    vFtl.ready = true;
+    return(0);
+}
+
+
+bool
+ftl_ready(void)
+{
+    return(vFtl.ready);
+}
+
+
+uint32_t
+ftl_sectors(void)
+{
+    return(vFtl.ready ? FTL_LOGICAL_PAGES * FTL_PAGE_SECTORS : 0);
+}
+
+
+int
+ftl_read(uint8_t* buf, uint32_t sector, uint32_t count)
+{
+    int err;
+
+    if (!vFtl.ready)
+        return(-ENODEV);
+    if ((sector >= FTL_LOGICAL_PAGES * FTL_PAGE_SECTORS) || (count > FTL_LOGICAL_PAGES * FTL_PAGE_SECTORS - sector))
+        return(-EINVAL);
+
+    while (count > 0)
+    {
+        uint32_t lpn = sector / FTL_PAGE_SECTORS;
+        uint32_t first = sector % FTL_PAGE_SECTORS;
+        uint32_t n = MIN(count, FTL_PAGE_SECTORS - first);
+        FtlCache_t* c = CacheFind(lpn);
+
+        if (c == NULL)
+        {
+            if (err = LoadSectors(lpn, first, n, buf), err < 0)
+                return(err);
+        }
+        else
+        {
+            for (uint32_t s = first; s < first + n; s++)
+            {
+                if (c->have & (1 << s))
+                    memcpy(buf + (s - first) * FTL_SECTOR_SIZE, (uint8_t*)c->data + s * FTL_SECTOR_SIZE, FTL_SECTOR_SIZE);
+                else if (err = LoadSectors(lpn, s, 1, buf + (s - first) * FTL_SECTOR_SIZE), err < 0)
+                    return(err);
+            }
+        }
+        buf += n * FTL_SECTOR_SIZE;
+        sector += n;
+        count -= n;
+    }
+    return(0);
+}
+
+
+int
+ftl_write(const uint8_t* buf, uint32_t sector, uint32_t count)
+{
+    int err;
+
+    if (!vFtl.ready)
+        return(-ENODEV);
+    if ((sector >= FTL_LOGICAL_PAGES * FTL_PAGE_SECTORS) || (count > FTL_LOGICAL_PAGES * FTL_PAGE_SECTORS - sector))
+        return(-EINVAL);
+
+    while (count > 0)
+    {
+        uint32_t lpn = sector / FTL_PAGE_SECTORS;
+        uint32_t first = sector % FTL_PAGE_SECTORS;
+        uint32_t n = MIN(count, FTL_PAGE_SECTORS - first);
+        uint8_t mask = ((1 << n) - 1) << first;
+        FtlCache_t* c = CacheGet(lpn, &err);
+
+        if (c == NULL)
+            return(err);
+        memcpy((uint8_t*)c->data + first * FTL_SECTOR_SIZE, buf, n * FTL_SECTOR_SIZE);
+        c->have |= mask;
+        c->dirty |= mask;
+        c->used = ++vFtl.tick;
+
+        buf += n * FTL_SECTOR_SIZE;
+        sector += n;
+        count -= n;
+    }
+    vFtl.last_write = HAL_GetTick();
+    return(0);
+}
+
+
+/*! Write out the cache.
+ */
+int
+ftl_sync(void)
+{
+    int err;
+
+    if (!vFtl.ready)
+        return(-ENODEV);
+    for (int i = 0; i < FTL_CACHE_PAGES; i++)
+    {
+        if ((vCache[i].lpn != FTL_FREE) && (err = CacheFlush(&vCache[i]), err < 0))
+            return(err);
+    }
+    return(NorIdle());
+}
+
+
+/*! Drop the pages that lie entirely within the sectors, they read as zeros
+ * after that.
+ */
+int
+ftl_trim(uint32_t sector, uint32_t count)
+{
+    uint32_t lpn = (sector + FTL_PAGE_SECTORS - 1) / FTL_PAGE_SECTORS;
+    uint32_t end = (sector + count) / FTL_PAGE_SECTORS;
+
+    if (!vFtl.ready)
+        return(-ENODEV);
+    if ((sector >= FTL_LOGICAL_PAGES * FTL_PAGE_SECTORS) || (count > FTL_LOGICAL_PAGES * FTL_PAGE_SECTORS - sector))
+        return(-EINVAL);
+
+    for (; lpn < end; lpn++)
+    {
+        FtlCache_t* c = CacheFind(lpn);
+        uint32_t ppn = vMap[lpn];
+
+        if (c != NULL)
+        {
+            c->lpn = FTL_FREE;
+            c->have = 0;
+            c->dirty = 0;
+        }
+        if (ppn == FTL_NONE)
+            continue;
+        vMap[lpn] = FTL_NONE;
+        vValid[ppn / FTL_DATA_PAGES]--;
+        if (NorUnit(ppn / FTL_DATA_PAGES, UNIT_DEAD(ppn % FTL_DATA_PAGES), 0, FTL_FREE) < 0)
+            return(-EIO);
+    }
+    return(0);
+}
+
+
+/*! Empty the disk. The blocks are erased as they are needed, a new base
+ * sequence in the next block opened voids them.
+ */
+int
+ftl_format(void)
+{
+    if (!vFtl.ready)
+        return(-ENODEV);
+
+    NorIdle();
+    for (int i = 0; i < FTL_CACHE_PAGES; i++)
+    {
+        vCache[i].lpn = FTL_FREE;
+        vCache[i].have = 0;
+        vCache[i].dirty = 0;
+    }
+    memset(vMap, 0xFF, sizeof(vMap));
+    memset(vValid, 0, sizeof(vValid));
+    for (uint32_t b = 0; b < FTL_BLOCKS; b++)
+    {
+        if ((vState[b] == BLK_USED) || (vState[b] == BLK_ACTIVE))
+            vState[b] = BLK_DIRTY;
+    }
+    vFtl.active = FTL_NO_BLOCK;
+    vFtl.victim = FTL_NO_BLOCK;
+    vFtl.base = vFtl.seq + 1;
+    return(OpenBlock());
+}
+
+
+/*! Background work, to be called from the main loop: completes an erase,
+ * flushes the cache once writes stopped and reclaims a block ahead of
+ * demand, one page at a time.
+ */
+void
+ftl_poll(void)
+{
+    uint32_t emin = UINT32_MAX, emax = 0;
+    uint32_t irq;
+    bool wear = false;
+
+    if (!vFtl.ready)
+        return;
+
+    FTL_LOCK(irq);
+    if (vFtl.erasing != FTL_NO_BLOCK)
+    {
+        int result = nor_busy();
+
+        if (result == 1)
+        {
+            FTL_UNLOCK(irq);
+            return;
+        }
+        FinishErase(result);
+    }
+
+    for (int i = 0; i < FTL_CACHE_PAGES; i++)
+    {
+        if ((vCache[i].lpn != FTL_FREE) && (vCache[i].dirty != 0) && (HAL_GetTick() - vFtl.last_write >= FTL_FLUSH_MS))
+        {
+            CacheFlush(&vCache[i]);
+            FTL_UNLOCK(irq);
+            return;
+        }
+    }
+
+    if (vFtl.victim == FTL_NO_BLOCK)
+    {
+        if (FreeBlocks() >= FTL_GC_HIGH)
+        {
+            for (uint32_t b = 0; b < FTL_BLOCKS; b++)
+            {
+                if (vState[b] == BLK_USED)
+                    emin = MIN(emin, vErases[b]);
+                if ((vState[b] != BLK_BAD) && (vErases[b] > emax))
+                    emax = vErases[b];
+            }
+            wear = (emin != UINT32_MAX) && (emax - emin > FTL_WEAR_DELTA);
+            if (!wear)
+            {
+                FTL_UNLOCK(irq);
+                return;
+            }
+        }
+        vFtl.victim = PickVictim(wear);
+        vFtl.victim_page = 0;
+        if ((vFtl.victim == FTL_NO_BLOCK) || (ReadLpns(vFtl.victim, vFtl.victim_lpn) < 0))
+        {
+            vFtl.victim = FTL_NO_BLOCK;
+            FTL_UNLOCK(irq);
+            return;
+        }
+    }
+
+    // One page per call, the USB interrupt is kept waiting meanwhile
+    vFtl.collecting = true;
+    int left = Relocate(vFtl.victim, &vFtl.victim_page, vFtl.victim_lpn, 1);
+    vFtl.collecting = false;
+    if (left == 0)
+        StartErase(vFtl.victim);
+    else if ((left < 0) || (vFtl.victim_page == FTL_DATA_PAGES))
+        vFtl.victim = FTL_NO_BLOCK;
+    FTL_UNLOCK(irq);
+}
+
+
+void
+ftl_stats(FtlStats_t* st)
+{
+    st->free = FreeBlocks();
+    st->dirty = CountBlocks(BLK_DIRTY);
+    st->erases_min = UINT32_MAX;
+    st->erases_max = 0;
+    for (uint32_t b = 0; b < FTL_BLOCKS; b++)
+    {
+        if (vState[b] == BLK_BAD)
+            continue;
+        st->erases_min = MIN(st->erases_min, vErases[b]);
+        st->erases_max = (vErases[b] > st->erases_max) ? vErases[b] : st->erases_max;
+    }
+    st->relocated = vFtl.relocated;
+    st->programmed = vFtl.programmed;
+}
@@ -0,0 +1,327 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      nor_io.c
+ \brief     Access to the octal NOR
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ An indirect read costs the full command, address and dummy cycles, and
+ the CPU copies the data out of the FIFO. In memory mapped mode the
+ OCTOSPI fetches on demand and a read is a memcpy() from the window at
+ OCTOSPI1_BASE. The NOR is therefore kept mapped, and each program, erase
+ or status poll drops to indirect mode; the next read maps it again.
+
+ nor_erase() only starts the erase, the caller collects the result with
+ nor_busy() or nor_wait(). A 64 KB erase takes hundreds of milliseconds
+ and the NOR does not read while it runs, so reads come first: nor_read()
+ suspends the erase, reads and leaves it suspended while more reads may
+ follow. nor_busy(), polled from the main loop, resumes it once reads
+ have stopped for NOR_QUIET_MS; nor_wait(), program and erase resume it at
+ once. The part needs some time between a resume and the next suspend to
+ make progress, a read within NOR_RESUME_MS of a resume waits that out.
+ A read of the block being erased waits for the erase. An erase failure
+ stays latched until it is collected.
+
+ Mode changes and indirect operations run with NOR_LOCK, so the USB
+ interrupt cannot read the window halfway through. The lock nests.
+****************************************************************************/
+
+#include "nor_io.h"
+#include "main.h"
+#include <errno.h>
+#include <string.h>
+
+
+#ifndef NOR_MAP_READ
+#define NOR_MAP_READ(dst, addr, len)    memcpy((dst), (const uint8_t*)OCTOSPI1_BASE + (addr), (len))
+#endif
+
+
+static struct
+{
+    bool        ready;
+    bool        mapped;
+    bool        erasing;
+    bool        suspended;
+    bool        failed;     // Last erase failed, not yet collected
+    uint32_t    erase_addr;
+    uint32_t    erase_size;
+    uint32_t    resumed;    // Tick of the last resume
+    uint32_t    last_read;  // Tick of the last read that found the erase suspended
+} vNor;
+
+
+static int
+Indirect(void)
+{
+    if (!vNor.mapped)
+        return(0);
+    if (BSP_OSPI_NOR_DisableMemoryMappedMode(0) != BSP_ERROR_NONE)
+        return(-EIO);
+    vNor.mapped = false;
+    return(0);
+}
+
+
+static int
+Mapped(void)
+{
+    if (vNor.mapped)
+        return(0);
+    if (BSP_OSPI_NOR_EnableMemoryMappedMode(0) != BSP_ERROR_NONE)
+        return(-EIO);
+    vNor.mapped = true;
+    return(0);
+}
+
+
+/*! Returns 1 while an erase runs, else 0 or a negative error code when the
+ * NOR cannot be polled.
+ */
+static int
+Poll(void)
+{
+    int32_t status;
+
+    if (!vNor.erasing)
+        return(0);
+    if (vNor.suspended)
+        return(1);
+    if (Indirect() < 0)
+        return(-EIO);
+    status = BSP_OSPI_NOR_GetStatus(0);
+    if ((status == BSP_ERROR_BUSY) || (status == BSP_ERROR_OSPI_SUSPENDED))
+        return(1);
+    vNor.erasing = false;
+    if (status != BSP_ERROR_NONE)
+        vNor.failed = true;
+    return(0);
+}
+
+
+/*! Suspend the running erase for a read. Returns 0 when the NOR can be
+ * read, also when the erase completed meanwhile.
+ */
+static int
+Suspend(void)
+{
+    int32_t status;
+    int err;
+
+    if (vNor.suspended)
+        return(0);
+    // Let the erase progress after the last resume
+    while ((err = Poll(), err == 1) && (HAL_GetTick() - vNor.resumed <= NOR_RESUME_MS));
+    if (err <= 0)
+        return(err);
+
+    if (BSP_OSPI_NOR_SuspendErase(0) == BSP_ERROR_NONE)
+    {
+        vNor.suspended = true;
+        return(0);
+    }
+    // The suspend takes a moment to settle, or the erase just ended
+    while (status = BSP_OSPI_NOR_GetStatus(0), status == BSP_ERROR_BUSY);
+    if (status == BSP_ERROR_OSPI_SUSPENDED)
+    {
+        vNor.suspended = true;
+        return(0);
+    }
+    vNor.erasing = false;
+    if (status != BSP_ERROR_NONE)
+        vNor.failed = true;
+    return(0);
+}
+
+
+static int
+Resume(void)
+{
+    int32_t status;
+
+    if (!vNor.suspended)
+        return(0);
+    if (Indirect() < 0)
+        return(-EIO);
+    vNor.suspended = false;
+    vNor.resumed = HAL_GetTick();
+    if ((BSP_OSPI_NOR_ResumeErase(0) != BSP_ERROR_NONE) &&
+        (status = BSP_OSPI_NOR_GetStatus(0), status != BSP_ERROR_BUSY))
+    {
+        // Not running again, either it just ended or it failed
+        vNor.erasing = false;
+        vNor.failed = (status != BSP_ERROR_NONE);
+    }
+    return(0);
+}
+
+
+static int
+Idle(void)
+{
+    int err;
+
+    if (err = Resume(), err < 0)
+        return(err);
+    while (err = Poll(), err == 1);
+    return(err);
+}
+
+
+/*! Bring up the NOR in octal DTR mode and map it.
+ */
+int
+nor_init(void)
+{
+    BSP_OSPI_NOR_Init_t init = {BSP_OSPI_NOR_OPI_MODE, BSP_OSPI_NOR_DTR_TRANSFER};
+    uint32_t irq;
+    int err = 0;
+
+    if (vNor.ready)
+        return(0);
+    NOR_LOCK(irq);
+    if (BSP_OSPI_NOR_Init(0, &init) != BSP_ERROR_NONE)
+        err = -EIO;
+    else
+    {
+        vNor.mapped = false;
+        vNor.erasing = false;
+        vNor.suspended = false;
+        vNor.failed = false;
+        vNor.ready = true;
+        Mapped();
+    }
+    NOR_UNLOCK(irq);
+    return(err);
+}
+
+
+int
+nor_info(BSP_OSPI_NOR_Info_t* info)
+{
+    return((BSP_OSPI_NOR_GetInfo(0, info) == BSP_ERROR_NONE) ? 0 : -EIO);
+}
+
+
+/*! Read from the memory mapped window, or indirectly when the NOR cannot be
+ * mapped. A running erase is suspended, see above.
+ */
+int
+nor_read(uint32_t addr, void* buf, uint32_t len)
+{
+    uint32_t irq;
+    int err;
+
+    if (!vNor.ready)
+        return(-ENODEV);
+    NOR_LOCK(irq);
+    if (vNor.erasing && (addr < vNor.erase_addr + vNor.erase_size) && (addr + len > vNor.erase_addr))
+        err = Idle();
+    else if (err = Suspend(), vNor.suspended)
+        vNor.last_read = HAL_GetTick();
+    if ((err == 0) && (Mapped() == 0))
+        NOR_MAP_READ(buf, addr, len);
+    else if ((err == 0) && (BSP_OSPI_NOR_Read(0, buf, addr, len) != BSP_ERROR_NONE))
+        err = -EIO;
+    NOR_UNLOCK(irq);
+    return(err);
+}
+
+
+/*! Program 'len' bytes at 'addr', returns when they are written.
+ */
+int
+nor_program(uint32_t addr, const void* buf, uint32_t len)
+{
+    uint32_t irq;
+    int err;
+
+    if (!vNor.ready)
+        return(-ENODEV);
+    NOR_LOCK(irq);
+    if ((err = Idle(), err == 0) && (err = Indirect(), err == 0) &&
+        (BSP_OSPI_NOR_Write(0, (uint8_t*)buf, addr, len) != BSP_ERROR_NONE))
+        err = -EIO;
+    NOR_UNLOCK(irq);
+    return(err);
+}
+
+
+/*! Start erasing the 4 KB or 64 KB block at 'addr', see nor_busy().
+ */
+int
+nor_erase(uint32_t addr, uint32_t size)
+{
+    uint32_t irq;
+    int err;
+
+    if (!vNor.ready)
+        return(-ENODEV);
+    if ((size != 4096) && (size != 65536))
+        return(-EINVAL);
+    NOR_LOCK(irq);
+    if ((err = Idle(), err == 0) && (err = Indirect(), err == 0))
+    {
+        if (BSP_OSPI_NOR_Erase_Block(0, addr, (size == 4096) ? BSP_OSPI_NOR_ERASE_4K : BSP_OSPI_NOR_ERASE_64K) != BSP_ERROR_NONE)
+            err = -EIO;
+        else
+        {
+            vNor.erasing = true;
+            vNor.erase_addr = addr & ~(size - 1);
+            vNor.erase_size = size;
+        }
+    }
+    NOR_UNLOCK(irq);
+    return(err);
+}
+
+
+/*! Returns 1 while the erase runs or is suspended, 0 when it completed or
+ * -EIO when it failed. Resumes a suspended erase when reads have stopped.
+ */
+int
+nor_busy(void)
+{
+    uint32_t irq;
+    int err = 0;
+
+    NOR_LOCK(irq);
+    if (vNor.suspended && (HAL_GetTick() - vNor.last_read >= NOR_QUIET_MS))
+        err = Resume();
+    if ((err == 0) && (err = Poll(), err == 0) && vNor.failed)
+    {
+        vNor.failed = false;
+        err = -EIO;
+    }
+    NOR_UNLOCK(irq);
+    return(err);
+}
+
+
+/*! Wait for the erase, returns 0 or -EIO when it failed. Reads from the
+ * USB interrupt still suspend it meanwhile.
+ */
+int
+nor_wait(void)
+{
+    uint32_t irq;
+    int err;
+
+    do
+    {
+        NOR_LOCK(irq);
+        if ((err = Resume(), err == 0) && (err = Poll(), err == 0) && vNor.failed)
+        {
+            vNor.failed = false;
+            err = -EIO;
+        }
+        NOR_UNLOCK(irq);
+    } while (err == 1);
+    return(err);
+}
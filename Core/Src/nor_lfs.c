@@ -0,0 +1,93 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      nor_lfs.c
+ \brief     LittleFS block device on the octal NOR
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ LittleFS blocks are the 4 KB subsectors of the MX25LM51245G, accessed
+ through nor_io: reads come from the memory mapped window of the OCTOSPI,
+ programs and erases run in indirect mode. An erase is waited for,
+ LittleFS reads the block back right after.
+****************************************************************************/
+
+#include "vfs_conf.h"
+
+// Part of the build with USE_LITTLEFS in vfs_conf.h, or in the host benchmark
+#if defined(USE_LITTLEFS) || defined(HAVE_LITTLEFS)
+
+#include "nor_lfs.h"
+#include "nor_io.h"
+
+
+#define BLOCK_ADDR(c, b)    (NOR_LFS_BASE + (uint32_t)(b) * (c)->block_size)
+
+
+static int
+NorRead(const struct lfs_config* c, lfs_block_t block, lfs_off_t off, void* buffer, lfs_size_t size)
+{
+    return((nor_read(BLOCK_ADDR(c, block) + off, buffer, size) < 0) ? LFS_ERR_IO : LFS_ERR_OK);
+}
+
+
+static int
+NorProg(const struct lfs_config* c, lfs_block_t block, lfs_off_t off, const void* buffer, lfs_size_t size)
+{
+    return((nor_program(BLOCK_ADDR(c, block) + off, buffer, size) < 0) ? LFS_ERR_IO : LFS_ERR_OK);
+}
+
+
+static int
+NorErase(const struct lfs_config* c, lfs_block_t block)
+{
+    if ((nor_erase(BLOCK_ADDR(c, block), c->block_size) < 0) || (nor_wait() < 0))
+        return(LFS_ERR_IO);
+    return(LFS_ERR_OK);
+}
+
+
+static int
+NorSync(const struct lfs_config* c)
+{
+    // Programs have completed when nor_program() returns
+    return(LFS_ERR_OK);
+}
+
+
+/*! Bring up the NOR in octal DTR mode and describe it in 'cfg'. Returns 0
+ * or LFS_ERR_IO.
+ */
+int
+nor_lfs_config(struct lfs_config* cfg)
+{
+    BSP_OSPI_NOR_Info_t info;
+    uint32_t lookahead;
+
+    if ((nor_init() < 0) || (nor_info(&info) < 0))
+        return(LFS_ERR_IO);
+
+    cfg->read = NorRead;
+    cfg->prog = NorProg;
+    cfg->erase = NorErase;
+    cfg->sync = NorSync;
+
+    cfg->read_size = NOR_LFS_READ_SIZE;
+    cfg->prog_size = NOR_LFS_PROG_SIZE;
+    cfg->block_size = info.EraseSubSectorSize;
+    cfg->block_count = (info.FlashSize - NOR_LFS_BASE) / info.EraseSubSectorSize;
+    cfg->cache_size = NOR_LFS_CACHE_SIZE;
+    cfg->block_cycles = NOR_LFS_BLOCK_CYCLES;
+
+    // One bit per block, in multiples of 8 bytes
+    lookahead = (cfg->block_count / 8 + 7) & ~7U;
+    cfg->lookahead_size = (lookahead < NOR_LFS_LOOKAHEAD_MAX) ? lookahead : NOR_LFS_LOOKAHEAD_MAX;
+    return(LFS_ERR_OK);
+}
+
+#endif
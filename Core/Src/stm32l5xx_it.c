@@ -22,6 +22,8 @@
 #include "stm32l5xx_it.h"
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "stm32l562e_discovery_sd.h"
+#include "usbd_storage_if.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -211,6 +213,8 @@ void USB_FS_IRQHandler(void)
   /* USER CODE END USB_FS_IRQn 0 */
   HAL_PCD_IRQHandler(&hpcd_USB_FS);
   /* USER CODE BEGIN USB_FS_IRQn 1 */
+  /* Read completions of the SD card, also pended from its interrupt */
+  STORAGE_Complete_FS();
 
   /* USER CODE END USB_FS_IRQn 1 */
 }
@@ -219,8 +223,8 @@ void USB_FS_IRQHandler(void)
 
 void SDMMC1_IRQHandler(void)
 {
-//	HAL_SD_IRQHandler(&hsd_sdmmc[0]);
-	HAL_SD_IRQHandler(&hsd1);
+	// The BSP handle is the one that runs the DMA transfers, hsd1 only holds the CubeMX settings
+	BSP_SD_IRQHandler(0);
 }
 
 /* USER CODE END 1 */
@@ -15,6 +15,9 @@
 ****************************************************************************/
 
 #include "vfs.h"
+#include "mtp_trace.h"
+#include "disk_cache.h"
+#include "mtp_event.h"
 #include <stdlib.h>
 //#include "defines.h"
 
@@ -48,6 +51,7 @@
 
 static FATFS vFatFs[_VOLUMES] = {0};
 static Diskio_drvTypeDef* pDiskIo[_VOLUMES] = {0};
+static volatile DWORD vDiskWrites[_VOLUMES] = {0};
 
 #endif // USE_FATFS
 
@@ -59,52 +63,10 @@ static Diskio_drvTypeDef* pDiskIo[_VOLUMES] = {0};
 #define LFS_ATTR_MODIFY   0x75
 
 
-int SpiFlashRead(const struct lfs_config* c, lfs_block_t block, lfs_off_t off, void* buffer, lfs_size_t size)
-{
-	sflash_read(block * 4096 + off, buffer, size);
-	return(0);
-}
-
-
-int SpiFlashProg(const struct lfs_config* c, lfs_block_t block, lfs_off_t off, const void* buffer, lfs_size_t size)
-{
-    return(sflash_SectorWrite(block * 4096 + off, buffer, size));
-}
-
-
-int SpiFlashErase(const struct lfs_config* c, lfs_block_t block)
-{
-	return(sflash_SectorErase(block * 4096));
-}
-
-
-int SpiFlashSync(const struct lfs_config* c)
-{
-    //return(-SPIFLASH_ioctl(CTRL_SYNC, nullptr));
-	return(0);
-}
-
-
 static lfs_t vLittleFs[1];
 
-// configuration of the filesystem is provided by this struct
-struct lfs_config vLfsCfg =
-{
-    // block device operations
-    .read  = SpiFlashRead,
-    .prog  = SpiFlashProg,
-    .erase = SpiFlashErase,
-    .sync  = SpiFlashSync,
-
-    // block device configuration
-    .read_size = 16,
-    .prog_size = 256,
-    .block_size = 4096,
-    .block_count = 256,
-    .cache_size = 256,
-    .lookahead_size = 16,
-    .block_cycles = 100000,
-};
+// Block device and geometry are filled in by nor_lfs_config() before vfs_init()
+struct lfs_config vLfsCfg;
 
 #endif // USE_LITTLEFS
 
@@ -116,7 +78,9 @@ FileSystem_t vFileSystem[] =
 {
 #ifdef USE_FATFS
     {"SD:", {{&vFatFs[0], &SD_Driver}}, VfsEvent, FS_FATFS},
-    //{"SPI:", {{&vFatFs[0], &SPIFLASH_Driver}}, VfsEvent, FS_FATFS | FS_FIXED},
+#if USE_SPIFLASH
+    {"SPI:", {{&vFatFs[2], &SPIFLASH_Driver}}, VfsEvent, FS_FATFS | FS_FIXED},
+#endif
 #endif
 #ifdef USE_LITTLEFS
     //{"SPI:", {{&vLittleFs[0], &vLfsCfg, SpiFlashIoctl}}, VfsEvent, FS_LITTLEFS | FS_FIXED},
@@ -143,7 +107,10 @@ DSTATUS disk_initialize(BYTE pdrv)
         }
     }
     if (pDiskIo[pdrv] != nullptr)
+    {
+        disk_cache_attach(pdrv, pDiskIo[pdrv]);
         return(pDiskIo[pdrv]->disk_initialize());
+    }
     else
         return(STA_NOINIT);
 }
@@ -157,8 +124,11 @@ DSTATUS disk_status(BYTE pdrv)
 
 DRESULT disk_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
 {
-    DRESULT res = pDiskIo[pdrv]->disk_read(buff, sector, count);
+    DRESULT res;
 
+    MTP_TRACE_ENTER(TRACE_DISK_READ, (pdrv << 24) | count, sector);
+    res = disk_cache_read(pdrv, buff, sector, count);
+    MTP_TRACE_EXIT(TRACE_DISK_READ, res, sector);
     if(res == RES_OK)
     {
         DISKIO_HOOK_READ();
@@ -174,8 +144,13 @@ DRESULT disk_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
 #if _USE_WRITE == 1
 DRESULT disk_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
 {
-    DRESULT res = pDiskIo[pdrv]->disk_write(buff, sector, count);
+    DRESULT res;
 
+    MTP_TRACE_ENTER(TRACE_DISK_WRITE, (pdrv << 24) | count, sector);
+    res = disk_cache_write(pdrv, buff, sector, count);
+    MTP_TRACE_EXIT(TRACE_DISK_WRITE, res, sector);
+
+    vDiskWrites[pdrv]++;
     if(res == RES_OK)
     {
         DISKIO_HOOK_WRITE();
@@ -186,12 +161,102 @@ DRESULT disk_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
     }
     return(res);
 }
+
+
+// Number of write calls to a drive, lets caches of on-disk structures detect changes
+DWORD disk_writes(BYTE pdrv)
+{
+    return(vDiskWrites[pdrv]);
+}
+#endif
+
+
+// FatFs volume behind entry 'index' of vFileSystem[], or nullptr when it is not a mounted FatFs volume
+FATFS* disk_volume(int index)
+{
+    if ((index < 0) || (index >= sizeof(vFileSystem) / sizeof(vFileSystem[0]) - 1))
+        return(nullptr);
+    if ((vFileSystem[index].index != index + 1) || ((vFileSystem[index].type & ~FS_FIXED) != FS_FATFS))
+        return(nullptr);
+    if (vFileSystem[index].fatfs.fs->fs_type == 0)
+        return(nullptr);
+    return(vFileSystem[index].fatfs.fs);
+}
+
+
+#if _USE_FREEMAP
+// FAT sectors counted into the free cluster map per call of disk_poll()
+#ifndef DISK_FREEMAP_STEP
+#define DISK_FREEMAP_STEP   8
+#endif
+
+#if _FREEMAP_ESTIMATE
+// Volumes of which f_getfree() gave an estimate until now, vFileSystem[] index bits
+static uint32_t vFreeChanged;
+#endif
 #endif
 
 
+// From the main loop: count free clusters of the mounted volumes a few FAT sectors at a time
+void disk_poll(void)
+{
+#if _USE_FREEMAP
+    FATFS* fs;
+    DWORD left;
+    FRESULT res;
+    uint32_t irq;
+    bool known;
+
+#if _FREEMAP_ESTIMATE
+    // GetStorageInfo answered from the partial map, the count is done now
+    for (int i = 0; vFreeChanged != 0; i++)
+    {
+        if (vFreeChanged & (1UL << i))
+        {
+            if (mtp_event_storage_changed(i) == 0)
+                vFreeChanged &= ~(1UL << i);
+            break;
+        }
+    }
+#endif
+    for (int i = 0; i < sizeof(vFileSystem) / sizeof(vFileSystem[0]) - 1; i++)
+    {
+        // Skip volumes without a map or with a complete one, f_freemap() would still check the disk status
+        if ((fs = disk_volume(i), fs == nullptr) || (fs->fmap_scan == 0) || (fs->fmap_scan >= fs->n_fatent))
+            continue;
+        // Without a count from FSINFO f_getfree() estimates until the map is complete
+        known = (fs->free_clust <= fs->n_fatent - 2);
+        // FatFs also runs in the USB interrupt
+        irq = NVIC_GetEnableIRQ(USB_FS_IRQn);
+        NVIC_DisableIRQ(USB_FS_IRQn);
+        res = f_freemap(vFileSystem[i].drive, DISK_FREEMAP_STEP, &left);
+        if (irq)
+            NVIC_EnableIRQ(USB_FS_IRQn);
+#if _FREEMAP_ESTIMATE
+        if ((res == FR_OK) && (left == 0) && !known)
+            vFreeChanged |= 1UL << i;
+#endif
+        break;
+    }
+#endif
+}
+
+
 #if _USE_IOCTL == 1
 DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff)
 {
+    DRESULT res;
+
+    // The sector cache holds writes until a sync and must not serve trimmed or erased sectors
+    if (cmd == CTRL_SYNC)
+    {
+        if (res = disk_cache_sync(pdrv), res != RES_OK)
+            return(res);
+    }
+    else if ((cmd == CTRL_TRIM) || (cmd == SECTOR_ERASE))
+        disk_cache_discard(pdrv, ((DWORD*)buff)[0], ((DWORD*)buff)[1]);
+    else if (cmd == DISK_ERASE)
+        disk_cache_discard(pdrv, 0, 0xFFFFFFFF);
     return(pDiskIo[pdrv]->disk_ioctl(cmd, buff));
 }
 #endif
@@ -318,7 +383,10 @@ VfsEvent(FileSystem_t* filesys, VfsEvent_t event)
         {
             // Erase disk
             // TODO map ioctl through filesys->type
-         //   SPIFLASH_ioctl(DISK_ERASE, 0);
+#if USE_SPIFLASH
+            if (filesys->fatfs.drv == &SPIFLASH_Driver)
+                disk_ioctl(filesys->fatfs.fs->drv, DISK_ERASE, 0);
+#endif
 
             // Format if mount failed
             err = -vfs_format(filesys->drive);
@@ -6,6 +6,12 @@
 / the configuration options.
 /
 /----------------------------------------------------------------------------*/
+/* The R0.12c core in Middlewares/Third_Party/FatFs68300 (exFAT) has its own
+/  configuration file, it defines _FFCONF and the rest of this file is skipped. */
+#if defined(_FATFS) && (_FATFS == 68300)
+#include "ffconf_68300.h"
+#endif
+
 #ifndef _FFCONF
 #define _FFCONF 32020	/* Revision ID */
 
@@ -66,6 +72,43 @@
 #define _USE_FASTSEEK        1      /* 0:Disable or 1:Enable */
 /* To enable fast seek feature, set _USE_FASTSEEK to 1. */
 
+#ifndef _FASTSEEK_POOL
+#define _FASTSEEK_POOL       512    /* Number of words for automatic link maps, 0:None */
+#endif
+#define _FASTSEEK_FILES      8      /* Number of files with an automatic link map at a time */
+#define _FASTSEEK_MIN        262144 /* Least file size for an automatic link map */
+/* With _USE_FASTSEEK, f_lseek() gives a file of at least _FASTSEEK_MIN bytes a link map
+/  of its own when the seek would follow the FAT chain and the application did not set
+/  one. The maps take 2 words plus 2 per fragment from a pool of _FASTSEEK_POOL words,
+/  grow as the file is written beyond them and are given back by f_close(). When the
+/  pool is full, the least recently used map is reclaimed and its file follows the chain
+/  again, so file objects that are never closed do not hold on to their maps. */
+
+#define _USE_EXPAND          1      /* 0:Disable or 1:Enable */
+/* To enable f_expand() function, set _USE_EXPAND to 1 and set _FS_READONLY to 0. */
+
+#define _USE_FREEMAP         1      /* 0:Disable or 1:Enable */
+#define _FREEMAP_SIZE        1024   /* Number of cluster groups in the map */
+/* To keep a count of free clusters per group of clusters in each FATFS object, set
+/  _USE_FREEMAP to 1 and set _FS_READONLY to 0. It costs _FREEMAP_SIZE words per FATFS
+/  object and is built by f_freemap() and f_getfree(). FAT12 volumes do not use it. */
+
+#define _FREEMAP_ESTIMATE    16     /* FAT sectors sampled, 0:Count the whole FAT */
+/* When the free cluster count is not known from FSINFO and the map is not complete,
+/  f_getfree() adds an estimate of the part not yet counted, from _FREEMAP_ESTIMATE FAT
+/  sectors spread over it, instead of reading the rest of the FAT. f_freemap() with
+/  nsect 0 gives the exact count. */
+
+#ifndef _USE_DIRHASH
+#define _USE_DIRHASH         1      /* 0:Disable or 1:Enable */
+#endif
+#define _DIRHASH_SIZE        8192   /* Number of name slots shared by the indexed directories */
+#define _DIRHASH_DIRS        4      /* Number of directories indexed at a time */
+/* To look names up through a hashed index of the directory instead of comparing every
+/  entry, set _USE_DIRHASH to 1. A directory is indexed on its first look up and takes
+/  1.5 slots of 4 bytes per SFN, 3 per object with an LFN and 1 per cluster. Directories
+/  of fewer than 16 objects, or without room in the slots, are searched as before. */
+
 #define _USE_LABEL           1      /* 0:Disable or 1:Enable */
 /* To enable volume label functions, set _USE_LABEL to 1 */
 
@@ -173,7 +216,7 @@
 /  When _MAX_SS is larger than _MIN_SS, FatFs is configured to variable sector size and
 /  GET_SECTOR_SIZE command must be implemented to the disk_ioctl() function. */
 
-#define	_USE_TRIM	0
+#define	_USE_TRIM	1
 /* This option switches ATA-TRIM feature. (0:Disable or 1:Enable)
 /  To enable Trim feature, also CTRL_TRIM command should be implemented to the
 /  disk_ioctl() function. */
@@ -24,7 +24,8 @@
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
-
+#include <string.h>
+#include "mtp_trace.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -44,6 +45,41 @@
 
 #define SD_DEFAULT_BLOCK_SIZE 512
 #define DISABLE_SD_INIT       1
+
+/*
+ * Transfers run by DMA (the SDMMC IDMA) from a small request queue. A caller
+ * either submits a request with a completion callback (SD_Submit) or, as
+ * FatFs does, waits for its own request to complete. Nobody polls the card
+ * while a transfer runs; after a write the card is only asked for its state
+ * when the next request is about to start, so the programming time of the
+ * card overlaps with whatever the caller does next.
+ *
+ * The completion interrupt must preempt the USB interrupt, which is where
+ * most requests are made from: BSP_SD_IT_PRIORITY is set above the USB
+ * priority in stm32l562e_discovery_conf.h.
+ *
+ * The waits are synchronous: SD_read/SD_write, CTRL_SYNC and SD_Flush keep
+ * the calling context, mostly the USB interrupt, until they are done. While
+ * the DMA runs the CPU sleeps in WFI until the completion (or tick)
+ * interrupt. The card gives no interrupt when it has finished programming,
+ * while it programs it is asked for its state with CMD13 once per tick and
+ * the CPU sleeps in between.
+ *
+ * The IDMA needs word aligned buffers. SD_read/SD_write move unaligned
+ * buffers through a scratch sector, SD_Submit refuses them.
+ *
+ * An erase is a request like the others: once the commands are sent the
+ * card is busy erasing the way it programs after a write, and the next
+ * request waits for that before it starts. Its wait is allowed the erase
+ * time on top of its own. SD_Trim() returns as soon as the erase is issued
+ * and only erases whole allocation units, the card can then reuse them
+ * without copying anything around.
+ */
+#define SD_QUEUE_SIZE         4
+#define SD_REQUEST_TIMEOUT    1000  /* ms, a write may keep the card busy for 250 ms */
+#define SD_ERASE_TIMEOUT      250   /* ms per allocation unit */
+#define SD_DEFAULT_AU         8192  /* sectors, 4 MB, when the card does not report it */
+#define ENABLE_SCRATCH_BUFFER
 /* USER CODE END PD */
 
 /* Private macro -------------------------------------------------------------*/
@@ -55,7 +91,16 @@
 /* Disk status */
 static volatile DSTATUS Stat = STA_NOINIT;
 /* USER CODE BEGIN PV */
-
+static SD_Request_t Queue[SD_QUEUE_SIZE];
+static volatile uint8_t QueueHead = 0;
+static volatile uint8_t QueueCount = 0;
+static volatile uint8_t Busy = 0;           /* Head request is on the bus */
+static volatile uint8_t CardProgramming = 0; /* Last transfer was a write, check the card before the next one */
+static volatile uint32_t EraseTime = 0;     /* ms the card may still be erasing for, until it is found ready */
+static DWORD AuSectors = 0;                 /* Allocation unit of the card, 0 until read */
+#if defined(ENABLE_SCRATCH_BUFFER)
+static uint32_t scratch[SD_DEFAULT_BLOCK_SIZE / 4];
+#endif
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
@@ -71,7 +116,13 @@ DRESULT SD_read (BYTE*, DWORD, UINT);
 #endif  /* _USE_IOCTL == 1 */
 
 /* USER CODE BEGIN PFP */
-
+static void SD_Start(void);
+static void SD_Complete(DRESULT res);
+static void SD_SyncDone(void *ctx, DRESULT res);
+static void SD_Sleep(volatile int32_t *status);
+static void SD_Cancel(void *ctx);
+static DRESULT SD_Transfer(BYTE *buff, DWORD sector, UINT count, uint8_t op);
+static DWORD SD_AllocationUnit(void);
 /* USER CODE END PFP */
 
 const Diskio_drvTypeDef  SD_Driver =
@@ -109,6 +160,7 @@ DSTATUS SD_initialize(void)
 {
   /* USER CODE BEGIN SDinitialize */
   Stat = STA_NOINIT;
+  AuSectors = 0;
 #if !defined(DISABLE_SD_INIT)
   if(BSP_SD_Init(0) == BSP_ERROR_NONE)
   {
@@ -143,16 +195,28 @@ DSTATUS SD_status(void)
 DRESULT SD_read(BYTE *buff, DWORD sector, UINT count)
 {
   DRESULT res = RES_ERROR;
-  if(BSP_SD_ReadBlocks(0, (uint32_t*)buff,
-                       (uint32_t) (sector),
-                       count) == BSP_ERROR_NONE)
+#if defined(ENABLE_SCRATCH_BUFFER)
+  if (!((uint32_t)buff & 0x3))
+  {
+#endif
+    res = SD_Transfer(buff, sector, count, SD_READ);
+#if defined(ENABLE_SCRATCH_BUFFER)
+  }
+  else
   {
-    /* wait until the read operation is finished */
-    while(BSP_SD_GetCardState(0)!= BSP_ERROR_NONE)
+    /* Slow path, move every sector through the aligned scratch buffer */
+    for (UINT i = 0; i < count; i++)
     {
+      res = SD_Transfer((BYTE*)scratch, sector++, 1, SD_READ);
+      if (res != RES_OK)
+      {
+        break;
+      }
+      memcpy(buff, scratch, SD_DEFAULT_BLOCK_SIZE);
+      buff += SD_DEFAULT_BLOCK_SIZE;
     }
-    res = RES_OK;
   }
+#endif
   return res;
 }
 
@@ -168,19 +232,29 @@ DRESULT SD_read(BYTE *buff, DWORD sector, UINT count)
 DRESULT SD_write(const BYTE *buff, DWORD sector, UINT count)
 {
   DRESULT res = RES_ERROR;
-  if(BSP_SD_WriteBlocks(0, (uint32_t*)buff,
-                        (uint32_t)(sector),
-                        count) == BSP_ERROR_NONE)
+#if defined(ENABLE_SCRATCH_BUFFER)
+  if (!((uint32_t)buff & 0x3))
+  {
+#endif
+    res = SD_Transfer((BYTE*)buff, sector, count, SD_WRITE);
+#if defined(ENABLE_SCRATCH_BUFFER)
+  }
+  else
   {
-  /* wait until the Write operation is finished */
-    while(BSP_SD_GetCardState(0) != BSP_ERROR_NONE)
+    /* Slow path, move every sector through the aligned scratch buffer */
+    for (UINT i = 0; i < count; i++)
     {
+      memcpy(scratch, buff, SD_DEFAULT_BLOCK_SIZE);
+      buff += SD_DEFAULT_BLOCK_SIZE;
+      res = SD_Transfer((BYTE*)scratch, sector++, 1, SD_WRITE);
+      if (res != RES_OK)
+      {
+        break;
+      }
     }
-    res = RES_OK;
   }
-
+#endif
   return res;
-
 }
 #endif /* _USE_WRITE == 1 */
 
@@ -203,7 +277,7 @@ DRESULT SD_ioctl(BYTE cmd, void *buff)
   {
   /* Make sure that no pending write process */
   case CTRL_SYNC :
-    res = RES_OK;
+    res = SD_Flush(SD_REQUEST_TIMEOUT);
     break;
 
   /* Get number of sectors on the disk (DWORD) */
@@ -220,11 +294,21 @@ DRESULT SD_ioctl(BYTE cmd, void *buff)
     res = RES_OK;
     break;
 
-  /* Get erase block size in unit of sector (DWORD) */
+  /* Get erase block size in unit of sector (DWORD), the allocation unit
+     f_mkfs() aligns the FAT and the data area to */
   case GET_BLOCK_SIZE :
-    BSP_SD_GetCardInfo(0, &CardInfo);
-    *(DWORD*)buff = CardInfo.LogBlockSize / SD_DEFAULT_BLOCK_SIZE;
-	res = RES_OK;
+    *(DWORD*)buff = SD_AllocationUnit();
+    res = RES_OK;
+    break;
+
+  /* Sectors no longer in use (DWORD[2], first and last sector) */
+  case CTRL_TRIM :
+    res = SD_Trim(((DWORD*)buff)[0], ((DWORD*)buff)[1] - ((DWORD*)buff)[0] + 1);
+    break;
+
+  /* Erase sectors (DWORD[2], first and last sector), RES_OK when they read as zeros */
+  case SECTOR_ERASE :
+    res = SD_Erase(((DWORD*)buff)[0], ((DWORD*)buff)[1] - ((DWORD*)buff)[0] + 1);
     break;
 
   default:
@@ -234,3 +318,406 @@ DRESULT SD_ioctl(BYTE cmd, void *buff)
   return res;
 }
 #endif /* _USE_IOCTL == 1 */
+
+/* USER CODE BEGIN lastSection */
+
+/**
+  * @brief  Queues a transfer. 'done' is called, from the SD interrupt or
+  *         from SD_Poll(), when it has completed.
+  * @param  *buff: Word aligned data buffer
+  * @param  sector: Sector address (LBA)
+  * @param  count: Number of sectors
+  * @param  op: SD_READ, SD_WRITE or SD_ERASE (buff is not used)
+  * @param  done: Completion callback, may be NULL
+  * @param  ctx: Argument of the completion callback
+  * @retval DRESULT: RES_OK when queued, RES_NOTRDY when the queue is full
+  */
+DRESULT SD_Submit(BYTE *buff, DWORD sector, UINT count, uint8_t op, SD_DoneCallback_t done, void *ctx)
+{
+  uint32_t primask;
+  SD_Request_t *req;
+
+  if ((uint32_t)buff & 0x3)
+  {
+    return RES_PARERR;
+  }
+  primask = __get_PRIMASK();
+  __disable_irq();
+  if (QueueCount == SD_QUEUE_SIZE)
+  {
+    __set_PRIMASK(primask);
+    return RES_NOTRDY;
+  }
+  req = &Queue[(QueueHead + QueueCount) % SD_QUEUE_SIZE];
+  req->buff = buff;
+  req->sector = sector;
+  req->count = count;
+  req->op = op;
+  req->done = done;
+  req->ctx = ctx;
+  QueueCount++;
+  __set_PRIMASK(primask);
+
+  SD_Poll();
+  return RES_OK;
+}
+
+/**
+  * @brief  Starts the next queued transfer when the bus and the card are free.
+  *         To be called while waiting for requests to complete.
+  * @retval Number of requests in the queue
+  */
+uint32_t SD_Poll(void)
+{
+  if (!Busy && QueueCount && CardProgramming)
+  {
+    /* Only now ask the card whether it finished programming the last write */
+    if (BSP_SD_GetCardState(0) != SD_TRANSFER_OK)
+    {
+      return QueueCount;
+    }
+    CardProgramming = 0;
+    EraseTime = 0;
+  }
+  SD_Start();
+  return QueueCount;
+}
+
+/**
+  * @brief  Waits until all queued transfers have completed and the card has
+  *         finished programming.
+  * @param  timeout: in ms, a pending erase adds its own time
+  * @retval DRESULT: Operation result
+  */
+DRESULT SD_Flush(uint32_t timeout)
+{
+  uint32_t start = HAL_GetTick();
+
+  while (SD_Poll() || (BSP_SD_GetCardState(0) != SD_TRANSFER_OK))
+  {
+    if (HAL_GetTick() - start >= timeout + EraseTime)
+    {
+      return RES_ERROR;
+    }
+    SD_Sleep(NULL);
+  }
+  CardProgramming = 0;
+  EraseTime = 0;
+  return RES_OK;
+}
+
+/**
+  * @brief  Erases the whole allocation units within a range of sectors that
+  *         are no longer in use. The partial units at either end are left
+  *         alone, erasing them would not spare the card any work. Returns
+  *         once the erase is issued, the card erases while the caller goes on.
+  * @param  sector: First sector
+  * @param  count: Number of sectors
+  * @retval DRESULT: Operation result
+  */
+DRESULT SD_Trim(DWORD sector, DWORD count)
+{
+  DWORD au = SD_AllocationUnit();
+  DWORD first = ((sector + au - 1) / au) * au;
+  DWORD end = ((sector + count) / au) * au;
+
+  if (first >= end)
+  {
+    return RES_OK;
+  }
+  return SD_Transfer(NULL, first, end - first, SD_ERASE);
+}
+
+/**
+  * @brief  Erases a range of sectors, partial allocation units included, for
+  *         f_mkfs() to skip writing zeros. Cards return either zeros or ones
+  *         for erased data (DATA_STAT_AFTER_ERASE in the SCR), the first
+  *         sector is read back to tell which.
+  * @param  sector: First sector
+  * @param  count: Number of sectors
+  * @retval DRESULT: RES_OK when the sectors read as zeros, RES_ERROR when
+  *         they read as ones or the erase failed
+  */
+DRESULT SD_Erase(DWORD sector, DWORD count)
+{
+  DRESULT res;
+  UINT i;
+
+  res = SD_Transfer(NULL, sector, count, SD_ERASE);
+  if (res == RES_OK)
+  {
+    res = SD_Flush(SD_REQUEST_TIMEOUT);
+  }
+#if defined(ENABLE_SCRATCH_BUFFER)
+  if (res == RES_OK)
+  {
+    res = SD_Transfer((BYTE*)scratch, sector, 1, SD_READ);
+  }
+  for (i = 0; (res == RES_OK) && (i < SD_DEFAULT_BLOCK_SIZE / 4); i++)
+  {
+    if (scratch[i] != 0)
+    {
+      res = RES_ERROR;
+    }
+  }
+#else
+  res = RES_ERROR;
+#endif
+  return res;
+}
+
+/**
+  * @brief  Allocation unit of the card in sectors, read from the SD status
+  *         while nothing else is on the bus.
+  */
+static DWORD SD_AllocationUnit(void)
+{
+  extern SD_HandleTypeDef hsd_sdmmc[];
+  /* AU_SIZE 0Ah..0Fh: 8, 12, 16, 24, 32 and 64 MB */
+  static const DWORD large[] = {16384, 24576, 32768, 49152, 65536, 131072};
+  HAL_SD_CardStatusTypeDef status;
+  uint32_t primask;
+  uint8_t claimed = 0;
+
+  if (AuSectors != 0)
+  {
+    return AuSectors;
+  }
+  if (SD_Flush(SD_REQUEST_TIMEOUT) == RES_OK)
+  {
+    primask = __get_PRIMASK();
+    __disable_irq();
+    if (!Busy && !QueueCount)
+    {
+      Busy = 1;
+      claimed = 1;
+    }
+    __set_PRIMASK(primask);
+  }
+  if (!claimed)
+  {
+    return SD_DEFAULT_AU;
+  }
+
+  AuSectors = SD_DEFAULT_AU;
+  if (HAL_SD_GetCardStatus(&hsd_sdmmc[0], &status) == HAL_OK)
+  {
+    if ((status.AllocationUnitSize >= 0x1) && (status.AllocationUnitSize <= 0x9))
+    {
+      /* 16 KB .. 4 MB */
+      AuSectors = 32UL << (status.AllocationUnitSize - 1);
+    }
+    else if (status.AllocationUnitSize >= 0xA)
+    {
+      AuSectors = large[status.AllocationUnitSize - 0xA];
+    }
+  }
+  Busy = 0;
+  SD_Start();
+  return AuSectors;
+}
+
+/**
+  * @brief  Runs one transfer through the queue and waits for it.
+  */
+static DRESULT SD_Transfer(BYTE *buff, DWORD sector, UINT count, uint8_t op)
+{
+  volatile int32_t status = -1;
+  uint32_t start = HAL_GetTick();
+
+  while (SD_Submit(buff, sector, count, op, SD_SyncDone, (void*)&status) == RES_NOTRDY)
+  {
+    if (HAL_GetTick() - start >= SD_REQUEST_TIMEOUT)
+    {
+      return RES_ERROR;
+    }
+    SD_Sleep(NULL);
+  }
+  while (status < 0)
+  {
+    SD_Poll();
+    SD_Sleep(&status);
+    if ((status < 0) && (HAL_GetTick() - start >= SD_REQUEST_TIMEOUT + EraseTime))
+    {
+      SD_Cancel((void*)&status);
+      return RES_ERROR;
+    }
+  }
+  return (DRESULT)status;
+}
+
+static void SD_SyncDone(void *ctx, DRESULT res)
+{
+  *(volatile int32_t*)ctx = res;
+}
+
+/**
+  * @brief  Sleeps while a transfer is on the bus and the request has not
+  *         completed. WFI also returns with the interrupts masked, masking
+  *         them first closes the window in which the completion could slip
+  *         in between the check and the WFI. While the card is busy
+  *         programming or erasing, which it signals with no interrupt, it
+  *         sleeps until the next tick instead, so it is asked for its state
+  *         once per ms rather than in a loop.
+  * @param  status: Status of the request waited for, NULL for all of them
+  */
+static void SD_Sleep(volatile int32_t *status)
+{
+  uint32_t primask = __get_PRIMASK();
+  uint32_t tick;
+
+  __disable_irq();
+  if ((status != NULL) && (*status >= 0))
+  {
+    __set_PRIMASK(primask);
+    return;
+  }
+  if (Busy)
+  {
+    __WFI();
+    __set_PRIMASK(primask);
+    return;
+  }
+  __set_PRIMASK(primask);
+
+  tick = HAL_GetTick();
+  while (HAL_GetTick() == tick)
+  {
+    __WFI();
+  }
+}
+
+/**
+  * @brief  Removes the requests of a caller that gave up waiting from the
+  *         queue, aborting the transfer if it is on the bus. Nothing may
+  *         touch the caller's buffer after it returned.
+  */
+static void SD_Cancel(void *ctx)
+{
+  extern SD_HandleTypeDef hsd_sdmmc[];
+  uint32_t primask = __get_PRIMASK();
+  uint8_t keep = 0;
+
+  __disable_irq();
+  for (uint8_t i = 0; i < QueueCount; i++)
+  {
+    SD_Request_t *req = &Queue[(QueueHead + i) % SD_QUEUE_SIZE];
+
+    /* The head request on the bus is retired by the abort below */
+    if ((req->ctx == ctx) && !(Busy && (i == 0)))
+    {
+      continue;
+    }
+    if (keep != i)
+    {
+      Queue[(QueueHead + keep) % SD_QUEUE_SIZE] = *req;
+    }
+    keep++;
+  }
+  QueueCount = keep;
+  if (Busy && (Queue[QueueHead].ctx == ctx))
+  {
+    Queue[QueueHead].done = NULL;
+    HAL_SD_Abort(&hsd_sdmmc[0]);
+    SD_Complete(RES_ERROR);
+  }
+  __set_PRIMASK(primask);
+}
+
+/**
+  * @brief  Puts the request at the head of the queue on the bus.
+  */
+static void SD_Start(void)
+{
+  uint32_t primask = __get_PRIMASK();
+  SD_Request_t *req;
+  int32_t ret;
+
+  __disable_irq();
+  if (Busy || !QueueCount || CardProgramming)
+  {
+    __set_PRIMASK(primask);
+    return;
+  }
+  Busy = 1;
+  __set_PRIMASK(primask);
+
+  req = &Queue[QueueHead];
+  if (req->op == SD_ERASE)
+  {
+    /* Only the commands, the card is busy erasing afterwards.
+       BSP_SD_Erase() passes BlockIdx + BlocksNbr as the inclusive end block */
+    CardProgramming = 1;
+    EraseTime += SD_ERASE_TIMEOUT * (req->count / ((AuSectors != 0) ? AuSectors : SD_DEFAULT_AU) + 1);
+    ret = BSP_SD_Erase(0, req->sector, req->count - 1);
+    SD_Complete((ret == BSP_ERROR_NONE) ? RES_OK : RES_ERROR);
+    return;
+  }
+  if (req->op == SD_WRITE)
+  {
+    CardProgramming = 1;
+    ret = BSP_SD_WriteBlocks_DMA(0, (uint32_t*)req->buff, req->sector, req->count);
+  }
+  else
+  {
+    ret = BSP_SD_ReadBlocks_DMA(0, (uint32_t*)req->buff, req->sector, req->count);
+  }
+  if (ret != BSP_ERROR_NONE)
+  {
+    SD_Complete(RES_ERROR);
+  }
+}
+
+/**
+  * @brief  Retires the head request and starts the next one. After a write the
+  *         next one waits for SD_Poll(), the card is busy programming.
+  */
+static void SD_Complete(DRESULT res)
+{
+  SD_Request_t req = Queue[QueueHead];
+
+  MTP_TRACE_MARK(TRACE_SD_DONE, res, req.sector);
+  QueueHead = (QueueHead + 1) % SD_QUEUE_SIZE;
+  QueueCount--;
+  Busy = 0;
+  if (req.done != NULL)
+  {
+    req.done(req.ctx, res);
+  }
+  SD_Start();
+}
+
+/**
+  * @brief Tx Transfer completed callback
+  * @param Instance     SD Instance
+  * @retval None
+  */
+void BSP_SD_WriteCpltCallback(uint32_t Instance)
+{
+  SD_Complete(RES_OK);
+}
+
+/**
+  * @brief Rx Transfer completed callback
+  * @param Instance     SD Instance
+  * @retval None
+  */
+void BSP_SD_ReadCpltCallback(uint32_t Instance)
+{
+  SD_Complete(RES_OK);
+}
+
+/**
+  * @brief SD error callback
+  * @param hsd  SD handle
+  * @retval None
+  */
+void HAL_SD_ErrorCallback(SD_HandleTypeDef *hsd)
+{
+  if (Busy)
+  {
+    SD_Complete(RES_ERROR);
+  }
+}
+
+/* USER CODE END lastSection */
@@ -39,12 +39,26 @@
 
 /* Exported types ------------------------------------------------------------*/
 /* USER CODE BEGIN ET */
-
+typedef void (*SD_DoneCallback_t)(void *ctx, DRESULT res);
+
+typedef struct
+{
+  BYTE *buff;
+  DWORD sector;
+  UINT count;
+  uint8_t op;
+  SD_DoneCallback_t done;
+  void *ctx;
+} SD_Request_t;
 /* USER CODE END ET */
 
 /* Exported constants --------------------------------------------------------*/
 extern const Diskio_drvTypeDef  SD_Driver;
 /* USER CODE BEGIN EC */
+/* Request operations */
+#define SD_READ               0
+#define SD_WRITE              1
+#define SD_ERASE              2
 
 /* USER CODE END EC */
 
@@ -55,7 +69,13 @@ extern const Diskio_drvTypeDef  SD_Driver;
 
 /* Exported functions prototypes ---------------------------------------------*/
 /* USER CODE BEGIN EFP */
-
+DRESULT SD_read(BYTE *buff, DWORD sector, UINT count);
+DRESULT SD_write(const BYTE *buff, DWORD sector, UINT count);
+DRESULT SD_Submit(BYTE *buff, DWORD sector, UINT count, uint8_t op, SD_DoneCallback_t done, void *ctx);
+uint32_t SD_Poll(void);
+DRESULT SD_Flush(uint32_t timeout);
+DRESULT SD_Trim(DWORD sector, DWORD count);
+DRESULT SD_Erase(DWORD sector, DWORD count);
 /* USER CODE END EFP */
 
 /* Private defines -----------------------------------------------------------*/
@@ -0,0 +1,147 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      spiflash_diskio.c
+ \brief     FatFs disk driver for the octal NOR flash
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ The sectors come from nor_ftl.c, which is shared with the USB mass storage
+ LUN. FatFs runs from the main loop, every call keeps the USB interrupt out
+ of the FTL while it works.
+****************************************************************************/
+
+#include "spiflash_diskio.h"
+#include "vfs_conf.h"
+#include <errno.h>
+
+
+static volatile DSTATUS vStat = STA_NOINIT;
+
+
+const Diskio_drvTypeDef SPIFLASH_Driver =
+{
+    SPIFLASH_initialize,
+    SPIFLASH_status,
+    SPIFLASH_read,
+#if _USE_WRITE == 1
+    SPIFLASH_write,
+#endif
+#if _USE_IOCTL == 1
+    SPIFLASH_ioctl,
+#endif
+};
+
+
+static DRESULT
+Result(int err)
+{
+    switch (err)
+    {
+    case 0:         return(RES_OK);
+    case -EINVAL:   return(RES_PARERR);
+    case -ENODEV:   return(RES_NOTRDY);
+    default:        return(RES_ERROR);
+    }
+}
+
+
+DSTATUS
+SPIFLASH_initialize(void)
+{
+    uint32_t irq;
+    int err;
+
+    FTL_LOCK(irq);
+    err = ftl_init();
+    FTL_UNLOCK(irq);
+    vStat = (err == 0) ? 0 : STA_NOINIT | STA_NODISK;
+    return(vStat);
+}
+
+
+DSTATUS
+SPIFLASH_status(void)
+{
+    return(vStat);
+}
+
+
+DRESULT
+SPIFLASH_read(BYTE* buff, DWORD sector, UINT count)
+{
+    uint32_t irq;
+    int err;
+
+    if (vStat & STA_NOINIT)
+        return(RES_NOTRDY);
+    FTL_LOCK(irq);
+    err = ftl_read(buff, sector, count);
+    FTL_UNLOCK(irq);
+    return(Result(err));
+}
+
+
+#if _USE_WRITE == 1
+DRESULT
+SPIFLASH_write(const BYTE* buff, DWORD sector, UINT count)
+{
+    uint32_t irq;
+    int err;
+
+    if (vStat & STA_NOINIT)
+        return(RES_NOTRDY);
+    FTL_LOCK(irq);
+    err = ftl_write(buff, sector, count);
+    FTL_UNLOCK(irq);
+    return(Result(err));
+}
+#endif
+
+
+#if _USE_IOCTL == 1
+DRESULT
+SPIFLASH_ioctl(BYTE cmd, void* buff)
+{
+    uint32_t irq;
+    int err;
+
+    if (vStat & STA_NOINIT)
+        return(RES_NOTRDY);
+
+    switch (cmd)
+    {
+    case CTRL_SYNC:
+        FTL_LOCK(irq);
+        err = ftl_sync();
+        FTL_UNLOCK(irq);
+        return(Result(err));
+    case GET_SECTOR_COUNT:
+        *(DWORD*)buff = ftl_sectors();
+        return(RES_OK);
+    case GET_SECTOR_SIZE:
+        *(WORD*)buff = FTL_SECTOR_SIZE;
+        return(RES_OK);
+    case GET_BLOCK_SIZE:
+        *(DWORD*)buff = FTL_PAGE_SECTORS;  // Clusters on page boundaries
+        return(RES_OK);
+    case CTRL_TRIM:
+        FTL_LOCK(irq);
+        err = ftl_trim(((DWORD*)buff)[0], ((DWORD*)buff)[1] - ((DWORD*)buff)[0] + 1);
+        FTL_UNLOCK(irq);
+        return(Result(err));
+    case DISK_ERASE:    // Empties the drive, for a fresh format after a failed mount
+        FTL_LOCK(irq);
+        err = ftl_format();
+        FTL_UNLOCK(irq);
+        return(Result(err));
+    default:
+        return(RES_PARERR);
+    }
+}
+#endif
@@ -0,0 +1,42 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      spiflash_diskio.h
+ \brief     FatFs disk driver for the octal NOR flash
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ "SPI:" drive on the MX25LM51245G through the flash translation layer.
+****************************************************************************/
+
+#ifndef _SPIFLASH_DISKIO_H
+#define _SPIFLASH_DISKIO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ff_gen_drv.h"
+#include "nor_ftl.h"
+
+
+extern const Diskio_drvTypeDef SPIFLASH_Driver;
+
+
+DSTATUS SPIFLASH_initialize(void);
+DSTATUS SPIFLASH_status(void);
+DRESULT SPIFLASH_read(BYTE* buff, DWORD sector, UINT count);
+DRESULT SPIFLASH_write(const BYTE* buff, DWORD sector, UINT count);
+DRESULT SPIFLASH_ioctl(BYTE cmd, void* buff);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*_SPIFLASH_DISKIO_H */
@@ -0,0 +1,659 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      bench.c
+ \brief     Throughput benchmark of the MTP stack on the host
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ Runs SendObject, GetObjectHandles, GetObjectPropList and GetObject
+ workloads on a FAT volume in a disk image over the simulated bus. With the
+ MTP class in the build (HAVE_MTP_CLASS) the scripted initiator drives the
+ real responder on a volume made by 'make image'. Without it the bench
+ formats the image itself and the same workloads run the in-tree MTP
+ layers (transfer ring, handle index, property lists, object access)
+ through the simulated bulk endpoints directly.
+
+ Per workload it reports transactions/s, payload MB/s, disk calls per MB of
+ payload and bytes copied per payload byte, the latter counting every byte
+ that crosses the USB packet memory or the disk interface.
+
+ With -t the trace ring is read out at the end, as MTP_OC_WB_GetTrace
+ does, and written to a file for trace_decode.
+
+ With -l the in-tree layers also send one object of that many MB, check its
+ 64-bit ObjectSize in GetObjectPropList and read a GetPartialObject64 range
+ across the 4 GB mark back. 'make exfat' runs that with the R0.12c core on
+ an exFAT volume.
+
+ Usage: bench [-i image] [-m volume MB] [-s file KB] [-n files] [-r repeats] [-t trace] [-l large MB]
+****************************************************************************/
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "usbd_core.h"
+#include "usbd_desc.h"
+#include "sim_disk.h"
+#include "sim_pcd.h"
+#include "mtp_initiator.h"
+#include "mtp_trace.h"
+#ifdef HAVE_MTP_CLASS
+#include "usb_device.h"
+#include "vfs.h"
+#else
+#include "sim_diskio.h"
+#include "mtp_index.h"
+#include "mtp_object.h"
+#include "mtp_proplist.h"
+#endif
+
+
+#define MB          (1024.0 * 1024.0)
+
+#ifndef HAVE_MTP_CLASS
+#define BENCH_EP_IN     0x81
+#define BENCH_EP_OUT    0x01
+#define BENCH_MPS       64
+#endif
+
+
+typedef struct
+{
+    const char*     name;
+    struct timespec start;
+    uint32_t        transactions;
+    uint64_t        payload;
+} Run_t;
+
+
+static struct
+{
+    const char* image;
+    uint32_t    volume;     // MB
+    uint32_t    size;       // KB per file
+    uint32_t    files;
+    uint32_t    repeats;
+    const char* trace;
+    uint32_t    large;      // MB, 0 for none
+} vOpt = {"bench.img", 64, 1024, 16, 16, NULL, 0};
+
+static uint8_t* pData;
+static uint8_t* pSink;
+
+
+static void
+Begin(Run_t* run, const char* name)
+{
+    run->name = name;
+    run->transactions = 0;
+    run->payload = 0;
+    sim_disk_reset_stats();
+    sim_pcd_reset_stats();
+    clock_gettime(CLOCK_MONOTONIC, &run->start);
+}
+
+
+static void
+End(Run_t* run)
+{
+    struct timespec now;
+    double s, mb = run->payload / MB;
+    uint64_t copied = vSimPcdStats.in_bytes + vSimPcdStats.out_bytes + vSimDiskStats.read_bytes + vSimDiskStats.write_bytes;
+    uint32_t calls = vSimDiskStats.read_calls + vSimDiskStats.write_calls;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    s = (now.tv_sec - run->start.tv_sec) + (now.tv_nsec - run->start.tv_nsec) / 1e9;
+    if (s <= 0)
+        s = 1e-9;
+
+    printf("%-18s %6u tr %10.1f tr/s %9.2f MB/s", run->name, run->transactions, run->transactions / s, mb / s);
+    if (run->payload > 0)
+        printf(" %9.1f disk calls/MB %6.3f copied/B\n", calls / mb, (double)copied / run->payload);
+    else
+        printf(" %9u disk calls\n", calls);
+}
+
+
+static int
+WriteTrace(const uint8_t* dump, uint32_t len)
+{
+    FILE* f = fopen(vOpt.trace, "wb");
+
+    if ((f == NULL) || (fwrite(dump, 1, len, f) != len))
+    {
+        perror(vOpt.trace);
+        if (f != NULL)
+            fclose(f);
+        return(-1);
+    }
+    fclose(f);
+    return(0);
+}
+
+
+// Test pattern of object 'seed' from byte 'offset' on
+static void
+Fill(uint8_t* p, uint32_t len, uint64_t offset, uint32_t seed)
+{
+    for (uint32_t i = 0; i < len; i++, offset++)
+        p[i] = (uint8_t)((offset * 31) ^ (offset >> 9) ^ seed);
+}
+
+
+#ifdef HAVE_MTP_CLASS
+
+static int
+Bench(void)
+{
+    MtpInitiator_t mi;
+    uint32_t size = vOpt.size * 1024, len, storage, *handles, count;
+    uint32_t params[3];
+    uint8_t info[512];
+    Run_t run;
+    int rc;
+
+    vfs_init();
+    MX_USB_Device_Init();
+    if (mtp_initiator_connect(&mi) < 0)
+    {
+        fprintf(stderr, "enumeration failed\n");
+        return(-1);
+    }
+
+    params[0] = 1;
+    if ((rc = mtp_initiator_transact(&mi, PTP_OC_OpenSession, params, 1, NULL, 0, NULL, 0, NULL)) != PTP_RC_OK)
+        goto error;
+    if ((rc = mtp_initiator_transact(&mi, PTP_OC_GetStorageIDs, NULL, 0, NULL, 0, pSink, size, &len)) != PTP_RC_OK)
+        goto error;
+    if ((len < 8) || (*(uint32_t*)pSink == 0))
+    {
+        fprintf(stderr, "no storage\n");
+        return(-1);
+    }
+    storage = ((uint32_t*)pSink)[1];
+
+    Begin(&run, "SendObject");
+    for (uint32_t i = 0; i < vOpt.files; i++)
+    {
+        char name[16];
+
+        snprintf(name, sizeof(name), "F%04u.BIN", i);
+        Fill(pData, size, 0, i);
+        params[0] = storage;
+        params[1] = 0xFFFFFFFF;
+        len = mtp_initiator_object_info(info, storage, name, size);
+        if ((rc = mtp_initiator_transact(&mi, PTP_OC_SendObjectInfo, params, 2, info, len, NULL, 0, NULL)) != PTP_RC_OK)
+            goto error;
+        if ((rc = mtp_initiator_transact(&mi, PTP_OC_SendObject, NULL, 0, pData, size, NULL, 0, NULL)) != PTP_RC_OK)
+            goto error;
+        run.transactions += 2;
+        run.payload += len + size;
+    }
+    End(&run);
+
+    Begin(&run, "GetObjectHandles");
+    for (uint32_t r = 0; r < vOpt.repeats; r++)
+    {
+        params[0] = storage;
+        params[1] = 0;
+        params[2] = 0xFFFFFFFF;
+        if ((rc = mtp_initiator_transact(&mi, PTP_OC_GetObjectHandles, params, 3, NULL, 0, pSink, size, &len)) != PTP_RC_OK)
+            goto error;
+        run.transactions++;
+        run.payload += len;
+    }
+    End(&run);
+
+    count = *(uint32_t*)pSink;
+    if ((handles = malloc(count * sizeof(uint32_t))) == NULL)
+        return(-1);
+    memcpy(handles, pSink + 4, count * sizeof(uint32_t));
+
+    Begin(&run, "GetObject");
+    for (uint32_t i = 0; i < count; i++)
+    {
+        params[0] = handles[i];
+        if ((rc = mtp_initiator_transact(&mi, PTP_OC_GetObject, params, 1, NULL, 0, pSink, size, &len)) != PTP_RC_OK)
+            break;
+        run.transactions++;
+        run.payload += len;
+    }
+    End(&run);
+    free(handles);
+    if (rc != PTP_RC_OK)
+        goto error;
+
+    if (vOpt.trace != NULL)
+    {
+        uint32_t max = sizeof(MtpTraceHeader_t) + MTP_TRACE_SIZE * sizeof(MtpTraceEvent_t);
+        uint8_t* dump = malloc(max);
+
+        params[0] = 1;
+        if ((dump == NULL) || ((rc = mtp_initiator_transact(&mi, MTP_OC_WB_GetTrace, params, 1, NULL, 0, dump, max, &len)) != PTP_RC_OK) ||
+            (WriteTrace(dump, len) < 0))
+        {
+            free(dump);
+            goto error;
+        }
+        free(dump);
+    }
+
+    mtp_initiator_transact(&mi, PTP_OC_CloseSession, NULL, 0, NULL, 0, NULL, 0, NULL);
+    return(0);
+
+error:
+    fprintf(stderr, "transaction %u failed: 0x%04X\n", mi.transaction, rc);
+    return(-1);
+}
+
+#else
+
+#define MTP_OC_GetObjectPropList        0x9805
+#define MTP_OPC_ObjectSize              0xDC04
+#define BENCH_LARGE_RANGE               65536
+
+USBD_HandleTypeDef hUsbDeviceFS;
+
+static uint8_t vScratch[MTP_MEDIA_PACKET];
+static uint8_t vChunk[MTP_MEDIA_PACKET];
+static uint32_t vTransaction;
+
+
+/*! Hand what the ring holds to the bulk IN endpoint, as the class DataIn
+ * stage does, and collect it on the host side into 'dst'. What does not
+ * fit in 'max' bytes is dropped.
+ */
+static uint32_t
+PumpIn(MtpRing_t* ring, uint8_t* dst, uint32_t max)
+{
+    uint32_t len, total = 0;
+    uint8_t* p;
+
+    while (p = mtp_ring_tx(ring, MTP_MEDIA_PACKET, &len), p != NULL)
+    {
+        USBD_LL_Transmit(&hUsbDeviceFS, BENCH_EP_IN, p, len);
+        if (sim_pcd_in(BENCH_EP_IN, (total + len <= max) ? dst + total : vScratch, len) != (int32_t)len)
+            return(0);
+        mtp_ring_consume(ring, len);
+        total += len;
+    }
+    return(total);
+}
+
+
+// Trace a workload step as the opcode dispatcher of the class would
+static void
+OpBegin(uint16_t code)
+{
+    MTP_TRACE_ENTER(TRACE_PTP_OPCODE, code, ++vTransaction);
+}
+
+
+static void
+OpEnd(int err)
+{
+    MTP_TRACE_EXIT(TRACE_PTP_OPCODE, (err < 0) ? 0x2002 : PTP_RC_OK, vTransaction);
+}
+
+
+static int
+DumpTrace(void)
+{
+    MtpTraceDump_t dump;
+    uint32_t len = mtp_trace_begin(&dump, true), got = 0;
+    uint8_t* buf = malloc(len);
+    int err;
+
+    mtp_ring_reset(&vMtpRing);
+    while ((buf != NULL) && !mtp_trace_done(&dump))
+    {
+        mtp_trace_fill(&dump, &vMtpRing);
+        got += PumpIn(&vMtpRing, buf + got, len - got);
+    }
+    if (buf != NULL)
+        got += PumpIn(&vMtpRing, buf + got, len - got);
+    mtp_trace_end(&dump);
+    err = ((buf != NULL) && (got == len)) ? WriteTrace(buf, len) : -1;
+    free(buf);
+    return(err);
+}
+
+
+/*! SendObject data phase of 'size' bytes of the test pattern of object
+ * 'seed', generated a ring area at a time.
+ */
+static int
+Upload(const char* path, uint64_t size, uint32_t seed)
+{
+    MtpRing_t* ring = &vMtpRing;
+    MtpUpload_t up;
+    uint64_t sent = 0;
+    int err;
+
+    mtp_ring_reset(ring);
+    if (err = mtp_upload_open(&up, path, size), err < 0)
+        return(err);
+    while (sent < size)
+    {
+        uint32_t len, n;
+        uint8_t* p = mtp_ring_rx(ring, BENCH_MPS, &len);
+
+        if (p == NULL)
+        {
+            mtp_upload_close(&up);
+            return(-1);
+        }
+        n = (size - sent < len) ? size - sent : len;
+        Fill(vChunk, n, sent, seed);
+        USBD_LL_PrepareReceive(&hUsbDeviceFS, BENCH_EP_OUT, p, len);
+        n = sim_pcd_out(BENCH_EP_OUT, vChunk, n);
+        if (sim_pcd_armed(BENCH_EP_OUT))
+            sim_pcd_out(BENCH_EP_OUT, NULL, 0);     // End of data on a packet boundary
+        mtp_ring_commit(ring, USBD_LL_GetRxDataSize(&hUsbDeviceFS, BENCH_EP_OUT));
+        sent += n;
+        if (err = mtp_upload_drain(&up, ring, false), err < 0)
+            break;
+    }
+    if ((err >= 0) && (err = mtp_upload_drain(&up, ring, true), err >= 0))
+        err = 0;
+    if (mtp_upload_close(&up) < 0)
+        err = -1;
+    return(err);
+}
+
+
+static uint64_t
+GetLe(const uint8_t* p, int bytes)
+{
+    uint64_t v = 0;
+
+    while (bytes-- > 0)
+        v = (v << 8) | p[bytes];
+    return(v);
+}
+
+
+/*! The -l workload: SendObject of one large object after the others, its
+ * ObjectSize from GetObjectPropList and a GetPartialObject64 range across
+ * the 4 GB mark, or in the middle of a smaller object, read back.
+ */
+static int
+Large(void)
+{
+    uint64_t size = (uint64_t)vOpt.large << 20, offset;
+    uint32_t handle = MTP_HANDLE(0, 0, vOpt.files + 1), max = vOpt.size * 1024 + 65536, len;
+    MtpPropList_t* pl = &vMtpPropList;
+    MtpPartial_t obj;
+    uint8_t* ref;
+    Run_t run;
+    int err;
+
+    Begin(&run, "SendObject large");
+    OpBegin(PTP_OC_SendObject);
+    err = Upload("SD:/LARGE.BIN", size, vOpt.files);
+    OpEnd(err);
+    if (err < 0)
+    {
+        fprintf(stderr, "upload of %llu bytes failed: %d\n", (unsigned long long)size, err);
+        return(-1);
+    }
+    run.transactions++;
+    run.payload += size;
+    End(&run);
+
+    // ObjectSize of all items, the large object is the last one
+    mtp_ring_reset(&vMtpRing);
+    OpBegin(MTP_OC_GetObjectPropList);
+    if (mtp_proplist_begin(pl, 0, 0, MTP_OPC_ObjectSize, 1) < 0)
+        return(-1);
+    len = 0;
+    while (!mtp_proplist_done(pl))
+    {
+        if (mtp_proplist_fill(pl, &vMtpRing) < 0)
+            break;
+        len += PumpIn(&vMtpRing, pSink + len, max - len);
+    }
+    len += PumpIn(&vMtpRing, pSink + len, max - len);
+    mtp_proplist_end(pl);
+    OpEnd(0);
+    if ((len != 4 + (vOpt.files + 1) * 16) || (GetLe(pSink + len - 16, 4) != handle) ||
+        (GetLe(pSink + len - 8, 8) != size))
+    {
+        fprintf(stderr, "ObjectSize of the large object is wrong\n");
+        return(-1);
+    }
+
+    offset = (size > (1ULL << 32) + BENCH_LARGE_RANGE) ? (1ULL << 32) - BENCH_LARGE_RANGE / 2 : size / 2;
+    mtp_ring_reset(&vMtpRing);
+    OpBegin(PTP_OC_ANDROID_GetPartialObject64);
+    if (mtp_partial_open_handle(&obj, handle, offset, BENCH_LARGE_RANGE) < 0)
+    {
+        fprintf(stderr, "large object not indexed\n");
+        return(-1);
+    }
+    len = 0;
+    while (obj.remaining > 0)
+    {
+        if (mtp_partial_fill(&obj, &vMtpRing) < 0)
+            break;
+        len += PumpIn(&vMtpRing, pSink + len, max - len);
+    }
+    len += PumpIn(&vMtpRing, pSink + len, max - len);
+    mtp_partial_close(&obj);
+    OpEnd(0);
+    if ((ref = malloc(BENCH_LARGE_RANGE)) == NULL)
+        return(-1);
+    Fill(ref, BENCH_LARGE_RANGE, offset, vOpt.files);
+    err = ((len != obj.length) || (memcmp(pSink, ref, len) != 0)) ? -1 : 0;
+    free(ref);
+    if (err < 0)
+    {
+        fprintf(stderr, "range at %llu read back wrong\n", (unsigned long long)offset);
+        return(-1);
+    }
+    printf("%-18s %llu bytes, ObjectSize and %u bytes at %llu read back\n", "", (unsigned long long)size,
+           len, (unsigned long long)offset);
+    return(0);
+}
+
+
+static int
+Bench(void)
+{
+    USBD_SetupReqTypedef req = {0x80, USB_REQ_GET_DESCRIPTOR, USB_DESC_TYPE_DEVICE << 8, 0, USB_LEN_DEV_DESC};
+    uint32_t size = vOpt.size * 1024, len;
+    MtpPartial_t obj;
+    int err;
+    Run_t run;
+    FRESULT res;
+
+    USBD_Init(&hUsbDeviceFS, &MSC_Desc, DEVICE_FS);
+    USBD_Start(&hUsbDeviceFS);
+    sim_pcd_attach();
+    if (sim_pcd_control(&req, pSink) != USB_LEN_DEV_DESC)
+    {
+        fprintf(stderr, "enumeration failed\n");
+        return(-1);
+    }
+    USBD_LL_OpenEP(&hUsbDeviceFS, BENCH_EP_IN, USBD_EP_TYPE_BULK, BENCH_MPS);
+    USBD_LL_OpenEP(&hUsbDeviceFS, BENCH_EP_OUT, USBD_EP_TYPE_BULK, BENCH_MPS);
+
+    if (res = sim_diskio_mount(true), res != FR_OK)
+    {
+        fprintf(stderr, "mount failed: %d\n", res);
+        return(-1);
+    }
+    mtp_index_clear(-1);
+
+    Begin(&run, "SendObject");
+    for (uint32_t i = 0; i < vOpt.files; i++)
+    {
+        char path[24];
+
+        snprintf(path, sizeof(path), "SD:/F%04u.BIN", i);
+        OpBegin(PTP_OC_SendObject);
+        err = Upload(path, size, i);
+        OpEnd(err);
+        if (err < 0)
+        {
+            fprintf(stderr, "upload of %s failed\n", path);
+            return(-1);
+        }
+        run.transactions++;
+        run.payload += size;
+    }
+    End(&run);
+
+    Begin(&run, "GetObjectHandles");
+    for (uint32_t r = 0; r < vOpt.repeats; r++)
+    {
+        MtpHandles_t hs;
+
+        mtp_ring_reset(&vMtpRing);
+        OpBegin(PTP_OC_GetObjectHandles);
+        if (mtp_handles_begin(&hs, 0, 0) < 0)
+            return(-1);
+        while (!mtp_handles_done(&hs))
+        {
+            if (mtp_handles_fill(&hs, &vMtpRing) < 0)
+                break;
+            run.payload += PumpIn(&vMtpRing, pSink, size);
+        }
+        mtp_handles_end(&hs);
+        OpEnd(0);
+        run.transactions++;
+    }
+    End(&run);
+
+    Begin(&run, "GetObjectPropList");
+    for (uint32_t r = 0; r < vOpt.repeats; r++)
+    {
+        MtpPropList_t* pl = &vMtpPropList;
+
+        mtp_ring_reset(&vMtpRing);
+        OpBegin(MTP_OC_GetObjectPropList);
+        if (mtp_proplist_begin(pl, 0, 0, MTP_PROPLIST_ALL, 1) < 0)
+            return(-1);
+        while (!mtp_proplist_done(pl))
+        {
+            if (mtp_proplist_fill(pl, &vMtpRing) < 0)
+                break;
+            run.payload += PumpIn(&vMtpRing, pSink, size);
+        }
+        mtp_proplist_end(pl);
+        OpEnd(0);
+        run.transactions++;
+    }
+    End(&run);
+
+    Begin(&run, "GetObject");
+    for (uint32_t i = 0; i < vOpt.files; i++)
+    {
+        char path[24];
+
+        // As the opcode handler: by handle, or by path when the handle was evicted from the index
+        mtp_ring_reset(&vMtpRing);
+        snprintf(path, sizeof(path), "SD:/F%04u.BIN", i);
+        OpBegin(PTP_OC_GetObject);
+        if ((mtp_partial_open_handle(&obj, MTP_HANDLE(0, 0, i + 1), 0, 0xFFFFFFFF) < 0) &&
+            (mtp_partial_open(&obj, path, 0, 0xFFFFFFFF) < 0))
+        {
+            fprintf(stderr, "%s not found\n", path);
+            return(-1);
+        }
+        len = 0;
+        while (obj.remaining > 0)
+        {
+            if (mtp_partial_fill(&obj, &vMtpRing) < 0)
+                break;
+            len += PumpIn(&vMtpRing, pSink + len, size - len);
+        }
+        len += PumpIn(&vMtpRing, pSink + len, size - len);
+        mtp_partial_close(&obj);
+        OpEnd(0);
+        Fill(pData, size, 0, i);
+        if ((len != size) || (memcmp(pSink, pData, size) != 0))
+        {
+            fprintf(stderr, "object %u read back wrong\n", i + 1);
+            return(-1);
+        }
+        run.transactions++;
+        run.payload += len;
+    }
+    End(&run);
+
+    if ((vOpt.large > 0) && (Large() < 0))
+        return(-1);
+
+    if ((vOpt.trace != NULL) && (DumpTrace() < 0))
+    {
+        fprintf(stderr, "trace dump failed\n");
+        return(-1);
+    }
+    sim_diskio_unmount();
+    return(0);
+}
+
+#endif
+
+
+int
+main(int argc, char* argv[])
+{
+    int c, ret;
+
+    while ((c = getopt(argc, argv, "i:m:s:n:r:t:l:")) != -1)
+    {
+        switch (c)
+        {
+        case 'i': vOpt.image = optarg; break;
+        case 'm': vOpt.volume = strtoul(optarg, NULL, 0); break;
+        case 's': vOpt.size = strtoul(optarg, NULL, 0); break;
+        case 'n': vOpt.files = strtoul(optarg, NULL, 0); break;
+        case 'r': vOpt.repeats = strtoul(optarg, NULL, 0); break;
+        case 't': vOpt.trace = optarg; break;
+        case 'l': vOpt.large = strtoul(optarg, NULL, 0); break;
+        default:
+            fprintf(stderr, "usage: %s [-i image] [-m volume MB] [-s file KB] [-n files] [-r repeats] [-t trace] [-l large MB]\n", argv[0]);
+            return(2);
+        }
+    }
+    if ((vOpt.size == 0) || ((uint64_t)vOpt.size * vOpt.files + vOpt.large * 1024ULL > vOpt.volume * 1024ULL * 7 / 8))
+    {
+        fprintf(stderr, "files do not fit the volume\n");
+        return(2);
+    }
+
+    pData = malloc(vOpt.size * 1024);
+    pSink = malloc(vOpt.size * 1024 + 65536);
+    if ((pData == NULL) || (pSink == NULL))
+        return(1);
+#ifdef HAVE_MTP_CLASS
+    // The VFS mounts what is on the image, make it with 'make image'
+    if (sim_disk_open(vOpt.image, 0) < 0)
+    {
+        fprintf(stderr, "%s: no formatted disk image\n", vOpt.image);
+        return(1);
+    }
+    vOpt.volume = sim_disk_sectors() / 2048;
+#else
+    if (sim_disk_open(vOpt.image, vOpt.volume * 2048) < 0)
+        return(1);
+#endif
+
+    mtp_trace_init();
+    printf("%u files of %u KB on a %u MB volume, %u repeats, FatFs %s\n", vOpt.files, vOpt.size, vOpt.volume, vOpt.repeats, FATFS_VERSION);
+    ret = Bench();
+    sim_disk_close();
+    free(pData);
+    free(pSink);
+    return((ret < 0) ? 1 : 0);
+}
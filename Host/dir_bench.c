@@ -0,0 +1,234 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      dir_bench.c
+ \brief     Directory look up benchmark on synthetic folders
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ Fills one folder of the file backed disk with numbered files, as a data
+ logger does, and times what MTP does by name in it: GetObjectInfo and
+ GetObject (f_stat and f_open of files that exist), SendObjectInfo (f_stat of
+ a name that does not exist yet) and SendObject plus DeleteObject (create
+ and remove a file).
+
+ Per workload it reports the host time and the sectors FatFs asks for per
+ operation, and the sectors that missed the sector cache. The volume is
+ mounted anew before the look ups, the first one builds the name index of
+ the folder. The Makefile builds it twice, ./build/dir_bench with the index
+ (_USE_DIRHASH) and ./build/dir_bench_linear without.
+
+ Usage: dir_bench [-n files] [-r look ups] [-l] [-i image]
+          -l   long names, "Logger channel 1 record 00001.csv", instead of 8.3
+****************************************************************************/
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sim_disk.h"
+#include "sim_diskio.h"
+#include "disk_cache.h"
+
+
+#define SIM_PDRV    1
+
+
+typedef struct
+{
+    const char*         name;
+    struct timespec     start;
+    DiskCacheStats_t    cache;
+    uint32_t            device;
+    uint32_t            ops;
+} Run_t;
+
+
+static struct
+{
+    uint32_t    files;
+    uint32_t    lookups;
+    bool        lfn;
+    const char* image;
+} vOpt = {5000, 2000, false, "build/dir_bench.img"};
+
+
+static void
+Begin(Run_t* run, const char* name)
+{
+    run->name = name;
+    run->ops = 0;
+    disk_cache_stats(SIM_PDRV, &run->cache);
+    run->device = vSimDiskStats.read_calls + vSimDiskStats.write_calls;
+    clock_gettime(CLOCK_MONOTONIC, &run->start);
+}
+
+
+static void
+End(Run_t* run)
+{
+    struct timespec now;
+    DiskCacheStats_t cache;
+    double us, sectors, device;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    disk_cache_stats(SIM_PDRV, &cache);
+    if (run->ops == 0)
+        run->ops = 1;
+    us = ((now.tv_sec - run->start.tv_sec) * 1e6 + (now.tv_nsec - run->start.tv_nsec) / 1e3) / run->ops;
+    sectors = (double)((cache.hits - run->cache.hits) + (cache.misses - run->cache.misses) + (cache.bypassed - run->cache.bypassed)) / run->ops;
+    device = (double)(vSimDiskStats.read_calls + vSimDiskStats.write_calls - run->device) / run->ops;
+
+    printf("%-20s %6u ops %10.2f us/op %9.2f sectors/op %9.2f device/op\n", run->name, run->ops, us, sectors, device);
+}
+
+
+static void
+Path(char* path, uint32_t i)
+{
+    if (vOpt.lfn)
+        snprintf(path, 48, "SD:/LOGS/Logger channel 1 record %05u.csv", i);
+    else
+        snprintf(path, 48, "SD:/LOGS/LOG%05u.CSV", i);
+}
+
+
+static int
+Create(const char* path)
+{
+    FIL fil;
+    UINT bw;
+
+    if (f_open(&fil, path, FA_WRITE | FA_CREATE_NEW) != FR_OK)
+        return(-1);
+    f_write(&fil, path, 16, &bw);
+    return((f_close(&fil) == FR_OK) ? 0 : -1);
+}
+
+
+static int
+Bench(void)
+{
+    FILINFO fno;
+    FIL fil;
+    char path[48];
+    Run_t run;
+
+    memset(&fno, 0, sizeof(fno));
+    if ((sim_diskio_mount(true) != FR_OK) || (f_mkdir("SD:/LOGS") != FR_OK))
+    {
+        fprintf(stderr, "format failed\n");
+        return(-1);
+    }
+
+    Begin(&run, "Fill folder");
+    for (uint32_t i = 0; i < vOpt.files; i++)
+    {
+        Path(path, i);
+        if (Create(path) < 0)
+        {
+            fprintf(stderr, "creating %s failed\n", path);
+            return(-1);
+        }
+        run.ops++;
+    }
+    End(&run);
+
+    // Look ups on a fresh mount, the first one indexes the folder
+    sim_diskio_unmount();
+    sim_diskio_mount(false);
+    srand(1);
+
+    Begin(&run, "First GetObjectInfo");
+    Path(path, vOpt.files / 2);
+    if (f_stat(path, &fno) != FR_OK)
+        return(-1);
+    run.ops++;
+    End(&run);
+
+    Begin(&run, "GetObjectInfo");
+    for (uint32_t i = 0; i < vOpt.lookups; i++)
+    {
+        Path(path, rand() % vOpt.files);
+        if (f_stat(path, &fno) != FR_OK)
+        {
+            fprintf(stderr, "%s not found\n", path);
+            return(-1);
+        }
+        run.ops++;
+    }
+    End(&run);
+
+    Begin(&run, "GetObject open");
+    for (uint32_t i = 0; i < vOpt.lookups; i++)
+    {
+        Path(path, rand() % vOpt.files);
+        if (f_open(&fil, path, FA_READ) != FR_OK)
+            return(-1);
+        f_close(&fil);
+        run.ops++;
+    }
+    End(&run);
+
+    Begin(&run, "SendObjectInfo");
+    for (uint32_t i = 0; i < vOpt.lookups; i++)
+    {
+        Path(path, vOpt.files + rand() % vOpt.files);
+        if (f_stat(path, &fno) != FR_NO_FILE)
+            return(-1);
+        run.ops++;
+    }
+    End(&run);
+
+    Begin(&run, "SendObject+Delete");
+    for (uint32_t i = 0; i < vOpt.lookups / 10; i++)
+    {
+        Path(path, vOpt.files + i);
+        if ((Create(path) < 0) || (f_unlink(path) != FR_OK))
+            return(-1);
+        run.ops++;
+    }
+    End(&run);
+
+    sim_diskio_unmount();
+    return(0);
+}
+
+
+int
+main(int argc, char* argv[])
+{
+    int c, ret;
+
+    while ((c = getopt(argc, argv, "n:r:li:")) != -1)
+    {
+        switch (c)
+        {
+        case 'n': vOpt.files = strtoul(optarg, NULL, 0); break;
+        case 'r': vOpt.lookups = strtoul(optarg, NULL, 0); break;
+        case 'l': vOpt.lfn = true; break;
+        case 'i': vOpt.image = optarg; break;
+        default:
+            fprintf(stderr, "usage: %s [-n files] [-r look ups] [-l] [-i image]\n", argv[0]);
+            return(2);
+        }
+    }
+    if ((vOpt.files == 0) || (vOpt.files > 60000))
+    {
+        fprintf(stderr, "1 to 60000 files\n");
+        return(2);
+    }
+
+    if (sim_disk_open(vOpt.image, 262144) < 0)
+        return(1);
+    printf("%u files with %s names, name index %s\n", vOpt.files, vOpt.lfn ? "long" : "8.3", _USE_DIRHASH ? "on" : "off");
+    ret = Bench();
+    sim_disk_close();
+    return((ret < 0) ? 1 : 0);
+}
@@ -0,0 +1,283 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      mtp_initiator.c
+ \brief     Scripted MTP initiator on the simulated USB bus
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ A transaction is a command container on the bulk OUT pipe, optionally a
+ data container in either direction and a response container on the bulk
+ IN pipe. The device is given the chance to catch up through
+ sim_pcd_idle() whenever a pipe is not ready.
+****************************************************************************/
+
+#include "mtp_initiator.h"
+#include "sim_pcd.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define PTP_CONTAINER_COMMAND       1
+#define PTP_CONTAINER_DATA          2
+#define PTP_CONTAINER_RESPONSE      3
+
+#define PTP_HEADER                  12
+#define IDLE_LIMIT                  100000  // sim_pcd_idle() calls before giving up on the device
+#define STAGE_SIZE                  65536
+
+
+static uint8_t vStage[STAGE_SIZE];
+
+
+static uint8_t*
+Put16(uint8_t* p, uint16_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    return(p + 2);
+}
+
+
+static uint8_t*
+Put32(uint8_t* p, uint32_t v)
+{
+    p = Put16(p, v);
+    return(Put16(p, v >> 16));
+}
+
+
+static uint32_t
+Get32(const uint8_t* p)
+{
+    return(p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24));
+}
+
+
+static uint8_t*
+PutStr(uint8_t* p, const char* s)
+{
+    uint8_t len = (s == NULL) ? 0 : strlen(s);
+
+    if (len == 0)
+    {
+        *p++ = 0;
+        return(p);
+    }
+    *p++ = len + 1;
+    while (*s != 0)
+        p = Put16(p, (uint8_t)*s++);
+    return(Put16(p, 0));
+}
+
+
+/*! Send one container, header and payload as one transfer.
+ */
+static int
+SendContainer(MtpInitiator_t* mi, uint16_t type, uint16_t code, const uint8_t* data, uint32_t len)
+{
+    uint32_t total = 0, size = PTP_HEADER + len;
+    uint8_t* buf = malloc(size);
+    int idle = 0;
+
+    if (buf == NULL)
+        return(MTP_INITIATOR_ERROR);
+    Put16(Put16(Put32(buf, size), type), code);
+    Put32(buf + 8, mi->transaction);
+    if (len > 0)
+        memcpy(buf + PTP_HEADER, data, len);
+
+    while (total < size)
+    {
+        int32_t n = sim_pcd_out(mi->ep_out, buf + total, size - total);
+
+        if (n < 0)
+            break;
+        total += n;
+        if (n > 0)
+            idle = 0;
+        else if (++idle > IDLE_LIMIT)
+            break;
+        else
+            sim_pcd_idle();
+    }
+    free(buf);
+    return((total == size) ? 0 : MTP_INITIATOR_ERROR);
+}
+
+
+/*! Receive one container. The payload of a data container goes to 'data'
+ * up to 'max' bytes, that of a response to 'resp'. Returns the container
+ * type or MTP_INITIATOR_ERROR.
+ */
+static int
+ReceiveContainer(MtpInitiator_t* mi, uint8_t* hdr, uint8_t* data, uint32_t max, uint8_t* resp, uint32_t* len)
+{
+    uint32_t total = 0, size = PTP_HEADER;
+    int idle = 0;
+
+    *len = 0;
+    while (total < size)
+    {
+        int32_t n = sim_pcd_in(mi->ep_in, vStage, STAGE_SIZE);
+
+        if (n == SIM_PCD_STALL)
+            return(MTP_INITIATOR_ERROR);
+        if (n <= 0)
+        {
+            // Nothing queued, or a zero length packet closing the previous container
+            if (++idle > IDLE_LIMIT)
+                return(MTP_INITIATOR_ERROR);
+            sim_pcd_idle();
+            continue;
+        }
+        idle = 0;
+
+        for (int32_t i = 0; i < n; i++, total++)
+        {
+            if (total < PTP_HEADER)
+            {
+                hdr[total] = vStage[i];
+                if (total < PTP_HEADER - 1)
+                    continue;
+                size = Get32(hdr);
+                if ((hdr[4] | (hdr[5] << 8)) == PTP_CONTAINER_RESPONSE)
+                {
+                    data = resp;
+                    max = 20;
+                }
+            }
+            else if ((data != NULL) && (total - PTP_HEADER < max))
+                data[total - PTP_HEADER] = vStage[i];
+        }
+        if ((size < PTP_HEADER) || (total > size))
+            return(MTP_INITIATOR_ERROR);
+    }
+    *len = size - PTP_HEADER;
+    return(hdr[4] | (hdr[5] << 8));
+}
+
+
+/*! Enumerate the device and select its configuration. Returns 0 or
+ * MTP_INITIATOR_ERROR when there is no bulk pipe pair.
+ */
+int
+mtp_initiator_connect(MtpInitiator_t* mi)
+{
+    USBD_SetupReqTypedef req;
+    uint8_t desc[512];
+    int32_t len;
+
+    memset(mi, 0, sizeof(*mi));
+    sim_pcd_attach();
+
+    req = (USBD_SetupReqTypedef){0x80, USB_REQ_GET_DESCRIPTOR, USB_DESC_TYPE_DEVICE << 8, 0, USB_LEN_DEV_DESC};
+    if (sim_pcd_control(&req, desc) != USB_LEN_DEV_DESC)
+        return(MTP_INITIATOR_ERROR);
+    req = (USBD_SetupReqTypedef){0x00, USB_REQ_SET_ADDRESS, 5, 0, 0};
+    if (sim_pcd_control(&req, NULL) < 0)
+        return(MTP_INITIATOR_ERROR);
+    req = (USBD_SetupReqTypedef){0x80, USB_REQ_GET_DESCRIPTOR, USB_DESC_TYPE_CONFIGURATION << 8, 0, sizeof(desc)};
+    if (len = sim_pcd_control(&req, desc), len < USB_LEN_CFG_DESC)
+        return(MTP_INITIATOR_ERROR);
+
+    for (int32_t i = 0; (i + 1 < len) && (desc[i] > 0); i += desc[i])
+    {
+        if ((desc[i + 1] != USB_DESC_TYPE_ENDPOINT) || (i + 6 >= len))
+            continue;
+        if ((desc[i + 3] & 3) == USBD_EP_TYPE_BULK)
+        {
+            if (desc[i + 2] & 0x80)
+                mi->ep_in = desc[i + 2];
+            else
+                mi->ep_out = desc[i + 2];
+            mi->mps = desc[i + 4] | (desc[i + 5] << 8);
+        }
+        else if ((desc[i + 3] & 3) == USBD_EP_TYPE_INTR)
+            mi->ep_int = desc[i + 2];
+    }
+    if ((mi->ep_in == 0) || (mi->ep_out == 0))
+        return(MTP_INITIATOR_ERROR);
+
+    req = (USBD_SetupReqTypedef){0x00, USB_REQ_SET_CONFIGURATION, desc[5], 0, 0};
+    if (sim_pcd_control(&req, NULL) < 0)
+        return(MTP_INITIATOR_ERROR);
+    return(0);
+}
+
+
+/*! Run one transaction. 'out' is sent as the data phase, otherwise a data
+ * phase from the device is stored in 'in'. Returns the response code with
+ * the response parameters in 'mi->params', or MTP_INITIATOR_ERROR.
+ */
+int
+mtp_initiator_transact(MtpInitiator_t* mi, uint16_t code, const uint32_t* params, int nparams,
+                       const void* out, uint32_t outlen, void* in, uint32_t inmax, uint32_t* inlen)
+{
+    uint8_t cmd[20], hdr[PTP_HEADER], resp[20];
+    uint32_t len;
+    int type;
+
+    if (inlen != NULL)
+        *inlen = 0;
+    if (code == PTP_OC_OpenSession)
+        mi->transaction = 0;
+    for (int i = 0; i < nparams; i++)
+        Put32(&cmd[i * 4], params[i]);
+
+    if (SendContainer(mi, PTP_CONTAINER_COMMAND, code, cmd, nparams * 4) < 0)
+        return(MTP_INITIATOR_ERROR);
+    if ((out != NULL) && (SendContainer(mi, PTP_CONTAINER_DATA, code, out, outlen) < 0))
+        return(MTP_INITIATOR_ERROR);
+
+    if (type = ReceiveContainer(mi, hdr, in, inmax, resp, &len), type == PTP_CONTAINER_DATA)
+    {
+        if (inlen != NULL)
+            *inlen = len;
+        mi->payload += len;
+        type = ReceiveContainer(mi, hdr, NULL, 0, resp, &len);
+    }
+    if (type != PTP_CONTAINER_RESPONSE)
+        return(MTP_INITIATOR_ERROR);
+
+    mi->nparams = (len > sizeof(resp)) ? 5 : len / 4;
+    for (uint32_t i = 0; i < mi->nparams; i++)
+        mi->params[i] = Get32(&resp[i * 4]);
+
+    mi->payload += (out != NULL) ? outlen : 0;
+    mi->transactions++;
+    mi->transaction++;
+    return(hdr[6] | (hdr[7] << 8));
+}
+
+
+/*! Build an ObjectInfo dataset for SendObjectInfo. Returns its length.
+ */
+uint32_t
+mtp_initiator_object_info(uint8_t* buf, uint32_t storage, const char* name, uint32_t size)
+{
+    uint8_t* p = buf;
+
+    p = Put32(p, storage);
+    p = Put16(p, 0x3000);           // ObjectFormat: undefined
+    p = Put16(p, 0);                // ProtectionStatus
+    p = Put32(p, size);             // ObjectCompressedSize
+    p = Put16(p, 0);                // ThumbFormat
+    for (int i = 0; i < 6; i++)
+        p = Put32(p, 0);            // Thumb and image sizes, bit depth
+    p = Put32(p, 0);                // ParentObject: root
+    p = Put16(p, 0);                // AssociationType
+    p = Put32(p, 0);                // AssociationDesc
+    p = Put32(p, 0);                // SequenceNumber
+    p = PutStr(p, name);
+    p = PutStr(p, NULL);            // CaptureDate
+    p = PutStr(p, "20261016T120000");
+    p = PutStr(p, NULL);            // Keywords
+    return(p - buf);
+}
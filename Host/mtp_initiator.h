@@ -0,0 +1,69 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      mtp_initiator.h
+ \brief     Scripted MTP initiator on the simulated USB bus
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ Enumerates the device through sim_pcd and runs PTP transactions on its
+ bulk pipes, the way libmtp or the Windows WPD driver would.
+****************************************************************************/
+
+#ifndef _MTP_INITIATOR_H
+#define _MTP_INITIATOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+// Operation codes used by the benchmark
+#define PTP_OC_OpenSession          0x1002
+#define PTP_OC_CloseSession         0x1003
+#define PTP_OC_GetStorageIDs        0x1004
+#define PTP_OC_GetObjectHandles     0x1007
+#define PTP_OC_GetObject            0x1009
+#define PTP_OC_DeleteObject         0x100B
+#define PTP_OC_SendObjectInfo       0x100C
+#define PTP_OC_SendObject           0x100D
+
+#define PTP_RC_OK                   0x2001
+
+#define MTP_INITIATOR_ERROR         (-1)    // Bus or protocol error, not a response code
+
+
+typedef struct
+{
+    uint8_t     ep_in;
+    uint8_t     ep_out;
+    uint8_t     ep_int;
+    uint16_t    mps;
+    uint32_t    transaction;
+    uint32_t    transactions;   // Completed transactions
+    uint64_t    payload;        // Data phase bytes, both directions
+    uint32_t    params[5];      // Parameters of the last response
+    uint32_t    nparams;
+} MtpInitiator_t;
+
+
+int      mtp_initiator_connect(MtpInitiator_t* mi);
+int      mtp_initiator_transact(MtpInitiator_t* mi, uint16_t code, const uint32_t* params, int nparams,
+                                const void* out, uint32_t outlen, void* in, uint32_t inmax, uint32_t* inlen);
+
+uint32_t mtp_initiator_object_info(uint8_t* buf, uint32_t storage, const char* name, uint32_t size);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*_MTP_INITIATOR_H */
@@ -0,0 +1,519 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      nor_bench.c
+ \brief     File system benchmark on the simulated octal NOR
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ Compares the two ways of putting "SPI:" on the MX25LM51245G, FatFs over
+ nor_ftl.c and LittleFS through nor_lfs.c, under what an MTP host does with
+ small files: SendObject (create and write in ring sized parts),
+ GetObjectHandles (list the folder), GetObjectInfo (stat), GetObject (read
+ back and compare), a second SendObject over existing names and
+ DeleteObject.
+
+ Both run on the same simulated NOR, starting erased. Per workload it
+ reports operations per second of host CPU and of modelled flash time,
+ which is what counts on the board, and the programmed bytes and erases.
+ LittleFS is part of the build when its sources are found in LFS_DIR,
+ 'make littlefs' vendors them.
+ After the FatFs run it checks that a trimmed page still in the FTL cache
+ is not written out by ftl_poll().
+
+ Usage: nor_bench [-n files] [-s file bytes] [-c write bytes] [-r repeats]
+****************************************************************************/
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sim_nor.h"
+#include "sim_diskio.h"
+#include "nor_ftl.h"
+#ifdef HAVE_LITTLEFS
+#include "nor_lfs.h"
+#endif
+
+
+#define KB          1024.0
+
+
+typedef struct
+{
+    const char* name;
+    int         (*format)(void);
+    void        (*unmount)(void);
+    int         (*put)(const char* name, const uint8_t* data, uint32_t size, uint32_t chunk);
+    int         (*get)(const char* name, uint8_t* data, uint32_t size);
+    int         (*list)(uint32_t* count);
+    int         (*stat)(const char* name, uint32_t* size);
+    int         (*remove)(const char* name);
+} Backend_t;
+
+typedef struct
+{
+    const char*     name;
+    struct timespec start;
+    uint32_t        ops;
+} Run_t;
+
+
+static struct
+{
+    uint32_t    files;
+    uint32_t    size;       // Bytes per file
+    uint32_t    chunk;      // Bytes per write, as the transfer ring drains
+    uint32_t    repeats;
+} vOpt = {256, 2048, 8192, 16};
+
+static uint8_t* pData;
+static uint8_t* pSink;
+
+
+static void
+Begin(Run_t* run, const char* name)
+{
+    run->name = name;
+    run->ops = 0;
+    sim_nor_reset_stats();
+    clock_gettime(CLOCK_MONOTONIC, &run->start);
+}
+
+
+static void
+End(const Backend_t* be, Run_t* run)
+{
+    struct timespec now;
+    double s, dev = vSimNorStats.device_ns / 1e9;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    s = (now.tv_sec - run->start.tv_sec) + (now.tv_nsec - run->start.tv_nsec) / 1e9;
+    if (s <= 0)
+        s = 1e-9;
+    if (dev <= 0)
+        dev = 1e-9;
+
+    printf("%-8s %-18s %6u ops %10.1f ops/s %9.1f ops/s flash %9.1f KB prog %6u erases %7.1f KB read\n",
+           be->name, run->name, run->ops, run->ops / s, run->ops / dev, vSimNorStats.prog_bytes / KB,
+           vSimNorStats.erases_4k + vSimNorStats.erases_64k, (vSimNorStats.read_bytes + vSimNorStats.map_bytes) / KB);
+}
+
+
+static void
+Fill(uint8_t* p, uint32_t len, uint32_t seed)
+{
+    for (uint32_t i = 0; i < len; i++)
+        p[i] = (uint8_t)((i * 31) ^ (i >> 9) ^ seed);
+}
+
+
+/*** FatFs over the FTL ***/
+
+static int
+FatPath(char* path, const char* name)
+{
+    return(snprintf(path, 24, "SPI:/%s", name));
+}
+
+
+static int
+FatFormat(void)
+{
+    return((sim_diskio_mount(true) == FR_OK) ? 0 : -1);
+}
+
+
+static void
+FatUnmount(void)
+{
+    sim_diskio_unmount();
+}
+
+
+static int
+FatPut(const char* name, const uint8_t* data, uint32_t size, uint32_t chunk)
+{
+    char path[24];
+    FIL fil;
+    UINT bw;
+    FRESULT res;
+
+    FatPath(path, name);
+    if (res = f_open(&fil, path, FA_WRITE | FA_CREATE_ALWAYS), res != FR_OK)
+        return(-1);
+    for (uint32_t off = 0; (res == FR_OK) && (off < size); off += chunk)
+    {
+        uint32_t len = (size - off < chunk) ? size - off : chunk;
+
+        if ((res = f_write(&fil, data + off, len, &bw), res == FR_OK) && (bw != len))
+            res = FR_DENIED;
+    }
+    if (f_close(&fil) != FR_OK)
+        res = FR_DISK_ERR;
+    return((res == FR_OK) ? 0 : -1);
+}
+
+
+static int
+FatGet(const char* name, uint8_t* data, uint32_t size)
+{
+    char path[24];
+    FIL fil;
+    UINT br;
+    FRESULT res;
+
+    FatPath(path, name);
+    if (res = f_open(&fil, path, FA_READ), res != FR_OK)
+        return(-1);
+    res = f_read(&fil, data, size, &br);
+    f_close(&fil);
+    return(((res == FR_OK) && (br == size)) ? 0 : -1);
+}
+
+
+static int
+FatList(uint32_t* count)
+{
+    DIR dir;
+    FILINFO fno;
+    FRESULT res;
+
+    *count = 0;
+#if _USE_LFN
+    fno.lfname = NULL;
+    fno.lfsize = 0;
+#endif
+    if (res = f_opendir(&dir, "SPI:/"), res != FR_OK)
+        return(-1);
+    while (res = f_readdir(&dir, &fno), (res == FR_OK) && (fno.fname[0] != 0))
+    {
+        if ((fno.fattrib & AM_DIR) == 0)
+            (*count)++;
+    }
+    f_closedir(&dir);
+    return((res == FR_OK) ? 0 : -1);
+}
+
+
+static int
+FatStat(const char* name, uint32_t* size)
+{
+    char path[24];
+    FILINFO fno;
+
+#if _USE_LFN
+    fno.lfname = NULL;
+    fno.lfsize = 0;
+#endif
+    FatPath(path, name);
+    if (f_stat(path, &fno) != FR_OK)
+        return(-1);
+    *size = fno.fsize;
+    return(0);
+}
+
+
+static int
+FatRemove(const char* name)
+{
+    char path[24];
+
+    FatPath(path, name);
+    return((f_unlink(path) == FR_OK) ? 0 : -1);
+}
+
+
+static const Backend_t vFat =
+{
+    "FatFs", FatFormat, FatUnmount, FatPut, FatGet, FatList, FatStat, FatRemove
+};
+
+
+/*** LittleFS ***/
+
+#ifdef HAVE_LITTLEFS
+
+static lfs_t vLfs;
+static struct lfs_config vLfsCfg;
+
+
+static int
+LfsFormat(void)
+{
+    memset(&vLfsCfg, 0, sizeof(vLfsCfg));
+    if ((nor_lfs_config(&vLfsCfg) < 0) || (lfs_format(&vLfs, &vLfsCfg) < 0))
+        return(-1);
+    return((lfs_mount(&vLfs, &vLfsCfg) < 0) ? -1 : 0);
+}
+
+
+static void
+LfsUnmount(void)
+{
+    lfs_unmount(&vLfs);
+}
+
+
+static int
+LfsPut(const char* name, const uint8_t* data, uint32_t size, uint32_t chunk)
+{
+    lfs_file_t file;
+    int err = 0;
+
+    if (lfs_file_open(&vLfs, &file, name, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC) < 0)
+        return(-1);
+    for (uint32_t off = 0; (err >= 0) && (off < size); off += chunk)
+    {
+        uint32_t len = (size - off < chunk) ? size - off : chunk;
+
+        if ((err = lfs_file_write(&vLfs, &file, data + off, len), err >= 0) && (err != (int)len))
+            err = -1;
+    }
+    if (lfs_file_close(&vLfs, &file) < 0)
+        err = -1;
+    return((err < 0) ? -1 : 0);
+}
+
+
+static int
+LfsGet(const char* name, uint8_t* data, uint32_t size)
+{
+    lfs_file_t file;
+    lfs_ssize_t n;
+
+    if (lfs_file_open(&vLfs, &file, name, LFS_O_RDONLY) < 0)
+        return(-1);
+    n = lfs_file_read(&vLfs, &file, data, size);
+    lfs_file_close(&vLfs, &file);
+    return((n == (lfs_ssize_t)size) ? 0 : -1);
+}
+
+
+static int
+LfsList(uint32_t* count)
+{
+    struct lfs_info info;
+    lfs_dir_t dir;
+    int err;
+
+    *count = 0;
+    if (lfs_dir_open(&vLfs, &dir, "/") < 0)
+        return(-1);
+    while (err = lfs_dir_read(&vLfs, &dir, &info), err > 0)
+    {
+        if (info.type == LFS_TYPE_REG)
+            (*count)++;
+    }
+    lfs_dir_close(&vLfs, &dir);
+    return((err < 0) ? -1 : 0);
+}
+
+
+static int
+LfsStat(const char* name, uint32_t* size)
+{
+    struct lfs_info info;
+
+    if (lfs_stat(&vLfs, name, &info) < 0)
+        return(-1);
+    *size = info.size;
+    return(0);
+}
+
+
+static int
+LfsRemove(const char* name)
+{
+    return((lfs_remove(&vLfs, name) < 0) ? -1 : 0);
+}
+
+
+static const Backend_t vLfsBackend =
+{
+    "LittleFS", LfsFormat, LfsUnmount, LfsPut, LfsGet, LfsList, LfsStat, LfsRemove
+};
+
+#endif
+
+
+static void
+Name(char* name, uint32_t i)
+{
+    snprintf(name, 16, "F%04u.TXT", i);
+}
+
+
+static int
+Bench(const Backend_t* be)
+{
+    uint32_t count, size;
+    char name[16];
+    Run_t run;
+
+    if (sim_nor_open() < 0)
+        return(-1);
+
+    Begin(&run, "Format");
+    if (be->format() < 0)
+    {
+        fprintf(stderr, "%s: format failed\n", be->name);
+        return(-1);
+    }
+    run.ops++;
+    End(be, &run);
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        Begin(&run, pass ? "SendObject again" : "SendObject");
+        for (uint32_t i = 0; i < vOpt.files; i++)
+        {
+            Name(name, i);
+            Fill(pData, vOpt.size, i + pass);
+            if (pass && (be->remove(name) < 0))
+                return(-1);
+            if (be->put(name, pData, vOpt.size, vOpt.chunk) < 0)
+            {
+                fprintf(stderr, "%s: writing %s failed\n", be->name, name);
+                return(-1);
+            }
+            run.ops++;
+        }
+        End(be, &run);
+    }
+
+    Begin(&run, "GetObjectHandles");
+    for (uint32_t r = 0; r < vOpt.repeats; r++)
+    {
+        if ((be->list(&count) < 0) || (count != vOpt.files))
+        {
+            fprintf(stderr, "%s: listed %u of %u files\n", be->name, count, vOpt.files);
+            return(-1);
+        }
+        run.ops++;
+    }
+    End(be, &run);
+
+    Begin(&run, "GetObjectInfo");
+    for (uint32_t i = 0; i < vOpt.files; i++)
+    {
+        Name(name, i);
+        if ((be->stat(name, &size) < 0) || (size != vOpt.size))
+            return(-1);
+        run.ops++;
+    }
+    End(be, &run);
+
+    Begin(&run, "GetObject");
+    for (uint32_t i = 0; i < vOpt.files; i++)
+    {
+        Name(name, i);
+        Fill(pData, vOpt.size, i + 1);
+        if ((be->get(name, pSink, vOpt.size) < 0) || (memcmp(pSink, pData, vOpt.size) != 0))
+        {
+            fprintf(stderr, "%s: %s read back wrong\n", be->name, name);
+            return(-1);
+        }
+        run.ops++;
+    }
+    End(be, &run);
+
+    Begin(&run, "DeleteObject");
+    for (uint32_t i = 0; i < vOpt.files; i++)
+    {
+        Name(name, i);
+        if (be->remove(name) < 0)
+            return(-1);
+        run.ops++;
+    }
+    End(be, &run);
+
+    be->unmount();
+    return(0);
+}
+
+
+/*! A page written and trimmed before it left the cache must not be written
+ * out by the background flush, it reads as zeros.
+ */
+static int
+TrimCheck(void)
+{
+    uint32_t sector = 10 * FTL_PAGE_SECTORS;
+    uint32_t start;
+
+    Fill(pData, FTL_PAGE_SIZE, 0x5A);
+    if ((ftl_write(pData, sector, FTL_PAGE_SECTORS) < 0) || (ftl_trim(sector, FTL_PAGE_SECTORS) < 0))
+        return(-1);
+    for (start = HAL_GetTick(); HAL_GetTick() - start <= FTL_FLUSH_MS + 100; )
+        HAL_Delay(10);
+    ftl_poll();
+    if ((ftl_sync() < 0) || (ftl_read(pSink, sector, FTL_PAGE_SECTORS) < 0))
+        return(-1);
+    for (uint32_t i = 0; i < FTL_PAGE_SIZE; i++)
+    {
+        if (pSink[i] != 0)
+        {
+            fprintf(stderr, "FTL: trimmed page reads back data\n");
+            return(-1);
+        }
+    }
+    printf("FTL: trim of a cached page ok\n");
+    return(0);
+}
+
+
+int
+main(int argc, char* argv[])
+{
+    FtlStats_t st;
+    int c, ret;
+
+    while ((c = getopt(argc, argv, "n:s:c:r:")) != -1)
+    {
+        switch (c)
+        {
+        case 'n': vOpt.files = strtoul(optarg, NULL, 0); break;
+        case 's': vOpt.size = strtoul(optarg, NULL, 0); break;
+        case 'c': vOpt.chunk = strtoul(optarg, NULL, 0); break;
+        case 'r': vOpt.repeats = strtoul(optarg, NULL, 0); break;
+        default:
+            fprintf(stderr, "usage: %s [-n files] [-s file bytes] [-c write bytes] [-r repeats]\n", argv[0]);
+            return(2);
+        }
+    }
+    if ((vOpt.size == 0) || (vOpt.chunk == 0) || ((uint64_t)vOpt.size * vOpt.files > SIM_NOR_SIZE / 2))
+    {
+        fprintf(stderr, "files do not fit the flash\n");
+        return(2);
+    }
+
+    pData = malloc((vOpt.size > FTL_PAGE_SIZE) ? vOpt.size : FTL_PAGE_SIZE);
+    pSink = malloc((vOpt.size > FTL_PAGE_SIZE) ? vOpt.size : FTL_PAGE_SIZE);
+    if ((pData == NULL) || (pSink == NULL))
+        return(1);
+
+    printf("%u files of %u bytes written in %u byte parts, %u repeats\n", vOpt.files, vOpt.size, vOpt.chunk, vOpt.repeats);
+    ret = Bench(&vFat);
+    ftl_stats(&st);
+    printf("%-8s FTL: %u pages programmed, %u relocated, erases %u..%u\n", vFat.name, st.programmed, st.relocated, st.erases_min, st.erases_max);
+    if ((ret == 0) && (TrimCheck() < 0))
+        ret = -1;
+#ifdef HAVE_LITTLEFS
+    if (ret == 0)
+        ret = Bench(&vLfsBackend);
+#else
+    printf("LittleFS not built, no lfs.c in LFS_DIR, see make littlefs\n");
+#endif
+
+    sim_nor_close();
+    free(pData);
+    free(pSink);
+    return((ret < 0) ? 1 : 0);
+}
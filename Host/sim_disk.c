@@ -0,0 +1,210 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      sim_disk.c
+ \brief     File backed SD card for the host build
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ The image is created, or grown, to the requested number of sectors. Every
+ disk_read/disk_write is one pread/pwrite, the same granularity at which
+ the target issues SD card commands.
+****************************************************************************/
+
+#define _GNU_SOURCE         // fallocate()
+#include "sim_disk.h"
+#include "sd_diskio.h"
+#include <fcntl.h>
+#include <linux/falloc.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+SimDiskStats_t vSimDiskStats;
+
+static int vFd = -1;
+static uint32_t vSectors;
+static volatile DSTATUS vStat = STA_NOINIT;
+
+
+/*! Open or create the disk image 'path' of 'sectors' sectors, 0 takes the
+ * size of an existing image. Returns 0 or -1.
+ */
+int
+sim_disk_open(const char* path, uint32_t sectors)
+{
+    struct stat st;
+
+    if (vFd >= 0)
+        sim_disk_close();
+    if (vFd = open(path, O_RDWR | O_CREAT, 0644), vFd < 0)
+    {
+        perror(path);
+        return(-1);
+    }
+    if (fstat(vFd, &st) < 0)
+    {
+        sim_disk_close();
+        return(-1);
+    }
+    if (sectors == 0)
+        sectors = st.st_size / SIM_DISK_SECTOR;
+    if ((sectors == 0) || ((st.st_size < (off_t)sectors * SIM_DISK_SECTOR) && (ftruncate(vFd, (off_t)sectors * SIM_DISK_SECTOR) < 0)))
+    {
+        sim_disk_close();
+        return(-1);
+    }
+    vSectors = sectors;
+    return(0);
+}
+
+
+void
+sim_disk_close(void)
+{
+    if (vFd >= 0)
+        close(vFd);
+    vFd = -1;
+    vSectors = 0;
+    vStat = STA_NOINIT;
+}
+
+
+uint32_t
+sim_disk_sectors(void)
+{
+    return(vSectors);
+}
+
+
+void
+sim_disk_reset_stats(void)
+{
+    vSimDiskStats = (SimDiskStats_t){0};
+}
+
+
+static DSTATUS
+SD_initialize(void)
+{
+    vStat = (vFd < 0) ? STA_NOINIT : 0;
+    return(vStat);
+}
+
+
+static DSTATUS
+SD_status(void)
+{
+    return((vFd < 0) ? STA_NOINIT : vStat);
+}
+
+
+static DRESULT
+SD_read(BYTE* buff, DWORD sector, UINT count)
+{
+    size_t len = (size_t)count * SIM_DISK_SECTOR;
+
+    if (vStat & STA_NOINIT)
+        return(RES_NOTRDY);
+    if ((sector >= vSectors) || (count > vSectors - sector))
+        return(RES_PARERR);
+    vSimDiskStats.read_calls++;
+    if (pread(vFd, buff, len, (off_t)sector * SIM_DISK_SECTOR) != (ssize_t)len)
+        return(RES_ERROR);
+    vSimDiskStats.read_bytes += len;
+    return(RES_OK);
+}
+
+
+#if _USE_WRITE == 1
+static DRESULT
+SD_write(const BYTE* buff, DWORD sector, UINT count)
+{
+    size_t len = (size_t)count * SIM_DISK_SECTOR;
+
+    if (vStat & STA_NOINIT)
+        return(RES_NOTRDY);
+    if ((sector >= vSectors) || (count > vSectors - sector))
+        return(RES_PARERR);
+    vSimDiskStats.write_calls++;
+    if (pwrite(vFd, buff, len, (off_t)sector * SIM_DISK_SECTOR) != (ssize_t)len)
+        return(RES_ERROR);
+    vSimDiskStats.write_bytes += len;
+    return(RES_OK);
+}
+#endif
+
+
+#if _USE_IOCTL == 1
+// Erased sectors read as zeros, as on most cards; the image stays sparse
+static DRESULT
+SimErase(DWORD sector, DWORD count)
+{
+    static const uint8_t zero[SIM_DISK_SECTOR];
+
+    if ((sector >= vSectors) || (count > vSectors - sector))
+        return(RES_PARERR);
+    vSimDiskStats.erase_calls++;
+    vSimDiskStats.erase_sectors += count;
+    if (fallocate(vFd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t)sector * SIM_DISK_SECTOR, (off_t)count * SIM_DISK_SECTOR) == 0)
+        return(RES_OK);
+    for (; count > 0; count--, sector++)
+    {
+        if (pwrite(vFd, zero, SIM_DISK_SECTOR, (off_t)sector * SIM_DISK_SECTOR) != SIM_DISK_SECTOR)
+            return(RES_ERROR);
+    }
+    return(RES_OK);
+}
+
+
+static DRESULT
+SD_ioctl(BYTE cmd, void* buff)
+{
+    if (vStat & STA_NOINIT)
+        return(RES_NOTRDY);
+
+    switch (cmd)
+    {
+    case CTRL_SYNC:
+        vSimDiskStats.sync_calls++;
+        return(RES_OK);
+    case GET_SECTOR_COUNT:
+        *(DWORD*)buff = vSectors;
+        return(RES_OK);
+    case GET_SECTOR_SIZE:
+        *(WORD*)buff = SIM_DISK_SECTOR;
+        return(RES_OK);
+    case GET_BLOCK_SIZE:
+        *(DWORD*)buff = SIM_DISK_BLOCK;
+        return(RES_OK);
+    case CTRL_TRIM:
+        vSimDiskStats.trim_calls++;
+        vSimDiskStats.trim_sectors += ((DWORD*)buff)[1] - ((DWORD*)buff)[0] + 1;
+        return(RES_OK);
+    case SECTOR_ERASE:
+        return(SimErase(((DWORD*)buff)[0], ((DWORD*)buff)[1] - ((DWORD*)buff)[0] + 1));
+    default:
+        return(RES_PARERR);
+    }
+}
+#endif
+
+
+const Diskio_drvTypeDef SD_Driver =
+{
+    SD_initialize,
+    SD_status,
+    SD_read,
+#if _USE_WRITE == 1
+    SD_write,
+#endif
+#if _USE_IOCTL == 1
+    SD_ioctl,
+#endif
+};
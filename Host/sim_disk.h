@@ -0,0 +1,60 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      sim_disk.h
+ \brief     File backed SD card for the host build
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ SD_Driver on top of a disk image, so FatFs runs unchanged on the host. The
+ call and byte counters are what the benchmark reports as disk traffic.
+****************************************************************************/
+
+#ifndef _SIM_DISK_H
+#define _SIM_DISK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "ff_gen_drv.h"
+
+
+#define SIM_DISK_SECTOR         512U
+#define SIM_DISK_BLOCK          8U      // Erase block in sectors, as reported by GET_BLOCK_SIZE
+
+
+typedef struct
+{
+    uint32_t    read_calls;
+    uint32_t    write_calls;
+    uint64_t    read_bytes;
+    uint64_t    write_bytes;
+    uint32_t    sync_calls;
+    uint32_t    trim_calls;
+    uint64_t    trim_sectors;
+    uint32_t    erase_calls;
+    uint64_t    erase_sectors;
+} SimDiskStats_t;
+
+
+extern SimDiskStats_t vSimDiskStats;
+
+
+int      sim_disk_open(const char* path, uint32_t sectors);
+void     sim_disk_close(void);
+uint32_t sim_disk_sectors(void);
+void     sim_disk_reset_stats(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*_SIM_DISK_H */
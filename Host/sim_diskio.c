@@ -0,0 +1,185 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      sim_diskio.c
+ \brief     FatFs disk layer of the host build without VFS
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ Physical drive 1 ("SD" in _VOLUME_STRS) is the file backed disk, the other
+ drives are absent. The volume is storage 0 for the MTP handle index.
+
+ Built with SIM_NOR the volume is drive 0, "SPI", on the flash translation
+ layer over the simulated NOR instead.
+****************************************************************************/
+
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include "sim_diskio.h"
+#include "vfs_conf.h"
+#include "diskio.h"
+#include "mtp_trace.h"
+#include "disk_cache.h"
+
+
+#ifdef SIM_NOR
+#define SIM_PDRV    0
+#define SIM_DRIVE   "SPI:"
+#define SIM_DRIVER  SPIFLASH_Driver
+#else
+#define SIM_PDRV    1
+#define SIM_DRIVE   "SD:"
+#define SIM_DRIVER  SD_Driver
+#endif
+
+
+static FATFS vFatFs;
+static DWORD vDiskWrites[_VOLUMES];
+#if _FATFS != 32020
+static BYTE vMkfsWork[32 * _MAX_SS];
+#endif
+
+
+/*! Mount the volume, creating a fresh FAT (or exFAT) volume first when
+ * 'format' is set.
+ */
+FRESULT
+sim_diskio_mount(bool format)
+{
+    FRESULT res;
+
+    memset(&vFatFs, 0, sizeof(vFatFs));
+    if (format)
+    {
+        if (res = f_mount(&vFatFs, SIM_DRIVE, 0), res != FR_OK)
+            return(res);
+#if _FATFS == 32020
+        if (res = f_mkfs(SIM_DRIVE, 0, 0), res != FR_OK)
+            return(res);
+#else
+        // The exFAT build formats exFAT whatever the size, FatFs picks it by itself from 32 GB only
+        if (res = f_mkfs(SIM_DRIVE, _FS_EXFAT ? FM_EXFAT : FM_ANY, 0, vMkfsWork, sizeof(vMkfsWork)), res != FR_OK)
+            return(res);
+#endif
+    }
+    return(f_mount(&vFatFs, SIM_DRIVE, 1));
+}
+
+
+void
+sim_diskio_unmount(void)
+{
+    f_mount(NULL, SIM_DRIVE, 0);
+}
+
+
+FATFS*
+sim_diskio_fs(void)
+{
+    return(&vFatFs);
+}
+
+
+DSTATUS
+disk_initialize(BYTE pdrv)
+{
+    if (pdrv != SIM_PDRV)
+        return(STA_NOINIT);
+    disk_cache_attach(pdrv, &SIM_DRIVER);
+    return(SIM_DRIVER.disk_initialize());
+}
+
+
+DSTATUS
+disk_status(BYTE pdrv)
+{
+    if (pdrv != SIM_PDRV)
+        return(STA_NOINIT);
+    return(SIM_DRIVER.disk_status());
+}
+
+
+DRESULT
+disk_read(BYTE pdrv, BYTE* buff, DWORD sector, UINT count)
+{
+    DRESULT res;
+
+    if (pdrv != SIM_PDRV)
+        return(RES_NOTRDY);
+    MTP_TRACE_ENTER(TRACE_DISK_READ, (pdrv << 24) | count, sector);
+    res = disk_cache_read(pdrv, buff, sector, count);
+    MTP_TRACE_EXIT(TRACE_DISK_READ, res, sector);
+    return(res);
+}
+
+
+#if _USE_WRITE == 1
+DRESULT
+disk_write(BYTE pdrv, const BYTE* buff, DWORD sector, UINT count)
+{
+    DRESULT res;
+
+    if (pdrv != SIM_PDRV)
+        return(RES_NOTRDY);
+    vDiskWrites[pdrv]++;
+    MTP_TRACE_ENTER(TRACE_DISK_WRITE, (pdrv << 24) | count, sector);
+    res = disk_cache_write(pdrv, buff, sector, count);
+    MTP_TRACE_EXIT(TRACE_DISK_WRITE, res, sector);
+    return(res);
+}
+
+
+DWORD
+disk_writes(BYTE pdrv)
+{
+    return(vDiskWrites[pdrv]);
+}
+#endif
+
+
+#if _USE_IOCTL == 1
+DRESULT
+disk_ioctl(BYTE pdrv, BYTE cmd, void* buff)
+{
+    DRESULT res;
+
+    if (pdrv != SIM_PDRV)
+        return(RES_NOTRDY);
+    if (cmd == CTRL_SYNC)
+    {
+        if (res = disk_cache_sync(pdrv), res != RES_OK)
+            return(res);
+    }
+    else if ((cmd == CTRL_TRIM) || (cmd == SECTOR_ERASE))
+        disk_cache_discard(pdrv, ((DWORD*)buff)[0], ((DWORD*)buff)[1]);
+    else if (cmd == DISK_ERASE)
+        disk_cache_discard(pdrv, 0, 0xFFFFFFFF);
+    return(SIM_DRIVER.disk_ioctl(cmd, buff));
+}
+#endif
+
+
+FATFS*
+disk_volume(int index)
+{
+    if ((index != 0) || (vFatFs.fs_type == 0))
+        return(NULL);
+    return(&vFatFs);
+}
+
+
+DWORD
+get_fattime(void)
+{
+    time_t t = time(NULL);
+    struct tm* pTm = localtime(&t);
+
+    return(((DWORD)(pTm->tm_year - 80) << 25) | ((DWORD)(pTm->tm_mon + 1) << 21) | ((DWORD)pTm->tm_mday << 16) |
+           ((DWORD)pTm->tm_hour << 11) | ((DWORD)pTm->tm_min << 5) | ((DWORD)pTm->tm_sec >> 1));
+}
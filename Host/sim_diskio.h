@@ -0,0 +1,39 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      sim_diskio.h
+ \brief     FatFs disk layer of the host build without VFS
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ When the VFS sources are not part of the build, sim_diskio.c stands in for
+ the FatFs half of vfs_conf.c: one volume, "SD:", on the file backed disk,
+ or "SPI:" on the flash translation layer when built with SIM_NOR.
+****************************************************************************/
+
+#ifndef _SIM_DISKIO_H
+#define _SIM_DISKIO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include "ff.h"
+
+
+FRESULT  sim_diskio_mount(bool format);
+void     sim_diskio_unmount(void);
+FATFS*   sim_diskio_fs(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*_SIM_DISKIO_H */
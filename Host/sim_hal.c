@@ -0,0 +1,50 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      sim_hal.c
+ \brief     HAL services for the host build
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ The tick runs off the monotonic clock, HAL_Delay() sleeps.
+****************************************************************************/
+
+#include "main.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+
+uint32_t vSimUid[3] = {0x00420032, 0x4E465711, 0x20313236};
+
+
+uint32_t
+HAL_GetTick(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return((uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000));
+}
+
+
+void
+HAL_Delay(uint32_t Delay)
+{
+    struct timespec ts = {Delay / 1000, (Delay % 1000) * 1000000L};
+
+    nanosleep(&ts, NULL);
+}
+
+
+void
+Error_Handler(void)
+{
+    fprintf(stderr, "Error_Handler\n");
+    abort();
+}
@@ -0,0 +1,268 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      sim_nor.c
+ \brief     Simulated octal NOR for the host build
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ Programming only clears bits and erases set a block to 0xFF, as on the
+ real part, so a flash translation layer or file system that relies on
+ overwriting fails here as it would on the board. Transfers must be of an
+ even length at an even address (DTR), indirect access is refused while the
+ window is mapped and reading while an erase runs is an error.
+
+ The device clock advances with every operation. An erase returns at once,
+ BSP_OSPI_NOR_GetStatus() reports busy until the clock passes its end, an
+ operation started earlier waits for it. A suspended erase keeps the time
+ it has left, reads outside its block are allowed until it is resumed.
+****************************************************************************/
+
+#include "sim_nor.h"
+#include "stm32l562e_discovery_ospi.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+SimNorStats_t vSimNorStats;
+
+static uint8_t* pNor;
+static bool vMapped;
+static uint64_t vReady;     // Device time at which the running erase ends
+static uint64_t vLeft;      // Time left of a suspended erase, 0 when none is
+static uint32_t vEraseAddr;
+static uint32_t vEraseSize;
+
+
+static void
+Wait(void)
+{
+    if (vSimNorStats.device_ns < vReady)
+        vSimNorStats.device_ns = vReady;
+}
+
+
+static bool
+Valid(uint32_t addr, uint32_t len)
+{
+    return((pNor != NULL) && !vMapped && ((addr | len) % 2 == 0) && (addr < SIM_NOR_SIZE) && (len <= SIM_NOR_SIZE - addr));
+}
+
+
+// Reading the block of a suspended erase gives undefined data
+static bool
+Suspended(uint32_t addr, uint32_t len)
+{
+    return((vLeft > 0) && (addr < vEraseAddr + vEraseSize) && (addr + len > vEraseAddr));
+}
+
+
+/*! Allocate the flash, erased. Returns 0 or -1.
+ */
+int
+sim_nor_open(void)
+{
+    if (pNor == NULL)
+        pNor = malloc(SIM_NOR_SIZE);
+    if (pNor == NULL)
+        return(-1);
+    memset(pNor, 0xFF, SIM_NOR_SIZE);
+    vMapped = false;
+    vReady = 0;
+    vLeft = 0;
+    memset(&vSimNorStats, 0, sizeof(vSimNorStats));
+    return(0);
+}
+
+
+void
+sim_nor_close(void)
+{
+    free(pNor);
+    pNor = NULL;
+}
+
+
+void
+sim_nor_reset_stats(void)
+{
+    vReady = (vReady > vSimNorStats.device_ns) ? vReady - vSimNorStats.device_ns : 0;
+    memset(&vSimNorStats, 0, sizeof(vSimNorStats));
+}
+
+
+void
+sim_nor_map_read(void* dst, uint32_t addr, uint32_t len)
+{
+    if (!vMapped || (vSimNorStats.device_ns < vReady) || (addr >= SIM_NOR_SIZE) || (len > SIM_NOR_SIZE - addr) || Suspended(addr, len))
+    {
+        fprintf(stderr, "sim_nor: bad window read at 0x%08X\n", addr);
+        abort();
+    }
+    memcpy(dst, pNor + addr, len);
+    vSimNorStats.map_bytes += len;
+    vSimNorStats.device_ns += len * SIM_NOR_BYTE_NS;
+}
+
+
+int32_t
+BSP_OSPI_NOR_Init(uint32_t Instance, BSP_OSPI_NOR_Init_t* Init)
+{
+    return((pNor != NULL) ? BSP_ERROR_NONE : BSP_ERROR_COMPONENT_FAILURE);
+}
+
+
+int32_t
+BSP_OSPI_NOR_Read(uint32_t Instance, uint8_t* pData, uint32_t ReadAddr, uint32_t Size)
+{
+    if (!Valid(ReadAddr, Size) || (vSimNorStats.device_ns < vReady) || Suspended(ReadAddr, Size))
+        return(BSP_ERROR_COMPONENT_FAILURE);
+    memcpy(pData, pNor + ReadAddr, Size);
+    vSimNorStats.read_calls++;
+    vSimNorStats.read_bytes += Size;
+    vSimNorStats.device_ns += SIM_NOR_CMD_NS + Size * SIM_NOR_BYTE_NS;
+    return(BSP_ERROR_NONE);
+}
+
+
+// Page by page as the BSP does, each page waits for its program to end
+int32_t
+BSP_OSPI_NOR_Write(uint32_t Instance, uint8_t* pData, uint32_t WriteAddr, uint32_t Size)
+{
+    if (!Valid(WriteAddr, Size) || (vLeft > 0))
+        return(BSP_ERROR_COMPONENT_FAILURE);
+    Wait();
+    vSimNorStats.prog_calls++;
+    vSimNorStats.prog_bytes += Size;
+    while (Size > 0)
+    {
+        uint32_t len = SIM_NOR_PAGE - WriteAddr % SIM_NOR_PAGE;
+
+        if (len > Size)
+            len = Size;
+        for (uint32_t i = 0; i < len; i++)
+            pNor[WriteAddr + i] &= pData[i];
+        vSimNorStats.prog_pages++;
+        vSimNorStats.device_ns += SIM_NOR_CMD_NS + len * SIM_NOR_BYTE_NS + SIM_NOR_PROG_NS;
+        WriteAddr += len;
+        pData += len;
+        Size -= len;
+    }
+    return(BSP_ERROR_NONE);
+}
+
+
+int32_t
+BSP_OSPI_NOR_Erase_Block(uint32_t Instance, uint32_t BlockAddress, BSP_OSPI_NOR_Erase_t BlockSize)
+{
+    uint32_t size = (BlockSize == BSP_OSPI_NOR_ERASE_4K) ? 4096 : 65536;
+
+    if (!Valid(BlockAddress, 2) || (BlockSize == BSP_OSPI_NOR_ERASE_CHIP) || (vLeft > 0))
+        return(BSP_ERROR_COMPONENT_FAILURE);
+    Wait();
+    BlockAddress &= ~(size - 1);
+    memset(pNor + BlockAddress, 0xFF, size);
+    vEraseAddr = BlockAddress;
+    vEraseSize = size;
+    vSimNorStats.device_ns += SIM_NOR_CMD_NS;
+    if (size == 4096)
+    {
+        vSimNorStats.erases_4k++;
+        vReady = vSimNorStats.device_ns + SIM_NOR_ERASE_4K_NS;
+    }
+    else
+    {
+        vSimNorStats.erases_64k++;
+        vReady = vSimNorStats.device_ns + SIM_NOR_ERASE_64K_NS;
+    }
+    return(BSP_ERROR_NONE);
+}
+
+
+int32_t
+BSP_OSPI_NOR_GetStatus(uint32_t Instance)
+{
+    if (vMapped)
+        return(BSP_ERROR_COMPONENT_FAILURE);
+    vSimNorStats.device_ns += SIM_NOR_CMD_NS;
+    if (vLeft > 0)
+        return(BSP_ERROR_OSPI_SUSPENDED);
+    if (vSimNorStats.device_ns < vReady)
+        return(BSP_ERROR_BUSY);
+    return(BSP_ERROR_NONE);
+}
+
+
+int32_t
+BSP_OSPI_NOR_GetInfo(uint32_t Instance, BSP_OSPI_NOR_Info_t* pInfo)
+{
+    pInfo->FlashSize = SIM_NOR_SIZE;
+    pInfo->EraseSectorSize = 65536;
+    pInfo->EraseSectorsNumber = SIM_NOR_SIZE / 65536;
+    pInfo->EraseSubSectorSize = 4096;
+    pInfo->EraseSubSectorNumber = SIM_NOR_SIZE / 4096;
+    pInfo->EraseSubSector1Size = 4096;
+    pInfo->EraseSubSector1Number = SIM_NOR_SIZE / 4096;
+    pInfo->ProgPageSize = SIM_NOR_PAGE;
+    pInfo->ProgPagesNumber = SIM_NOR_SIZE / SIM_NOR_PAGE;
+    return(BSP_ERROR_NONE);
+}
+
+
+int32_t
+BSP_OSPI_NOR_EnableMemoryMappedMode(uint32_t Instance)
+{
+    if (vMapped)
+        return(BSP_ERROR_NONE);
+    vMapped = true;
+    vSimNorStats.map_switches++;
+    vSimNorStats.device_ns += SIM_NOR_CMD_NS;
+    return(BSP_ERROR_NONE);
+}
+
+
+int32_t
+BSP_OSPI_NOR_DisableMemoryMappedMode(uint32_t Instance)
+{
+    if (!vMapped)
+        return(BSP_ERROR_OSPI_MMP_UNLOCK_FAILURE);
+    vMapped = false;
+    vSimNorStats.map_switches++;
+    vSimNorStats.device_ns += SIM_NOR_CMD_NS;
+    return(BSP_ERROR_NONE);
+}
+
+
+int32_t
+BSP_OSPI_NOR_SuspendErase(uint32_t Instance)
+{
+    if (vMapped || (vLeft > 0))
+        return(BSP_ERROR_COMPONENT_FAILURE);
+    vSimNorStats.device_ns += SIM_NOR_CMD_NS;
+    if (vSimNorStats.device_ns >= vReady)
+        return(BSP_ERROR_COMPONENT_FAILURE);
+    vLeft = vReady - vSimNorStats.device_ns;
+    vSimNorStats.device_ns += SIM_NOR_SUSPEND_NS;
+    vReady = 0;
+    vSimNorStats.suspends++;
+    return(BSP_ERROR_NONE);
+}
+
+
+int32_t
+BSP_OSPI_NOR_ResumeErase(uint32_t Instance)
+{
+    if (vMapped || (vLeft == 0))
+        return(BSP_ERROR_COMPONENT_FAILURE);
+    vSimNorStats.device_ns += SIM_NOR_CMD_NS;
+    vReady = vSimNorStats.device_ns + vLeft;
+    vLeft = 0;
+    return(BSP_ERROR_NONE);
+}
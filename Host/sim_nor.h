@@ -0,0 +1,68 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      sim_nor.h
+ \brief     Simulated octal NOR for the host build
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ The BSP_OSPI_NOR_* calls of the MX25LM51245G on a 64 MB array in RAM,
+ with NOR semantics and a model of the device time each operation takes.
+****************************************************************************/
+
+#ifndef _SIM_NOR_H
+#define _SIM_NOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+
+#define SIM_NOR_SIZE            (64U * 1024 * 1024)
+#define SIM_NOR_PAGE            256U
+
+// Typical timing of the MX25LM51245G, OCTOSPI at 40 MHz DTR
+#define SIM_NOR_PROG_NS         150000ULL   // Page program
+#define SIM_NOR_ERASE_4K_NS     25000000ULL
+#define SIM_NOR_ERASE_64K_NS    220000000ULL
+#define SIM_NOR_BYTE_NS         13ULL       // 80 MB/s
+#define SIM_NOR_CMD_NS          500ULL      // Command, address and dummy cycles
+#define SIM_NOR_SUSPEND_NS      20000ULL    // Erase suspend latency
+
+
+typedef struct
+{
+    uint32_t    read_calls;     // Indirect reads
+    uint64_t    read_bytes;
+    uint64_t    map_bytes;      // Reads of the memory mapped window
+    uint32_t    prog_calls;
+    uint64_t    prog_bytes;
+    uint32_t    prog_pages;
+    uint32_t    erases_4k;
+    uint32_t    erases_64k;
+    uint32_t    map_switches;   // Changes between memory mapped and indirect mode
+    uint32_t    suspends;       // Erases suspended
+    uint64_t    device_ns;      // Modelled time of all of the above
+} SimNorStats_t;
+
+
+extern SimNorStats_t vSimNorStats;
+
+
+int      sim_nor_open(void);
+void     sim_nor_close(void);
+void     sim_nor_reset_stats(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*_SIM_NOR_H */
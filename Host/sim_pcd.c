@@ -0,0 +1,395 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      sim_pcd.c
+ \brief     Simulated USB device controller for the host build
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ Each endpoint holds the buffer the device core last handed to
+ USBD_LL_Transmit or USBD_LL_PrepareReceive. The host calls copy data
+ straight between that buffer and their own, packet by packet so a short
+ packet ends an OUT transfer as it does on the bus, and raise the DataIn or
+ DataOut stage where the HAL raises its completion callback. As with the
+ HAL, endpoint 0 completes every packet, bulk endpoints the whole transfer.
+****************************************************************************/
+
+#include "sim_pcd.h"
+#include "usbd_core.h"
+#include "mtp_trace.h"
+#include <stdlib.h>
+#include <string.h>
+
+
+#ifndef MIN
+#define MIN(a, b)   (((a) < (b)) ? (a) : (b))
+#endif
+
+
+typedef struct
+{
+    uint8_t*    buf;
+    uint32_t    len;
+    uint32_t    done;
+    uint16_t    mps;
+    uint8_t     type;
+    bool        open;
+    bool        armed;
+    bool        stall;
+} SimEp_t;
+
+
+SimPcdStats_t vSimPcdStats;
+
+static USBD_HandleTypeDef* pDev;
+static SimEp_t vIn[SIM_PCD_ENDPOINTS];
+static SimEp_t vOut[SIM_PCD_ENDPOINTS];
+static uint32_t vRxSize[SIM_PCD_ENDPOINTS];
+static uint8_t vAddress;
+
+
+static SimEp_t*
+Ep(uint8_t ep_addr)
+{
+    return((ep_addr & 0x80U) ? &vIn[ep_addr & 0x7FU] : &vOut[ep_addr & 0x7FU]);
+}
+
+
+/*! Plug in: bus reset at full speed, which opens endpoint 0.
+ */
+void
+sim_pcd_attach(void)
+{
+    USBD_LL_SetSpeed(pDev, USBD_SPEED_FULL);
+    USBD_LL_Reset(pDev);
+}
+
+
+void
+sim_pcd_reset_stats(void)
+{
+    vSimPcdStats = (SimPcdStats_t){0};
+}
+
+
+/*! Run a control transfer. Returns the length of the data stage or
+ * SIM_PCD_STALL when the device rejects the request.
+ */
+int32_t
+sim_pcd_control(const USBD_SetupReqTypedef* req, void* data)
+{
+    uint8_t setup[8] = {req->bmRequest, req->bRequest, LOBYTE(req->wValue), HIBYTE(req->wValue),
+                        LOBYTE(req->wIndex), HIBYTE(req->wIndex), LOBYTE(req->wLength), HIBYTE(req->wLength)};
+    uint8_t* p = (uint8_t*)data;
+    uint32_t total = 0;
+    int32_t n;
+
+    // A SETUP packet clears a protocol stall and whatever was pending on endpoint 0
+    vIn[0].stall = vOut[0].stall = false;
+    vIn[0].armed = vOut[0].armed = false;
+    vSimPcdStats.setups++;
+    vSimPcdStats.packets++;
+    MTP_TRACE_ENTER(TRACE_USB_SETUP, setup[0] | (setup[1] << 8), 0);
+    USBD_LL_SetupStage(pDev, setup);
+    MTP_TRACE_EXIT(TRACE_USB_SETUP, 0, 0);
+
+    if ((req->bmRequest & 0x80U) && (req->wLength > 0))
+    {
+        while (total < req->wLength)
+        {
+            if (n = sim_pcd_in(0x80, p + total, req->wLength - total), n < 0)
+                return(SIM_PCD_STALL);
+            total += n;
+            if (n < vIn[0].mps)
+                break;
+        }
+        sim_pcd_out(0x00, NULL, 0);
+        return(total);
+    }
+
+    if ((req->wLength > 0) && (sim_pcd_out(0x00, data, req->wLength) < req->wLength))
+        return(SIM_PCD_STALL);
+    if (sim_pcd_in(0x80, NULL, 0) < 0)
+        return(SIM_PCD_STALL);
+    return(req->wLength);
+}
+
+
+/*! Read from IN endpoint 'ep_addr' into 'data', at most 'max' bytes.
+ * Returns the number of bytes, SIM_PCD_NAK when the device has not queued
+ * anything or SIM_PCD_STALL.
+ */
+int32_t
+sim_pcd_in(uint8_t ep_addr, void* data, uint32_t max)
+{
+    SimEp_t* e = &vIn[ep_addr & 0x7FU];
+    uint32_t n;
+
+    if (e->stall)
+        return(SIM_PCD_STALL);
+    if (!e->armed)
+        return(SIM_PCD_NAK);
+
+    n = e->len - e->done;
+    if ((ep_addr & 0x7FU) == 0)
+        n = MIN(n, e->mps);
+    n = MIN(n, max);
+    if (n > 0)
+        memcpy(data, e->buf + e->done, n);
+    e->done += n;
+    vSimPcdStats.in_bytes += n;
+    vSimPcdStats.packets += (n + e->mps - 1) / e->mps + (n == 0);
+
+    if (((ep_addr & 0x7FU) == 0) || (e->done >= e->len))
+    {
+        e->armed = false;
+        MTP_TRACE_ENTER(TRACE_USB_DATAIN, ep_addr & 0x7FU, e->done);
+        USBD_LL_DataInStage(pDev, ep_addr & 0x7FU, e->buf + e->done);
+        MTP_TRACE_EXIT(TRACE_USB_DATAIN, ep_addr & 0x7FU, 0);
+    }
+    return(n);
+}
+
+
+/*! Send 'len' bytes to OUT endpoint 'ep_addr', a zero length packet when
+ * 'len' is 0. A transfer ends when the receive buffer is full or with a
+ * short packet, after which the device has to arm the endpoint again.
+ * Returns the number of bytes taken, which is less than 'len' when the
+ * device stopped receiving, or SIM_PCD_STALL.
+ */
+int32_t
+sim_pcd_out(uint8_t ep_addr, const void* data, uint32_t len)
+{
+    const uint8_t* p = (const uint8_t*)data;
+    SimEp_t* e = &vOut[ep_addr & 0x7FU];
+    uint32_t total = 0;
+
+    do
+    {
+        uint32_t n;
+
+        if (e->stall)
+            return(SIM_PCD_STALL);
+        if (!e->armed)
+            break;
+
+        n = MIN(MIN(len - total, e->mps), e->len - e->done);
+        if (n > 0)
+            memcpy(e->buf + e->done, p + total, n);
+        e->done += n;
+        total += n;
+        vSimPcdStats.out_bytes += n;
+        vSimPcdStats.packets++;
+
+        if (((ep_addr & 0x7FU) == 0) || (n < e->mps) || (e->done >= e->len))
+        {
+            e->armed = false;
+            vRxSize[ep_addr & 0x7FU] = e->done;
+            MTP_TRACE_ENTER(TRACE_USB_DATAOUT, ep_addr & 0x7FU, e->done);
+            USBD_LL_DataOutStage(pDev, ep_addr & 0x7FU, e->buf + e->done);
+            MTP_TRACE_EXIT(TRACE_USB_DATAOUT, ep_addr & 0x7FU, 0);
+        }
+    } while (total < len);
+    return(total);
+}
+
+
+bool
+sim_pcd_armed(uint8_t ep_addr)
+{
+    return(Ep(ep_addr)->armed);
+}
+
+
+/*! Called by the host side while it waits for the device, for work the
+ * target does outside the USB interrupt.
+ */
+__weak void
+sim_pcd_idle(void)
+{
+}
+
+
+USBD_StatusTypeDef
+USBD_LL_Init(USBD_HandleTypeDef* pdev)
+{
+    pDev = pdev;
+    memset(vIn, 0, sizeof(vIn));
+    memset(vOut, 0, sizeof(vOut));
+    return(USBD_OK);
+}
+
+
+USBD_StatusTypeDef
+USBD_LL_DeInit(USBD_HandleTypeDef* pdev)
+{
+    UNUSED(pdev);
+    return(USBD_OK);
+}
+
+
+USBD_StatusTypeDef
+USBD_LL_Start(USBD_HandleTypeDef* pdev)
+{
+    UNUSED(pdev);
+    return(USBD_OK);
+}
+
+
+USBD_StatusTypeDef
+USBD_LL_Stop(USBD_HandleTypeDef* pdev)
+{
+    UNUSED(pdev);
+    return(USBD_OK);
+}
+
+
+USBD_StatusTypeDef
+USBD_LL_OpenEP(USBD_HandleTypeDef* pdev, uint8_t ep_addr, uint8_t ep_type, uint16_t ep_mps)
+{
+    SimEp_t* e = Ep(ep_addr);
+
+    UNUSED(pdev);
+    if ((ep_addr & 0x7FU) >= SIM_PCD_ENDPOINTS)
+        return(USBD_FAIL);
+    memset(e, 0, sizeof(*e));
+    e->mps = ep_mps;
+    e->type = ep_type;
+    e->open = true;
+    return(USBD_OK);
+}
+
+
+USBD_StatusTypeDef
+USBD_LL_CloseEP(USBD_HandleTypeDef* pdev, uint8_t ep_addr)
+{
+    UNUSED(pdev);
+    Ep(ep_addr)->open = false;
+    Ep(ep_addr)->armed = false;
+    return(USBD_OK);
+}
+
+
+USBD_StatusTypeDef
+USBD_LL_FlushEP(USBD_HandleTypeDef* pdev, uint8_t ep_addr)
+{
+    UNUSED(pdev);
+    Ep(ep_addr)->armed = false;
+    return(USBD_OK);
+}
+
+
+USBD_StatusTypeDef
+USBD_LL_StallEP(USBD_HandleTypeDef* pdev, uint8_t ep_addr)
+{
+    UNUSED(pdev);
+    Ep(ep_addr)->stall = true;
+    return(USBD_OK);
+}
+
+
+USBD_StatusTypeDef
+USBD_LL_ClearStallEP(USBD_HandleTypeDef* pdev, uint8_t ep_addr)
+{
+    UNUSED(pdev);
+    Ep(ep_addr)->stall = false;
+    return(USBD_OK);
+}
+
+
+uint8_t
+USBD_LL_IsStallEP(USBD_HandleTypeDef* pdev, uint8_t ep_addr)
+{
+    UNUSED(pdev);
+    return(Ep(ep_addr)->stall);
+}
+
+
+USBD_StatusTypeDef
+USBD_LL_SetUSBAddress(USBD_HandleTypeDef* pdev, uint8_t dev_addr)
+{
+    UNUSED(pdev);
+    vAddress = dev_addr;
+    return(USBD_OK);
+}
+
+
+USBD_StatusTypeDef
+USBD_LL_Transmit(USBD_HandleTypeDef* pdev, uint8_t ep_addr, uint8_t* pbuf, uint32_t size)
+{
+    SimEp_t* e = &vIn[ep_addr & 0x7FU];
+
+    UNUSED(pdev);
+    e->buf = pbuf;
+    e->len = size;
+    e->done = 0;
+    e->armed = true;
+    vSimPcdStats.transmits++;
+    return(USBD_OK);
+}
+
+
+USBD_StatusTypeDef
+USBD_LL_PrepareReceive(USBD_HandleTypeDef* pdev, uint8_t ep_addr, uint8_t* pbuf, uint32_t size)
+{
+    SimEp_t* e = &vOut[ep_addr & 0x7FU];
+
+    UNUSED(pdev);
+    e->buf = pbuf;
+    e->len = size;
+    e->done = 0;
+    e->armed = true;
+    vSimPcdStats.receives++;
+    return(USBD_OK);
+}
+
+
+uint32_t
+USBD_LL_GetRxDataSize(USBD_HandleTypeDef* pdev, uint8_t ep_addr)
+{
+    UNUSED(pdev);
+    return(vRxSize[ep_addr & 0x7FU]);
+}
+
+
+USBD_StatusTypeDef
+USBD_LL_SetTestMode(USBD_HandleTypeDef* pdev, uint8_t testmode)
+{
+    UNUSED(pdev);
+    UNUSED(testmode);
+    return(USBD_OK);
+}
+
+
+void
+USBD_LL_Delay(uint32_t Delay)
+{
+    HAL_Delay(Delay);
+}
+
+
+/* One block that outlives the class, as in usbd_conf.c: MSC reads still
+   complete into it after the class was deinitialized */
+void*
+USBD_static_malloc(uint32_t size)
+{
+    static void* mem;
+
+    if (mem == NULL)
+    {
+        mem = calloc(1, size);
+    }
+    return(mem);
+}
+
+
+void
+USBD_static_free(void* p)
+{
+    (void)p;
+}
@@ -0,0 +1,66 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      sim_pcd.h
+ \brief     Simulated USB device controller for the host build
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ Replaces the USBD_LL_* layer of USB_Device/Target/usbd_conf.c. The host
+ side of the bus is a set of calls that deliver SETUP, OUT and IN traffic
+ into the ST device core from the same thread, in place of the PCD
+ interrupt.
+****************************************************************************/
+
+#ifndef _SIM_PCD_H
+#define _SIM_PCD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "usbd_def.h"
+
+
+#define SIM_PCD_ENDPOINTS       8
+#define SIM_PCD_STALL           (-1)    // Endpoint is stalled
+#define SIM_PCD_NAK             (-2)    // Nothing to transfer yet
+
+
+typedef struct
+{
+    uint32_t    setups;         // SETUP packets delivered
+    uint32_t    transmits;      // USBD_LL_Transmit calls
+    uint32_t    receives;       // USBD_LL_PrepareReceive calls
+    uint32_t    packets;        // Bus packets, both directions
+    uint64_t    in_bytes;       // Copied from device buffers to the host
+    uint64_t    out_bytes;      // Copied from the host into device buffers
+} SimPcdStats_t;
+
+
+extern SimPcdStats_t vSimPcdStats;
+
+
+void     sim_pcd_attach(void);
+void     sim_pcd_reset_stats(void);
+
+int32_t  sim_pcd_control(const USBD_SetupReqTypedef* req, void* data);
+int32_t  sim_pcd_in(uint8_t ep_addr, void* data, uint32_t max);
+int32_t  sim_pcd_out(uint8_t ep_addr, const void* data, uint32_t len);
+bool     sim_pcd_armed(uint8_t ep_addr);
+
+void     sim_pcd_idle(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*_SIM_PCD_H */
@@ -0,0 +1,12 @@
+/*! \file      main.h
+ \brief     Host build stand-in for the CubeMX main.h
+****************************************************************************/
+
+#ifndef __MAIN_H
+#define __MAIN_H
+
+#include "stm32l5xx_hal.h"
+
+void Error_Handler(void);
+
+#endif /* __MAIN_H */
@@ -0,0 +1,13 @@
+/*! \file      sd_diskio.h
+ \brief     Host build stand-in for FATFS/Target/sd_diskio.h
+****************************************************************************/
+
+#ifndef __SD_DISKIO_H
+#define __SD_DISKIO_H
+
+#include "ff_gen_drv.h"
+
+// File backed SD card, see sim_disk.c
+extern const Diskio_drvTypeDef  SD_Driver;
+
+#endif /* __SD_DISKIO_H */
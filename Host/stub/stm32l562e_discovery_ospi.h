@@ -0,0 +1,63 @@
+/*! \file      stm32l562e_discovery_ospi.h
+ \brief     Host build stand-in for the OSPI NOR part of the BSP
+****************************************************************************/
+
+#ifndef STM32L562E_DISCOVERY_OSPI_H
+#define STM32L562E_DISCOVERY_OSPI_H
+
+#include <stdint.h>
+
+// Simulated MX25LM51245G, see sim_nor.c
+#define BSP_ERROR_NONE                      0
+#define BSP_ERROR_COMPONENT_FAILURE         -5
+#define BSP_ERROR_BUSY                      -3
+#define BSP_ERROR_OSPI_SUSPENDED            -20
+#define BSP_ERROR_OSPI_MMP_UNLOCK_FAILURE   -21
+
+#define BSP_OSPI_NOR_SPI_MODE               0
+#define BSP_OSPI_NOR_OPI_MODE               1
+#define BSP_OSPI_NOR_STR_TRANSFER           0
+#define BSP_OSPI_NOR_DTR_TRANSFER           1
+
+typedef enum
+{
+    BSP_OSPI_NOR_ERASE_4K,
+    BSP_OSPI_NOR_ERASE_64K,
+    BSP_OSPI_NOR_ERASE_CHIP
+} BSP_OSPI_NOR_Erase_t;
+
+typedef struct
+{
+    uint32_t InterfaceMode;
+    uint32_t TransferRate;
+} BSP_OSPI_NOR_Init_t;
+
+typedef struct
+{
+    uint32_t FlashSize;
+    uint32_t EraseSectorSize;
+    uint32_t EraseSectorsNumber;
+    uint32_t EraseSubSectorSize;
+    uint32_t EraseSubSectorNumber;
+    uint32_t EraseSubSector1Size;
+    uint32_t EraseSubSector1Number;
+    uint32_t ProgPageSize;
+    uint32_t ProgPagesNumber;
+} BSP_OSPI_NOR_Info_t;
+
+int32_t BSP_OSPI_NOR_Init(uint32_t Instance, BSP_OSPI_NOR_Init_t* Init);
+int32_t BSP_OSPI_NOR_Read(uint32_t Instance, uint8_t* pData, uint32_t ReadAddr, uint32_t Size);
+int32_t BSP_OSPI_NOR_Write(uint32_t Instance, uint8_t* pData, uint32_t WriteAddr, uint32_t Size);
+int32_t BSP_OSPI_NOR_Erase_Block(uint32_t Instance, uint32_t BlockAddress, BSP_OSPI_NOR_Erase_t BlockSize);
+int32_t BSP_OSPI_NOR_GetStatus(uint32_t Instance);
+int32_t BSP_OSPI_NOR_GetInfo(uint32_t Instance, BSP_OSPI_NOR_Info_t* pInfo);
+int32_t BSP_OSPI_NOR_EnableMemoryMappedMode(uint32_t Instance);
+int32_t BSP_OSPI_NOR_DisableMemoryMappedMode(uint32_t Instance);
+int32_t BSP_OSPI_NOR_SuspendErase(uint32_t Instance);
+int32_t BSP_OSPI_NOR_ResumeErase(uint32_t Instance);
+
+// Reads of the memory mapped window
+void    sim_nor_map_read(void* dst, uint32_t addr, uint32_t len);
+#define NOR_MAP_READ(dst, addr, len)    sim_nor_map_read((dst), (addr), (len))
+
+#endif /* STM32L562E_DISCOVERY_OSPI_H */
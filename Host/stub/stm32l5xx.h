@@ -0,0 +1,36 @@
+/*! \file      stm32l5xx.h
+ \brief     Host build stand-in for the CMSIS device header
+****************************************************************************/
+
+#ifndef __STM32L5xx_H
+#define __STM32L5xx_H
+
+#include <stdint.h>
+
+// CMSIS compiler macros
+#define __IO            volatile
+#define __weak          __attribute__((weak))
+#define __PACKED        __attribute__((packed))
+#define __STATIC_INLINE static inline
+#define __ALIGN_BEGIN
+#define __ALIGN_END     __attribute__((aligned(4)))
+
+#ifndef UNUSED
+#define UNUSED(x)       ((void)(x))
+#endif
+
+// No interrupts on the host, everything runs from the simulation loop
+#define __disable_irq()
+#define __enable_irq()
+#define __get_PRIMASK() 0U
+#define __set_PRIMASK(x) ((void)(x))
+#define __WFI()
+#define NVIC_GetEnableIRQ(irq)  0U
+#define NVIC_EnableIRQ(irq)
+#define NVIC_DisableIRQ(irq)
+
+// Device unique ID, read by usbd_desc.c for the serial number
+extern uint32_t vSimUid[3];
+#define UID_BASE        ((uintptr_t)vSimUid)
+
+#endif /* __STM32L5xx_H */
@@ -0,0 +1,25 @@
+/*! \file      stm32l5xx_hal.h
+ \brief     Host build stand-in for the HAL
+****************************************************************************/
+
+#ifndef __STM32L5xx_HAL_H
+#define __STM32L5xx_HAL_H
+
+#include "stm32l5xx.h"
+
+typedef enum
+{
+    HAL_OK       = 0x00U,
+    HAL_ERROR    = 0x01U,
+    HAL_BUSY     = 0x02U,
+    HAL_TIMEOUT  = 0x03U
+} HAL_StatusTypeDef;
+
+uint32_t HAL_GetTick(void);
+void     HAL_Delay(uint32_t Delay);
+
+// No interrupts on the host
+#define HAL_NVIC_DisableIRQ(irq)
+#define HAL_NVIC_EnableIRQ(irq)
+
+#endif /* __STM32L5xx_HAL_H */
@@ -0,0 +1,43 @@
+/*! \file      usbd_conf.h
+ \brief     Host build stand-in for USB_Device/Target/usbd_conf.h
+****************************************************************************/
+
+#ifndef __USBD_CONF__H__
+#define __USBD_CONF__H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stm32l5xx.h"
+#include "stm32l5xx_hal.h"
+
+// Keep in line with USB_Device/Target/usbd_conf.h
+#define USBD_MAX_NUM_INTERFACES     1U
+#define USBD_MAX_NUM_CONFIGURATION  1U
+#define USBD_MAX_STR_DESC_SIZ       512U
+#define USBD_DEBUG_LEVEL            0U
+#define USBD_LPM_ENABLED            1U
+#define USBD_SELF_POWERED           1U
+#define MSC_MEDIA_PACKET            512U
+#define MSC_STAGE_SIZE              16384U
+#define MSC_WRITE_WINDOW            16384U
+#ifndef MTP_MEDIA_PACKET
+#define MTP_MEDIA_PACKET            8192U
+#endif
+
+#define DEVICE_FS                   0
+
+#define USBD_malloc         (void *)USBD_static_malloc
+#define USBD_free           USBD_static_free
+#define USBD_memset         memset
+#define USBD_memcpy         memcpy
+#define USBD_Delay          HAL_Delay
+
+#define USBD_UsrLog(...)
+#define USBD_ErrLog(...)
+#define USBD_DbgLog(...)
+
+void *USBD_static_malloc(uint32_t size);
+void USBD_static_free(void *p);
+
+#endif /* __USBD_CONF__H__ */
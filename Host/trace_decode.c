@@ -0,0 +1,167 @@
+/*  __      __ _   _  _  _____  ____   ____  ____  ____   ___   ___  ___
+    \ \_/\_/ /| |_| || ||_   _|| ___| | __ \| __ \| ___| / _ \ |   \/   |
+     \      / |  _  || |  | |  | __|  | __ <|    /| __| |  _  || |\  /| |
+      \_/\_/  |_| |_||_|  |_|  |____| |____/|_|\_\|____||_| |_||_| \/ |_|
+*/
+/*! \copyright Copyright (c) 2026, White Bream, https://whitebream.nl
+*************************************************************************//*!
+ \file      trace_decode.c
+ \brief     Timeline decoder for MTP_OC_WB_GetTrace dumps
+ \version   1.0.0.0
+ \since     October 16, 2026
+ \date      October 16, 2026
+
+ Reads a trace dump, as returned in the data phase of MTP_OC_WB_GetTrace
+ or written by 'bench -t', and prints per PTP transaction where the time
+ went: the stages nested in it with their count and total duration. With
+ -v every event is listed, indented by nesting depth.
+
+ Usage: trace_decode [-v] dump
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mtp_trace.h"
+
+
+#define DEPTH       16
+#define STAGES      (TRACE_SD_DONE + 1)
+
+
+typedef struct
+{
+    uint16_t    id;
+    uint32_t    stamp;
+    uint32_t    a0;
+    uint32_t    a1;
+} Open_t;
+
+typedef struct
+{
+    uint32_t    count;
+    uint64_t    ticks;
+} Stage_t;
+
+
+static const char* vNames[STAGES] =
+{
+    "?", "USB setup", "USB data in", "USB data out", "PTP opcode",
+    "ring fill", "ring drain", "disk read", "disk write", "SD done",
+};
+
+static double vUsPerTick;
+static int vVerbose;
+
+
+static const char*
+Name(uint16_t id)
+{
+    static char buf[16];
+
+    if (id < STAGES)
+        return(vNames[id]);
+    snprintf(buf, sizeof(buf), "user %u", id - TRACE_USER);
+    return(buf);
+}
+
+
+static void
+Report(const Open_t* op, uint32_t end, const Stage_t* stages)
+{
+    printf("%6u  op 0x%04X  %10.1f us\n", op->a1, op->a0, (uint32_t)(end - op->stamp) * vUsPerTick);
+    for (int i = 1; i < STAGES; i++)
+    {
+        if ((i == TRACE_PTP_OPCODE) || (stages[i].count == 0))
+            continue;
+        printf("        %-14s %6u x %10.1f us\n", vNames[i], stages[i].count, stages[i].ticks * vUsPerTick);
+    }
+}
+
+
+int
+main(int argc, char* argv[])
+{
+    MtpTraceHeader_t hdr;
+    MtpTraceEvent_t ev;
+    Open_t stack[DEPTH], op = {0};
+    Stage_t stages[STAGES];
+    uint32_t first = 0, depth = 0, n = 0;
+    bool in_op = false;
+    FILE* f;
+
+    if ((argc > 2) && (strcmp(argv[1], "-v") == 0))
+    {
+        vVerbose = 1;
+        argv++;
+        argc--;
+    }
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: trace_decode [-v] dump\n");
+        return(2);
+    }
+    if ((f = fopen(argv[1], "rb")) == NULL)
+    {
+        perror(argv[1]);
+        return(1);
+    }
+    if ((fread(&hdr, sizeof(hdr), 1, f) != 1) || (hdr.magic != MTP_TRACE_MAGIC) || (hdr.size != sizeof(ev)) || (hdr.hz == 0))
+    {
+        fprintf(stderr, "%s: not a trace dump\n", argv[1]);
+        return(1);
+    }
+    vUsPerTick = 1e6 / hdr.hz;
+    printf("%u events at %u Hz, %u lost before the dump\n", hdr.count, hdr.hz, hdr.lost);
+    memset(stages, 0, sizeof(stages));
+
+    while (fread(&ev, sizeof(ev), 1, f) == 1)
+    {
+        uint16_t id = ev.id & ~MTP_TRACE_EXIT_FLAG;
+
+        if (n++ == 0)
+            first = ev.stamp;
+        if (vVerbose)
+            printf("%12.1f %*s%s %s %08X %08X\n", (uint32_t)(ev.stamp - first) * vUsPerTick, (int)depth * 2, "",
+                   (ev.id & MTP_TRACE_EXIT_FLAG) ? "<" : ">", Name(id), ev.a0, ev.a1);
+
+        if (!(ev.id & MTP_TRACE_EXIT_FLAG))
+        {
+            if (id == TRACE_PTP_OPCODE)
+            {
+                op = (Open_t){id, ev.stamp, ev.a0, ev.a1};
+                memset(stages, 0, sizeof(stages));
+                in_op = true;
+                depth = 0;
+            }
+            else if (id == TRACE_SD_DONE)
+                stages[id].count++;
+            else if (depth < DEPTH)
+                stack[depth++] = (Open_t){id, ev.stamp, ev.a0, ev.a1};
+            continue;
+        }
+
+        if (id == TRACE_PTP_OPCODE)
+        {
+            if (in_op)
+                Report(&op, ev.stamp, stages);
+            in_op = false;
+            depth = 0;
+            continue;
+        }
+
+        // Match the exit with its entry, entries whose exit was lost are dropped
+        while ((depth > 0) && (stack[depth - 1].id != id))
+            depth--;
+        if (depth == 0)
+            continue;
+        depth--;
+        if (id < STAGES)
+        {
+            stages[id].count++;
+            stages[id].ticks += (uint32_t)(ev.stamp - stack[depth].stamp);
+        }
+    }
+    fclose(f);
+    return(0);
+}
@@ -47,6 +47,28 @@ extern "C" {
 #define MSC_MEDIA_PACKET             512U
 #endif /* MSC_MEDIA_PACKET */
 
+/* READ(10)/(12) staging area, 0 reads synchronously through bot_data. Free
+   chunks that follow each other in memory are read as one request, so a
+   READ of up to MSC_STAGE_SIZE bytes is a single multi-block card read */
+#ifndef MSC_STAGE_SIZE
+#define MSC_STAGE_SIZE               0U
+#endif /* MSC_STAGE_SIZE */
+
+#ifndef MSC_STAGE_CHUNKS
+#define MSC_STAGE_CHUNKS             2U
+#endif /* MSC_STAGE_CHUNKS */
+
+#define MSC_STAGE_CHUNK              (MSC_STAGE_SIZE / MSC_STAGE_CHUNKS)
+
+/* WRITE(10)/(12) data gathered in the staging area per storage write */
+#ifndef MSC_WRITE_WINDOW
+#define MSC_WRITE_WINDOW             MSC_STAGE_SIZE
+#endif /* MSC_WRITE_WINDOW */
+
+#if (MSC_WRITE_WINDOW > MSC_STAGE_SIZE)
+#error "MSC_WRITE_WINDOW must fit in the staging area"
+#endif
+
 #define MSC_MAX_FS_PACKET            0x40U
 #define MSC_MAX_HS_PACKET            0x200U
 
@@ -69,6 +91,9 @@ extern "C" {
 /** @defgroup USB_CORE_Exported_Types
   * @{
   */
+/* Completion of an asynchronous storage request, status 0 or -1 */
+typedef void (* USBD_StorageDoneTypeDef)(void *ctx, int8_t status);
+
 typedef struct _USBD_STORAGE
 {
   int8_t (* Init)(uint8_t lun);
@@ -79,6 +104,14 @@ typedef struct _USBD_STORAGE
   int8_t (* Write)(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
   int8_t (* GetMaxLun)(void);
   int8_t *pInquiry;
+  /* Optional, NULL when not supported. Returns 0 when the request was queued,
+     'done' is then called in USB interrupt context when it completes */
+  int8_t (* ReadAsync)(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len,
+                       USBD_StorageDoneTypeDef done, void *ctx);
+  /* Optional, commits written blocks to the medium */
+  int8_t (* Sync)(uint8_t lun);
+  /* Optional, the host no longer uses the blocks (SCSI UNMAP) */
+  int8_t (* Unmap)(uint8_t lun, uint32_t blk_addr, uint32_t blk_len);
 
 } USBD_StorageTypeDef;
 
@@ -104,6 +137,19 @@ typedef struct
 
   uint32_t                 scsi_blk_addr;
   uint32_t                 scsi_blk_len;
+
+#if (MSC_STAGE_SIZE > 0U)
+  uint32_t                 stage[MSC_STAGE_CHUNKS][MSC_STAGE_CHUNK / 4U];
+  uint8_t                  stage_state[MSC_STAGE_CHUNKS];
+  uint16_t                 stage_blks[MSC_STAGE_CHUNKS];
+  uint8_t                  stage_span[MSC_STAGE_CHUNKS]; /* Chunks of the request starting here */
+  uint8_t                  stage_fill;   /* Next chunk to read into */
+  uint8_t                  stage_done;   /* Next chunk to complete */
+  uint8_t                  stage_send;   /* Next chunk to transmit */
+  uint32_t                 stage_addr;   /* Next block to read */
+  uint32_t                 stage_left;   /* Blocks not yet requested */
+  USBD_HandleTypeDef       *stage_pdev;  /* Device the reads complete for */
+#endif /* MSC_STAGE_SIZE */
 } USBD_MSC_BOT_HandleTypeDef;
 
 /* Structure for MSC process */
@@ -71,6 +71,9 @@ extern "C" {
 #define SCSI_VERIFY16                               0x8FU
 
 #define SCSI_SEND_DIAGNOSTIC                        0x1DU
+#define SCSI_SYNCHRONIZE_CACHE10                    0x35U
+#define SCSI_SYNCHRONIZE_CACHE16                    0x91U
+#define SCSI_UNMAP                                  0x42U
 #define SCSI_READ_FORMAT_CAPACITIES                 0x23U
 
 #define NO_SENSE                                    0U
@@ -158,6 +161,7 @@ int8_t SCSI_ProcessCmd(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *cmd);
 
 void SCSI_SenseCode(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t sKey,
                     uint8_t ASC);
+void SCSI_StageReset(USBD_HandleTypeDef *pdev);
 
 /**
   * @}
@@ -117,6 +117,12 @@ void MSC_BOT_Init(USBD_HandleTypeDef *pdev)
   hmsc->scsi_sense_head = 0U;
   hmsc->scsi_medium_state = SCSI_MEDIUM_UNLOCKED;
 
+#if (MSC_STAGE_SIZE > 0U)
+  /* Reads of the previous configuration may still be landing in the stage */
+  hmsc->stage_pdev = pdev;
+  SCSI_StageReset(pdev);
+#endif /* MSC_STAGE_SIZE */
+
   ((USBD_StorageTypeDef *)pdev->pUserData[pdev->classId])->Init(0U);
 
   (void)USBD_LL_FlushEP(pdev, MSCOutEpAdd);
@@ -172,6 +178,9 @@ void MSC_BOT_DeInit(USBD_HandleTypeDef  *pdev)
   if (hmsc != NULL)
   {
     hmsc->bot_state = USBD_BOT_IDLE;
+#if (MSC_STAGE_SIZE > 0U)
+    SCSI_StageReset(pdev);
+#endif /* MSC_STAGE_SIZE */
   }
 }
 
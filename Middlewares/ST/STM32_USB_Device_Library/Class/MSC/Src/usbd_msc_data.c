@@ -72,7 +72,9 @@ uint8_t MSC_Page00_Inquiry_Data[LENGTH_INQUIRY_PAGE00] =
   0x00,
   (LENGTH_INQUIRY_PAGE00 - 4U),
   0x00,
-  0x80
+  0x80,
+  0xB0,
+  0xB2
 };
 
 /* USB Mass storage VPD Page 0x80 Inquiry Data for Unit Serial Number */
@@ -88,6 +90,40 @@ uint8_t MSC_Page80_Inquiry_Data[LENGTH_INQUIRY_PAGE80] =
   0x20
 };
 
+/* USB Mass storage VPD Page 0xB0 Inquiry Data for Block Limits */
+uint8_t MSC_PageB0_Inquiry_Data[LENGTH_INQUIRY_PAGEB0] =
+{
+  0x00,
+  0xB0,
+  0x00,
+  (LENGTH_INQUIRY_PAGEB0 - 4U),
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  (uint8_t)(MSC_UNMAP_MAX_BLOCKS >> 24), (uint8_t)(MSC_UNMAP_MAX_BLOCKS >> 16),
+  (uint8_t)(MSC_UNMAP_MAX_BLOCKS >> 8), (uint8_t)MSC_UNMAP_MAX_BLOCKS,   /* Maximum unmap LBA count */
+  0x00, 0x00, 0x00,         /* Maximum unmap block descriptor count */
+  (MSC_MEDIA_PACKET - 8U) / 16U,
+  0x00, 0x00, 0x00, 0x00,   /* Optimal unmap granularity, not reported */
+  0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00
+};
+
+/* USB Mass storage VPD Page 0xB2 Inquiry Data for Logical Block Provisioning */
+uint8_t MSC_PageB2_Inquiry_Data[LENGTH_INQUIRY_PAGEB2] =
+{
+  0x00,
+  0xB2,
+  0x00,
+  (LENGTH_INQUIRY_PAGEB2 - 4U),
+  0x00,
+  0x80,     /* LBPU: UNMAP supported */
+  0x00,
+  0x00
+};
+
 /* USB Mass storage sense 6 Data */
 uint8_t MSC_Mode_Sense6_data[MODE_SENSE6_LEN] =
 {
@@ -50,6 +50,16 @@ EndBSPDependencies */
 /** @defgroup MSC_SCSI_Private_Defines
   * @{
   */
+#if (MSC_STAGE_SIZE > 0U)
+/* Staging chunk states */
+#define SCSI_STAGE_FREE              0U
+#define SCSI_STAGE_READING           1U
+#define SCSI_STAGE_READY             2U
+#define SCSI_STAGE_SENDING           3U
+#define SCSI_STAGE_ERROR             4U
+#define SCSI_STAGE_ORPHAN            5U   /* Still reading for an aborted command */
+#define SCSI_STAGE_WRITING           6U   /* Gathering WRITE(10)/(12) data */
+#endif /* MSC_STAGE_SIZE */
 
 /**
   * @}
@@ -92,11 +102,22 @@ static int8_t SCSI_Write12(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *param
 static int8_t SCSI_Read10(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params);
 static int8_t SCSI_Read12(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params);
 static int8_t SCSI_Verify10(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params);
+static int8_t SCSI_SynchronizeCache(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params);
+static int8_t SCSI_Unmap(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params);
 static int8_t SCSI_CheckAddressRange(USBD_HandleTypeDef *pdev, uint8_t lun,
                                      uint32_t blk_offset, uint32_t blk_nbr);
 
 static int8_t SCSI_ProcessRead(USBD_HandleTypeDef *pdev, uint8_t lun);
 static int8_t SCSI_ProcessWrite(USBD_HandleTypeDef *pdev, uint8_t lun);
+static uint32_t SCSI_WriteWindow(USBD_MSC_BOT_HandleTypeDef *hmsc, uint8_t **buf);
+#if (MSC_STAGE_SIZE > 0U)
+static void SCSI_WriteStart(USBD_MSC_BOT_HandleTypeDef *hmsc);
+static void SCSI_StageStart(USBD_HandleTypeDef *pdev);
+static int8_t SCSI_StageProcess(USBD_HandleTypeDef *pdev, uint8_t lun);
+static void SCSI_StageRead(USBD_HandleTypeDef *pdev, uint8_t lun);
+static int8_t SCSI_StageSend(USBD_HandleTypeDef *pdev, uint8_t lun);
+static void SCSI_StageDone(void *ctx, int8_t status);
+#endif /* MSC_STAGE_SIZE */
 
 static int8_t SCSI_UpdateBotData(USBD_MSC_BOT_HandleTypeDef *hmsc,
                                  uint8_t *pBuff, uint16_t length);
@@ -190,6 +211,15 @@ int8_t SCSI_ProcessCmd(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *cmd)
       ret = SCSI_Verify10(pdev, lun, cmd);
       break;
 
+    case SCSI_SYNCHRONIZE_CACHE10:
+    case SCSI_SYNCHRONIZE_CACHE16:
+      ret = SCSI_SynchronizeCache(pdev, lun, cmd);
+      break;
+
+    case SCSI_UNMAP:
+      ret = SCSI_Unmap(pdev, lun, cmd);
+      break;
+
     default:
       SCSI_SenseCode(pdev, lun, ILLEGAL_REQUEST, INVALID_CDB);
       hmsc->bot_status = USBD_BOT_STATUS_ERROR;
@@ -280,6 +310,18 @@ static int8_t SCSI_Inquiry(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *param
     {
       (void)SCSI_UpdateBotData(hmsc, MSC_Page80_Inquiry_Data, LENGTH_INQUIRY_PAGE80);
     }
+    else if (params[2] == 0xB0U) /* Request for VPD page 0xB0 Block Limits */
+    {
+      (void)SCSI_UpdateBotData(hmsc, MSC_PageB0_Inquiry_Data, LENGTH_INQUIRY_PAGEB0);
+    }
+    else if (params[2] == 0xB2U) /* Request for VPD page 0xB2 Logical Block Provisioning */
+    {
+      (void)SCSI_UpdateBotData(hmsc, MSC_PageB2_Inquiry_Data, LENGTH_INQUIRY_PAGEB2);
+      if (((USBD_StorageTypeDef *)pdev->pUserData[pdev->classId])->Unmap == NULL)
+      {
+        hmsc->bot_data[5] = 0U;
+      }
+    }
     else /* Request Not supported */
     {
       SCSI_SenseCode(pdev, hmsc->cbw.bLUN, ILLEGAL_REQUEST,
@@ -399,6 +441,12 @@ static int8_t SCSI_ReadCapacity16(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t
   hmsc->bot_data[10] = (uint8_t)(hmsc->scsi_blk_size >>  8);
   hmsc->bot_data[11] = (uint8_t)(hmsc->scsi_blk_size);
 
+  /* LBPME: the unit is thin provisioned, blocks can be unmapped */
+  if (((USBD_StorageTypeDef *)pdev->pUserData[pdev->classId])->Unmap != NULL)
+  {
+    hmsc->bot_data[14] = 0x80U;
+  }
+
   hmsc->bot_data_length = ((uint32_t)params[10] << 24) |
                           ((uint32_t)params[11] << 16) |
                           ((uint32_t)params[12] <<  8) |
@@ -741,6 +789,9 @@ static int8_t SCSI_Read10(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params
     }
 
     hmsc->bot_state = USBD_BOT_DATA_IN;
+#if (MSC_STAGE_SIZE > 0U)
+    SCSI_StageStart(pdev);
+#endif /* MSC_STAGE_SIZE */
   }
   hmsc->bot_data_length = MSC_MEDIA_PACKET;
 
@@ -809,6 +860,9 @@ static int8_t SCSI_Read12(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params
     }
 
     hmsc->bot_state = USBD_BOT_DATA_IN;
+#if (MSC_STAGE_SIZE > 0U)
+    SCSI_StageStart(pdev);
+#endif /* MSC_STAGE_SIZE */
   }
   hmsc->bot_data_length = MSC_MEDIA_PACKET;
 
@@ -827,6 +881,7 @@ static int8_t SCSI_Write10(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *param
 {
   USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
   uint32_t len;
+  uint8_t *buf;
 
   if (hmsc == NULL)
   {
@@ -891,11 +946,14 @@ static int8_t SCSI_Write10(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *param
       return -1;
     }
 
-    len = MIN(len, MSC_MEDIA_PACKET);
+#if (MSC_STAGE_SIZE > 0U)
+    SCSI_WriteStart(hmsc);
+#endif /* MSC_STAGE_SIZE */
+    len = SCSI_WriteWindow(hmsc, &buf);
 
     /* Prepare EP to receive first data packet */
     hmsc->bot_state = USBD_BOT_DATA_OUT;
-    (void)USBD_LL_PrepareReceive(pdev, MSCOutEpAdd, hmsc->bot_data, len);
+    (void)USBD_LL_PrepareReceive(pdev, MSCOutEpAdd, buf, len);
   }
   else /* Write Process ongoing */
   {
@@ -917,6 +975,7 @@ static int8_t SCSI_Write12(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *param
 {
   USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
   uint32_t len;
+  uint8_t *buf;
 
   if (hmsc == NULL)
   {
@@ -984,11 +1043,14 @@ static int8_t SCSI_Write12(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *param
       return -1;
     }
 
-    len = MIN(len, MSC_MEDIA_PACKET);
+#if (MSC_STAGE_SIZE > 0U)
+    SCSI_WriteStart(hmsc);
+#endif /* MSC_STAGE_SIZE */
+    len = SCSI_WriteWindow(hmsc, &buf);
 
     /* Prepare EP to receive first data packet */
     hmsc->bot_state = USBD_BOT_DATA_OUT;
-    (void)USBD_LL_PrepareReceive(pdev, MSCOutEpAdd, hmsc->bot_data, len);
+    (void)USBD_LL_PrepareReceive(pdev, MSCOutEpAdd, buf, len);
   }
   else /* Write Process ongoing */
   {
@@ -1031,9 +1093,163 @@ static int8_t SCSI_Verify10(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *para
   return 0;
 }
 
+/**
+  * @brief  SCSI_SynchronizeCache
+  *         Process Synchronize Cache (10)/(16) command: the written blocks
+  *         are committed to the medium before the status goes out
+  * @param  lun: Logical unit number
+  * @param  params: Command parameters
+  * @retval status
+  */
+static int8_t SCSI_SynchronizeCache(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params)
+{
+  UNUSED(params);
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+  USBD_StorageTypeDef *fops = (USBD_StorageTypeDef *)pdev->pUserData[pdev->classId];
+
+  if (hmsc == NULL)
+  {
+    return -1;
+  }
+
+  /* case 9 : Hi > D0 */
+  if (hmsc->cbw.dDataLength != 0U)
+  {
+    SCSI_SenseCode(pdev, hmsc->cbw.bLUN, ILLEGAL_REQUEST, INVALID_CDB);
+    return -1;
+  }
+
+  if ((fops->Sync != NULL) && (fops->Sync(lun) != 0))
+  {
+    SCSI_SenseCode(pdev, lun, HARDWARE_ERROR, WRITE_FAULT);
+    hmsc->bot_state = USBD_BOT_NO_DATA;
+    return -1;
+  }
+  hmsc->bot_data_length = 0U;
+
+  return 0;
+}
+
+/**
+  * @brief  SCSI_Unmap
+  *         Process Unmap command: receives the parameter list, then passes
+  *         each block descriptor to the storage
+  * @param  lun: Logical unit number
+  * @param  params: Command parameters
+  * @retval status
+  */
+static int8_t SCSI_Unmap(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+  USBD_StorageTypeDef *fops = (USBD_StorageTypeDef *)pdev->pUserData[pdev->classId];
+  uint32_t len;
+  uint32_t blk_addr;
+  uint32_t blk_len;
+  uint32_t total = 0U;
+  uint8_t *desc;
+
+  if (hmsc == NULL)
+  {
+    return -1;
+  }
+#ifdef USE_USBD_COMPOSITE
+  /* Get the Endpoints addresses allocated for this class instance */
+  MSCOutEpAdd = USBD_CoreGetEPAdd(pdev, USBD_EP_OUT, USBD_EP_TYPE_BULK, (uint8_t)pdev->classId);
+#endif /* USE_USBD_COMPOSITE */
+
+  if (hmsc->bot_state == USBD_BOT_IDLE) /* Idle */
+  {
+    if (fops->Unmap == NULL)
+    {
+      SCSI_SenseCode(pdev, lun, ILLEGAL_REQUEST, INVALID_CDB);
+      return -1;
+    }
+
+    len = ((uint32_t)params[7] << 8) | (uint32_t)params[8];
+
+    /* cases 3,8,11,13 : Hn,Hi,Ho <> Do */
+    if ((hmsc->cbw.dDataLength != len) || (len > MSC_MEDIA_PACKET) ||
+        ((len != 0U) && ((hmsc->cbw.bmFlags & 0x80U) == 0x80U)))
+    {
+      SCSI_SenseCode(pdev, hmsc->cbw.bLUN, ILLEGAL_REQUEST, INVALID_CDB);
+      return -1;
+    }
+
+    if (len == 0U)
+    {
+      hmsc->bot_data_length = 0U;
+      return 0;
+    }
+
+    /* Prepare EP to receive the parameter list */
+    hmsc->bot_state = USBD_BOT_DATA_OUT;
+    (void)USBD_LL_PrepareReceive(pdev, MSCOutEpAdd, hmsc->bot_data, len);
+
+    return 0;
+  }
+
+  /* Parameter list received */
+  len = hmsc->cbw.dDataLength;
+  if (len < 8U)
+  {
+    SCSI_SenseCode(pdev, lun, ILLEGAL_REQUEST, PARAMETER_LIST_LENGTH_ERROR);
+    return -1;
+  }
+
+  /* Block descriptor data length */
+  len = MIN(((uint32_t)hmsc->bot_data[2] << 8) | (uint32_t)hmsc->bot_data[3], len - 8U);
+
+  for (desc = &hmsc->bot_data[8]; len >= 16U; desc += 16U, len -= 16U)
+  {
+    blk_addr = ((uint32_t)desc[4] << 24) | ((uint32_t)desc[5] << 16) |
+               ((uint32_t)desc[6] <<  8) | (uint32_t)desc[7];
+
+    blk_len = ((uint32_t)desc[8] << 24) | ((uint32_t)desc[9] << 16) |
+              ((uint32_t)desc[10] <<  8) | (uint32_t)desc[11];
+
+    /* A 64-bit LBA, or a range that wraps, SCSI_CheckAddressRange() does the rest */
+    if (((desc[0] | desc[1] | desc[2] | desc[3]) != 0U) || (blk_addr + blk_len < blk_addr))
+    {
+      SCSI_SenseCode(pdev, lun, ILLEGAL_REQUEST, ADDRESS_OUT_OF_RANGE);
+      return -1;
+    }
+
+    /* More than the Block Limits page allows for one command */
+    if (blk_len > MSC_UNMAP_MAX_BLOCKS - total)
+    {
+      SCSI_SenseCode(pdev, lun, ILLEGAL_REQUEST, INVALID_FIELD_IN_PARAMETER_LIST);
+      return -1;
+    }
+    total += blk_len;
+
+    if (blk_len == 0U)
+    {
+      continue;
+    }
+
+    if (SCSI_CheckAddressRange(pdev, lun, blk_addr, blk_len) < 0)
+    {
+      return -1; /* error */
+    }
+
+    if (fops->Unmap(lun, blk_addr, blk_len) != 0)
+    {
+      SCSI_SenseCode(pdev, lun, HARDWARE_ERROR, WRITE_FAULT);
+      return -1;
+    }
+  }
+
+  /* case 12 : Ho = Do */
+  hmsc->csw.dDataResidue -= hmsc->cbw.dDataLength;
+  MSC_BOT_SendCSW(pdev, USBD_CSW_CMD_PASSED);
+
+  return 0;
+}
+
 /**
   * @brief  SCSI_CheckAddressRange
-  *         Check address range
+  *         Check address range. The capacity is taken from the unit itself,
+  *         the host does not read it again when it switches between LUNs.
   * @param  lun: Logical unit number
   * @param  blk_offset: first block address
   * @param  blk_nbr: number of block to be processed
@@ -1049,6 +1265,13 @@ static int8_t SCSI_CheckAddressRange(USBD_HandleTypeDef *pdev, uint8_t lun,
     return -1;
   }
 
+  if (((USBD_StorageTypeDef *)pdev->pUserData[pdev->classId])->GetCapacity(lun, &hmsc->scsi_blk_nbr,
+                                                                            &hmsc->scsi_blk_size) != 0)
+  {
+    SCSI_SenseCode(pdev, lun, NOT_READY, MEDIUM_NOT_PRESENT);
+    return -1;
+  }
+
   if ((blk_offset + blk_nbr) > hmsc->scsi_blk_nbr)
   {
     SCSI_SenseCode(pdev, lun, ILLEGAL_REQUEST, ADDRESS_OUT_OF_RANGE);
@@ -1081,6 +1304,13 @@ static int8_t SCSI_ProcessRead(USBD_HandleTypeDef *pdev, uint8_t lun)
   MSCInEpAdd = USBD_CoreGetEPAdd(pdev, USBD_EP_IN, USBD_EP_TYPE_BULK, (uint8_t)pdev->classId);
 #endif /* USE_USBD_COMPOSITE */
 
+#if (MSC_STAGE_SIZE > 0U)
+  if (((USBD_StorageTypeDef *)pdev->pUserData[pdev->classId])->ReadAsync != NULL)
+  {
+    return SCSI_StageProcess(pdev, lun);
+  }
+#endif /* MSC_STAGE_SIZE */
+
   len = MIN(len, MSC_MEDIA_PACKET);
 
   if (((USBD_StorageTypeDef *)pdev->pUserData[pdev->classId])->Read(lun, hmsc->bot_data,
@@ -1107,6 +1337,286 @@ static int8_t SCSI_ProcessRead(USBD_HandleTypeDef *pdev, uint8_t lun)
   return 0;
 }
 
+#if (MSC_STAGE_SIZE > 0U)
+/**
+  * @brief  SCSI_StageReset
+  *         Drop the staged data. Chunks still being read are marked orphan
+  *         and freed by their completion, the storage still writes into
+  *         them. With nothing in flight the reads start again at chunk 0,
+  *         so the first request can take the whole area.
+  * @param  pdev: device instance
+  * @retval None
+  */
+void SCSI_StageReset(USBD_HandleTypeDef *pdev)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+  uint8_t i;
+  uint8_t busy = 0U;
+
+  for (i = 0U; i < MSC_STAGE_CHUNKS; i++)
+  {
+    if (hmsc->stage_state[i] == SCSI_STAGE_READING)
+    {
+      hmsc->stage_state[i] = SCSI_STAGE_ORPHAN;
+      busy = 1U;
+    }
+    else if (hmsc->stage_state[i] == SCSI_STAGE_ORPHAN)
+    {
+      busy = 1U;
+    }
+    else
+    {
+      hmsc->stage_state[i] = SCSI_STAGE_FREE;
+    }
+  }
+  if (busy == 0U)
+  {
+    hmsc->stage_fill = 0U;
+    hmsc->stage_done = 0U;
+  }
+  hmsc->stage_send = hmsc->stage_fill;
+  hmsc->stage_left = 0U;
+}
+
+/**
+  * @brief  SCSI_StageStart
+  *         Set up the staging area for a new READ(10)/(12). Chunks still
+  *         being read for an aborted command are left to complete first.
+  * @param  pdev: device instance
+  * @retval None
+  */
+static void SCSI_StageStart(USBD_HandleTypeDef *pdev)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+
+  SCSI_StageReset(pdev);
+  hmsc->stage_addr = hmsc->scsi_blk_addr;
+  hmsc->stage_left = hmsc->scsi_blk_len;
+}
+
+/**
+  * @brief  SCSI_StageProcess
+  *         Staged Read Process: the card reads ahead into free chunks, as
+  *         one multi-block request per run of free chunks, while the
+  *         previous chunk is on the bus. Called at the start of the data phase and after each chunk
+  *         was sent.
+  * @param  pdev: device instance
+  * @param  lun: Logical unit number
+  * @retval status
+  */
+static int8_t SCSI_StageProcess(USBD_HandleTypeDef *pdev, uint8_t lun)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+
+  if (hmsc->stage_state[hmsc->stage_send] == SCSI_STAGE_SENDING)
+  {
+    hmsc->stage_state[hmsc->stage_send] = SCSI_STAGE_FREE;
+    hmsc->stage_send = (hmsc->stage_send + 1U) % MSC_STAGE_CHUNKS;
+  }
+
+  SCSI_StageRead(pdev, lun);
+
+  return SCSI_StageSend(pdev, lun);
+}
+
+/**
+  * @brief  SCSI_StageRead
+  *         Request the next blocks into the free chunks. Free chunks up to
+  *         the end of the area are contiguous and go in one request.
+  * @param  pdev: device instance
+  * @param  lun: Logical unit number
+  * @retval None
+  */
+static void SCSI_StageRead(USBD_HandleTypeDef *pdev, uint8_t lun)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+  USBD_StorageTypeDef *fops = (USBD_StorageTypeDef *)pdev->pUserData[pdev->classId];
+  uint8_t i;
+  uint8_t n;
+  uint16_t blks;
+  uint16_t b;
+
+  while ((hmsc->stage_left != 0U) && (hmsc->stage_state[hmsc->stage_fill] == SCSI_STAGE_FREE))
+  {
+    i = hmsc->stage_fill;
+    n = 0U;
+    blks = 0U;
+    do
+    {
+      b = (uint16_t)MIN(hmsc->stage_left - blks, (uint32_t)(MSC_STAGE_CHUNK / hmsc->scsi_blk_size));
+      hmsc->stage_state[i + n] = SCSI_STAGE_READING;
+      hmsc->stage_blks[i + n] = b;
+      blks += b;
+      n++;
+    } while (((i + n) < MSC_STAGE_CHUNKS) && (hmsc->stage_state[i + n] == SCSI_STAGE_FREE) &&
+             (hmsc->stage_left > blks));
+
+    hmsc->stage_span[i] = n;
+    hmsc->stage_fill = (i + n) % MSC_STAGE_CHUNKS;
+
+    if (fops->ReadAsync(lun, (uint8_t *)hmsc->stage[i], hmsc->stage_addr, blks,
+                        SCSI_StageDone, hmsc) < 0)
+    {
+      /* Not queued, there will be no completion for it */
+      while (n > 1U)
+      {
+        hmsc->stage_state[i + --n] = SCSI_STAGE_FREE;
+      }
+      hmsc->stage_fill = i;
+      hmsc->stage_state[i] = SCSI_STAGE_ERROR;
+      hmsc->stage_left = 0U;
+      return;
+    }
+    hmsc->stage_addr += blks;
+    hmsc->stage_left -= blks;
+  }
+}
+
+/**
+  * @brief  SCSI_StageSend
+  *         Transmit the next chunk when it was read and the IN endpoint is free
+  * @param  pdev: device instance
+  * @param  lun: Logical unit number
+  * @retval status
+  */
+static int8_t SCSI_StageSend(USBD_HandleTypeDef *pdev, uint8_t lun)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+  uint8_t i = hmsc->stage_send;
+  uint32_t len;
+
+  if (hmsc->stage_state[i] == SCSI_STAGE_ERROR)
+  {
+    hmsc->stage_state[i] = SCSI_STAGE_FREE;
+    hmsc->stage_left = 0U;
+    SCSI_SenseCode(pdev, lun, HARDWARE_ERROR, UNRECOVERED_READ_ERROR);
+    return -1;
+  }
+  if (hmsc->stage_state[i] != SCSI_STAGE_READY)
+  {
+    return 0;
+  }
+
+  len = (uint32_t)hmsc->stage_blks[i] * hmsc->scsi_blk_size;
+  hmsc->stage_state[i] = SCSI_STAGE_SENDING;
+
+  (void)USBD_LL_Transmit(pdev, MSCInEpAdd, (uint8_t *)hmsc->stage[i], len);
+
+  hmsc->scsi_blk_addr += hmsc->stage_blks[i];
+  hmsc->scsi_blk_len -= hmsc->stage_blks[i];
+
+  /* case 6 : Hi = Di */
+  hmsc->csw.dDataResidue -= len;
+
+  if (hmsc->scsi_blk_len == 0U)
+  {
+    hmsc->bot_state = USBD_BOT_LAST_DATA_IN;
+  }
+
+  return 0;
+}
+
+/**
+  * @brief  SCSI_StageDone
+  *         Completion of a read request, in USB interrupt context.
+  *         Completions come in the order of the requests. They also come
+  *         after the class was deinitialized, the MSC handle is the context
+  *         so that the chunks are accounted for all the same. This relies
+  *         on USBD_malloc() handing out the same static block every time.
+  * @param  ctx: MSC handle
+  * @param  status: 0 or -1
+  * @retval None
+  */
+static void SCSI_StageDone(void *ctx, int8_t status)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)ctx;
+  USBD_HandleTypeDef *pdev = hmsc->stage_pdev;
+  uint8_t i;
+  uint8_t n;
+
+  i = hmsc->stage_done;
+  n = hmsc->stage_span[i];
+  hmsc->stage_done = (i + n) % MSC_STAGE_CHUNKS;
+
+  for (; n > 0U; n--, i++)
+  {
+    if (hmsc->stage_state[i] == SCSI_STAGE_ORPHAN)
+    {
+      hmsc->stage_state[i] = SCSI_STAGE_FREE;
+    }
+    else
+    {
+      hmsc->stage_state[i] = (status < 0) ? SCSI_STAGE_ERROR : SCSI_STAGE_READY;
+    }
+  }
+
+  if (hmsc->bot_state != USBD_BOT_DATA_IN)
+  {
+    return;
+  }
+
+  SCSI_StageRead(pdev, hmsc->cbw.bLUN);
+
+  if (hmsc->stage_state[hmsc->stage_send] == SCSI_STAGE_SENDING)
+  {
+    return;   /* Goes on from MSC_BOT_DataIn */
+  }
+  if (SCSI_StageSend(pdev, hmsc->cbw.bLUN) < 0)
+  {
+    MSC_BOT_SendCSW(pdev, USBD_CSW_CMD_FAILED);
+  }
+}
+
+/**
+  * @brief  SCSI_WriteStart
+  *         Claim the staging area for a WRITE(10)/(12), unless a read of an
+  *         aborted command is still landing in it
+  * @param  hmsc: MSC handle
+  * @retval None
+  */
+static void SCSI_WriteStart(USBD_MSC_BOT_HandleTypeDef *hmsc)
+{
+  uint8_t i;
+
+  for (i = 0U; i < MSC_STAGE_CHUNKS; i++)
+  {
+    if ((hmsc->stage_state[i] == SCSI_STAGE_READING) || (hmsc->stage_state[i] == SCSI_STAGE_ORPHAN))
+    {
+      return;
+    }
+  }
+  for (i = 0U; i < MSC_STAGE_CHUNKS; i++)
+  {
+    hmsc->stage_state[i] = SCSI_STAGE_WRITING;
+  }
+}
+#endif /* MSC_STAGE_SIZE */
+
+/**
+  * @brief  SCSI_WriteWindow
+  *         Buffer and length of the next part of a WRITE(10)/(12): up to
+  *         MSC_WRITE_WINDOW bytes in the staging area, or one packet in
+  *         bot_data when it was not available
+  * @param  hmsc: MSC handle
+  * @param  buf: Receives the buffer
+  * @retval length
+  */
+static uint32_t SCSI_WriteWindow(USBD_MSC_BOT_HandleTypeDef *hmsc, uint8_t **buf)
+{
+  uint32_t len = hmsc->scsi_blk_len * hmsc->scsi_blk_size;
+
+#if (MSC_STAGE_SIZE > 0U)
+  if (hmsc->stage_state[0] == SCSI_STAGE_WRITING)
+  {
+    *buf = (uint8_t *)hmsc->stage;
+    return MIN(len, MSC_WRITE_WINDOW);
+  }
+#endif /* MSC_STAGE_SIZE */
+
+  *buf = hmsc->bot_data;
+  return MIN(len, MSC_MEDIA_PACKET);
+}
+
 /**
   * @brief  SCSI_ProcessWrite
   *         Handle Write Process
@@ -1117,6 +1627,7 @@ static int8_t SCSI_ProcessWrite(USBD_HandleTypeDef *pdev, uint8_t lun)
 {
   USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
   uint32_t len;
+  uint8_t *buf;
 
   if (hmsc == NULL)
   {
@@ -1130,9 +1641,10 @@ static int8_t SCSI_ProcessWrite(USBD_HandleTypeDef *pdev, uint8_t lun)
   MSCOutEpAdd = USBD_CoreGetEPAdd(pdev, USBD_EP_OUT, USBD_EP_TYPE_BULK, (uint8_t)pdev->classId);
 #endif /* USE_USBD_COMPOSITE */
 
-  len = MIN(len, MSC_MEDIA_PACKET);
+  len = SCSI_WriteWindow(hmsc, &buf);
 
-  if (((USBD_StorageTypeDef *)pdev->pUserData[pdev->classId])->Write(lun, hmsc->bot_data,
+  /* The whole window as one multi-block write */
+  if (((USBD_StorageTypeDef *)pdev->pUserData[pdev->classId])->Write(lun, buf,
                                                                      hmsc->scsi_blk_addr,
                                                                      (len / hmsc->scsi_blk_size)) < 0)
   {
@@ -1152,10 +1664,10 @@ static int8_t SCSI_ProcessWrite(USBD_HandleTypeDef *pdev, uint8_t lun)
   }
   else
   {
-    len = MIN((hmsc->scsi_blk_len * hmsc->scsi_blk_size), MSC_MEDIA_PACKET);
+    len = SCSI_WriteWindow(hmsc, &buf);
 
     /* Prepare EP to Receive next packet */
-    (void)USBD_LL_PrepareReceive(pdev, MSCOutEpAdd, hmsc->bot_data, len);
+    (void)USBD_LL_PrepareReceive(pdev, MSCOutEpAdd, buf, len);
   }
 
   return 0;
@@ -411,6 +411,42 @@ static BYTE CurrVol;			/* Current drive */
 static FILESEM Files[_FS_LOCK];	/* Open object lock semaphores */
 #endif
 
+#if _USE_DIRHASH
+#if _FS_REENTRANT
+#error _USE_DIRHASH shares the index between volumes and needs _FS_REENTRANT 0
+#endif
+typedef struct {
+	FATFS*	fs;			/* Volume of the directory (0:Free) */
+	WORD	id;			/* Mount ID of the volume */
+	DWORD	clust;		/* Start cluster of the directory (0:FAT12/16 root) */
+	DWORD	use;		/* Time of last use */
+	UINT	base;		/* First slot in DirHashSlot[] */
+	UINT	size;		/* Number of slots (0:The directory is not indexed) */
+	UINT	used;		/* Slots in use or removed, number of names when not indexed */
+	UINT	nclst;		/* Number of clusters of the directory listed after the slots */
+} DIRHASH;
+static DIRHASH DirHash[_DIRHASH_DIRS];		/* Indexed directories */
+static DWORD DirHashSlot[_DIRHASH_SIZE];	/* Name tag in the upper and index of the object's first entry in the lower 16 bits, and cluster lists */
+static DWORD DirHashUse;					/* Use counter */
+#endif
+
+#if _USE_FASTSEEK && _FASTSEEK_POOL
+#if _FS_REENTRANT
+#error _FASTSEEK_POOL shares the pool between volumes and needs _FS_REENTRANT 0
+#endif
+typedef struct {
+	FATFS*	fs;			/* Volume of the map (0:Free), only compared */
+	WORD	id;			/* Mount ID of the volume */
+	DWORD	sclust;		/* Top cluster of the file */
+	UINT	base;		/* First word in ClmtPool[] */
+	UINT	len;		/* Number of words */
+	DWORD	use;		/* Use counter stamp, the oldest map is reclaimed first */
+} CLMTUSE;
+static CLMTUSE ClmtUse[_FASTSEEK_FILES];	/* Automatic link maps */
+static DWORD ClmtPool[_FASTSEEK_POOL];		/* Words of the automatic link maps */
+static DWORD ClmtTick;						/* Use counter */
+#endif
+
 #if _USE_LFN == 0			/* Non LFN feature */
 #define	DEFINE_NAMEBUF		BYTE sfn[12]
 #define INIT_BUF(dobj)		(dobj).fn = sfn
@@ -820,6 +856,119 @@ DWORD get_fat (	/* 0xFFFFFFFF:Disk error, 1:Internal error, 2..0x0FFFFFFF:Cluste
 
 
 
+/*-----------------------------------------------------------------------*/
+/* FAT handling - Free cluster map                                       */
+/*-----------------------------------------------------------------------*/
+/* fmap[] holds the number of free clusters in each group of 2^fmap_shift
+/  clusters. It is counted a group at a time from the start of the FAT after
+/  mount, up to fmap_scan, and kept up by put_fat() in the counted part. */
+
+#if _USE_FREEMAP && !_FS_READONLY
+static
+void fmap_update (
+	FATFS* fs,	/* File system object */
+	DWORD clst,	/* Cluster changed */
+	DWORD old,	/* Previous value of the FAT entry */
+	DWORD val	/* New value of the FAT entry */
+)
+{
+	if (clst < fs->fmap_scan && !old != !val) {
+		if (val)
+			fs->fmap[clst >> fs->fmap_shift]--;
+		else
+			fs->fmap[clst >> fs->fmap_shift]++;
+	}
+}
+
+
+static
+FRESULT fmap_build (
+	FATFS* fs,	/* File system object */
+	UINT nsect	/* FAT sectors to count at least, 0:all */
+)
+{
+	DWORD clst, end, n;
+	UINT i, sects = 0;
+	FRESULT res;
+
+
+	while (fs->fmap_scan && fs->fmap_scan < fs->n_fatent) {
+		clst = fs->fmap_scan;
+		end = ((clst >> fs->fmap_shift) + 1) << fs->fmap_shift;
+		if (end > fs->n_fatent) end = fs->n_fatent;
+		for (n = 0; clst < end; clst++) {	/* Count the free clusters of a group */
+			if (fs->fs_type == FS_FAT16) {
+				res = move_window(fs, fs->fatbase + clst / (SS(fs) / 2));
+				if (res != FR_OK) return res;
+				if (LD_WORD(fs->win + clst * 2 % SS(fs)) == 0) n++;
+			} else {
+				res = move_window(fs, fs->fatbase + clst / (SS(fs) / 4));
+				if (res != FR_OK) return res;
+				if ((LD_DWORD(fs->win + clst * 4 % SS(fs)) & 0x0FFFFFFF) == 0) n++;
+			}
+		}
+		fs->fmap[(end - 1) >> fs->fmap_shift] = (WORD)n;
+		sects += ((end - fs->fmap_scan) * (fs->fs_type == FS_FAT16 ? 2 : 4) + SS(fs) - 1) / SS(fs);
+		fs->fmap_scan = end;
+		if (end == fs->n_fatent) {	/* Complete, the map has the free cluster count */
+			for (i = 0, n = 0; i <= (end - 1) >> fs->fmap_shift; i++) n += fs->fmap[i];
+			if (fs->free_clust != n) {
+				fs->free_clust = n;
+				fs->fsi_flag |= 1;
+			}
+		}
+		if (nsect && sects >= nsect) break;
+	}
+	return FR_OK;
+}
+
+
+#if _FREEMAP_ESTIMATE
+static
+FRESULT fmap_estimate (
+	FATFS* fs,		/* File system object */
+	DWORD* nclst	/* Pointer to return the estimated number of free clusters */
+)
+{
+	DWORD n, i, clst, first, span, sect, nfree, nent;
+	UINT k, e, epc, smp;
+	FRESULT res;
+
+
+	n = 0;
+	if (fs->fmap_scan > 2) {	/* The counted part of the map is exact */
+		for (i = 0; i <= (fs->fmap_scan - 1) >> fs->fmap_shift; i++) n += fs->fmap[i];
+	}
+	epc = SS(fs) / (fs->fs_type == FS_FAT16 ? 2 : 4);	/* FAT entries per sector */
+	first = fs->fmap_scan / epc;
+	span = (fs->n_fatent - 1) / epc - first + 1;		/* FAT sectors not counted */
+	smp = (span < _FREEMAP_ESTIMATE) ? (UINT)span : _FREEMAP_ESTIMATE;
+	nfree = nent = 0;
+	for (k = 0; k < smp; k++) {	/* Count the free entries in sectors spread over the rest */
+		sect = first + (2 * k + 1) * span / (2 * smp);
+		res = move_window(fs, fs->fatbase + sect);
+		if (res != FR_OK) return res;
+		for (e = 0; e < epc; e++) {
+			clst = sect * epc + e;
+			if (clst < fs->fmap_scan || clst >= fs->n_fatent) continue;
+			nent++;
+			if (fs->fs_type == FS_FAT16) {
+				if (LD_WORD(fs->win + e * 2) == 0) nfree++;
+			} else {
+				if ((LD_DWORD(fs->win + e * 4) & 0x0FFFFFFF) == 0) nfree++;
+			}
+		}
+	}
+	if (nent) n += (DWORD)((unsigned long long)(fs->n_fatent - fs->fmap_scan) * nfree / nent);
+	*nclst = n;
+	return FR_OK;
+}
+#endif
+#endif
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* FAT access - Change value of a FAT entry                              */
 /*-----------------------------------------------------------------------*/
@@ -860,6 +1009,9 @@ FRESULT put_fat (
 			res = move_window(fs, fs->fatbase + (clst / (SS(fs) / 2)));
 			if (res != FR_OK) break;
 			p = &fs->win[clst * 2 % SS(fs)];
+#if _USE_FREEMAP
+			fmap_update(fs, clst, LD_WORD(p), (WORD)val);
+#endif
 			ST_WORD(p, (WORD)val);
 			fs->wflag = 1;
 			break;
@@ -868,6 +1020,9 @@ FRESULT put_fat (
 			res = move_window(fs, fs->fatbase + (clst / (SS(fs) / 4)));
 			if (res != FR_OK) break;
 			p = &fs->win[clst * 4 % SS(fs)];
+#if _USE_FREEMAP
+			fmap_update(fs, clst, LD_DWORD(p) & 0x0FFFFFFF, val & 0x0FFFFFFF);
+#endif
 			val |= LD_DWORD(p) & 0xF0000000;
 			ST_DWORD(p, val);
 			fs->wflag = 1;
@@ -971,6 +1126,14 @@ DWORD create_chain (	/* 0:No free cluster, 1:Internal error, 0xFFFFFFFF:Disk err
 			ncl = 2;
 			if (ncl > scl) return 0;	/* No free cluster */
 		}
+#if _USE_FREEMAP
+		if (ncl < fs->fmap_scan && fs->fmap[ncl >> fs->fmap_shift] == 0) {	/* Skip a group without free clusters */
+			cs = ((ncl >> fs->fmap_shift) + 1) << fs->fmap_shift;
+			if (ncl <= scl && scl < cs) return 0;	/* Came around, no free cluster */
+			ncl = cs - 1;
+			continue;
+		}
+#endif
 		cs = get_fat(fs, ncl);			/* Get the cluster status */
 		if (cs == 0) break;				/* Found a free cluster */
 		if (cs == 0xFFFFFFFF || cs == 1)/* An error occurred */
@@ -1023,6 +1186,188 @@ DWORD clmt_clust (	/* <2:Error, >=2:Cluster number */
 	}
 	return cl + *tbl;	/* Return the cluster number */
 }
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* FAT handling - Create link map table                                  */
+/*-----------------------------------------------------------------------*/
+
+static
+FRESULT clmt_create (	/* FR_OK, FR_NOT_ENOUGH_CORE:Table too small, or a disk error */
+	FIL* fp				/* Pointer to the file object with the table size in cltbl[0] */
+)
+{
+	DWORD cl, pcl, ncl, tcl, tlen, ulen, *tbl;
+
+
+	tbl = fp->cltbl;
+	tlen = *tbl++; ulen = 2;	/* Given table size and required table size */
+	cl = fp->sclust;			/* Top of the chain */
+	if (cl) {
+		do {
+			/* Get a fragment */
+			tcl = cl; ncl = 0; ulen += 2;	/* Top, length and used items */
+			do {
+				pcl = cl; ncl++;
+				cl = get_fat(fp->fs, cl);
+				if (cl <= 1) return FR_INT_ERR;
+				if (cl == 0xFFFFFFFF) return FR_DISK_ERR;
+			} while (cl == pcl + 1);
+			if (ulen <= tlen) {		/* Store the length and top of the fragment */
+				*tbl++ = ncl; *tbl++ = tcl;
+			}
+		} while (cl < fp->fs->n_fatent);	/* Repeat until end of chain */
+	}
+	*fp->cltbl = ulen;	/* Number of items used */
+	if (ulen > tlen) return FR_NOT_ENOUGH_CORE;	/* Given table size is smaller than required */
+	*tbl = 0;			/* Terminate table */
+	return FR_OK;
+}
+
+
+
+
+#if _FASTSEEK_POOL
+/*-----------------------------------------------------------------------*/
+/* FAT handling - Automatic link maps                                    */
+/*-----------------------------------------------------------------------*/
+
+static
+CLMTUSE* clmt_use (	/* Automatic map of the file (0:None or a map of the application) */
+	FIL* fp
+)
+{
+	CLMTUSE *cu;
+	UINT i;
+
+
+	if (fp->cltbl < ClmtPool || fp->cltbl >= ClmtPool + _FASTSEEK_POOL) return 0;
+	for (i = 0; i < _FASTSEEK_FILES; i++) {	/* The map at the table must still be of this file */
+		cu = &ClmtUse[i];
+		if (cu->fs == fp->fs && cu->id == fp->id && cu->sclust == fp->sclust && fp->cltbl == ClmtPool + cu->base) {
+			cu->use = ++ClmtTick;
+			return cu;
+		}
+	}
+	return 0;
+}
+
+
+static
+void clmt_check (	/* Drop an automatic map that was reclaimed for another file */
+	FIL* fp
+)
+{
+	if (fp->cltbl >= ClmtPool && fp->cltbl < ClmtPool + _FASTSEEK_POOL && !clmt_use(fp)) fp->cltbl = 0;
+}
+
+
+static
+void clmt_free (	/* Give back the automatic map of the file */
+	FIL* fp
+)
+{
+	CLMTUSE *cu = clmt_use(fp);
+
+
+	if (cu) cu->fs = 0;
+	if (fp->cltbl >= ClmtPool && fp->cltbl < ClmtPool + _FASTSEEK_POOL) fp->cltbl = 0;
+}
+
+
+static
+FRESULT clmt_auto (	/* Build an automatic map, FR_OK also when there is no room for it */
+	FIL* fp
+)
+{
+	CLMTUSE *cu, *fcu;
+	UINT i, j, base, end, gbase, glen, need = 4;
+	FRESULT res;
+
+
+	for (;;) {
+		fcu = 0; gbase = glen = 0;
+		for (i = 0; i < _FASTSEEK_FILES; i++) {
+			if (!ClmtUse[i].fs) fcu = &ClmtUse[i];
+		}
+		for (i = 0; fcu && i <= _FASTSEEK_FILES; i++) {	/* Take the largest gap, at the top of the pool or after a map */
+			if (i) {
+				cu = &ClmtUse[i - 1];
+				if (!cu->fs) continue;
+				base = cu->base + cu->len;
+			} else {
+				base = 0;
+			}
+			end = _FASTSEEK_POOL;
+			for (j = 0; j < _FASTSEEK_FILES; j++) {
+				cu = &ClmtUse[j];
+				if (cu->fs && cu->base >= base && cu->base < end) end = cu->base;
+			}
+			if (end - base > glen) {
+				gbase = base; glen = end - base;
+			}
+		}
+		if (glen >= need) {
+			fp->cltbl = ClmtPool + gbase;
+			fp->cltbl[0] = glen;
+			res = clmt_create(fp);
+			if (res == FR_OK) {			/* Keep the words the map uses */
+				fcu->fs = fp->fs; fcu->id = fp->id; fcu->sclust = fp->sclust;
+				fcu->base = gbase; fcu->len = fp->cltbl[0]; fcu->use = ++ClmtTick;
+				return FR_OK;
+			}
+			need = fp->cltbl[0];		/* Words the map needs */
+			fp->cltbl = 0;
+			if (res != FR_NOT_ENOUGH_CORE) return res;
+			if (need > _FASTSEEK_POOL) return FR_OK;	/* Too fragmented, follow the chain */
+		}
+		cu = 0;							/* Reclaim the least recently used map, its file follows the chain from then on */
+		for (i = 0; i < _FASTSEEK_FILES; i++) {
+			if (ClmtUse[i].fs && (!cu || ClmtTick - ClmtUse[i].use > ClmtTick - cu->use)) cu = &ClmtUse[i];
+		}
+		if (!cu) return FR_OK;
+		cu->fs = 0;
+	}
+}
+
+
+#if !_FS_READONLY
+static
+void clmt_stretch (	/* Add a cluster appended to the chain to the automatic map */
+	FIL* fp,
+	DWORD clst		/* New last cluster of the file */
+)
+{
+	CLMTUSE *cu, *ncu;
+	DWORD n, *tbl;
+	UINT i, end;
+
+
+	cu = clmt_use(fp);
+	if (!cu) return;
+	tbl = fp->cltbl;
+	n = tbl[0];			/* Number of items used, the last one is the terminator */
+	if (n >= 4 && tbl[n - 3] + tbl[n - 2] == clst) {	/* Adjacent to the last fragment? */
+		tbl[n - 3]++;
+		return;
+	}
+	end = cu->base + cu->len + 2;	/* A new fragment needs two more words */
+	for (i = 0; i < _FASTSEEK_FILES; i++) {
+		ncu = &ClmtUse[i];
+		if (ncu->fs && ncu != cu && ncu->base >= cu->base && ncu->base < end) break;
+	}
+	if (i < _FASTSEEK_FILES || end > _FASTSEEK_POOL) {	/* No room, follow the chain from now on */
+		clmt_free(fp);
+		return;
+	}
+	tbl[n - 1] = 1; tbl[n] = clst; tbl[n + 1] = 0;
+	tbl[0] = n + 2;
+	cu->len = n + 2;
+}
+#endif
+#endif	/* _FASTSEEK_POOL */
 #endif	/* _USE_FASTSEEK */
 
 
@@ -1392,13 +1737,487 @@ BYTE sum_sfn (
 	const BYTE* dir		/* Pointer to the SFN entry */
 )
 {
-	BYTE sum = 0;
-	UINT n = 11;
+	BYTE sum = 0;
+	UINT n = 11;
+
+	do sum = (sum >> 1) + (sum << 7) + *dir++; while (--n);
+	return sum;
+}
+#endif
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Directory handling - Match the name from the current entry            */
+/*-----------------------------------------------------------------------*/
+
+static
+FRESULT dir_match (
+	DIR* dp,		/* Pointer to the directory object linked to the file name */
+	int one			/* 0:Search to the end of the table, 1:Check the next object only */
+)
+{
+	FRESULT res;
+	BYTE c, *dir;
+#if _USE_LFN
+	BYTE a, ord, sum;
+#endif
+
+#if _USE_LFN
+	ord = sum = 0xFF; dp->lfn_idx = 0xFFFF;	/* Reset LFN sequence */
+#endif
+	do {
+		res = move_window(dp->fs, dp->sect);
+		if (res != FR_OK) break;
+		dir = dp->dir;					/* Ptr to the directory entry of current index */
+		c = dir[DIR_Name];
+		if (c == 0) { res = FR_NO_FILE; break; }	/* Reached to end of table */
+#if _USE_LFN	/* LFN configuration */
+		a = dir[DIR_Attr] & AM_MASK;
+		if (c == DDEM || ((a & AM_VOL) && a != AM_LFN)) {	/* An entry without valid data */
+			ord = 0xFF; dp->lfn_idx = 0xFFFF;	/* Reset LFN sequence */
+		} else {
+			if (a == AM_LFN) {			/* An LFN entry is found */
+				if (dp->lfn) {
+					if (c & LLEF) {		/* Is it start of LFN sequence? */
+						sum = dir[LDIR_Chksum];
+						c &= ~LLEF; ord = c;	/* LFN start order */
+						dp->lfn_idx = dp->index;	/* Start index of LFN */
+					}
+					/* Check validity of the LFN entry and compare it with given name */
+					ord = (c == ord && sum == dir[LDIR_Chksum] && cmp_lfn(dp->lfn, dir)) ? ord - 1 : 0xFF;
+				}
+			} else {					/* An SFN entry is found */
+				if (!ord && sum == sum_sfn(dir)) break;	/* LFN matched? */
+				if (!(dp->fn[NSFLAG] & NS_LOSS) && !mem_cmp(dir, dp->fn, 11)) break;	/* SFN matched? */
+				ord = 0xFF; dp->lfn_idx = 0xFFFF;	/* Reset LFN sequence */
+				if (one) { res = FR_NO_FILE; break; }	/* Not this object */
+			}
+		}
+#else		/* Non LFN configuration */
+		if (!(dir[DIR_Attr] & AM_VOL)) {	/* Is it a valid entry? */
+			if (!mem_cmp(dir, dp->fn, 11)) break;
+			if (one) { res = FR_NO_FILE; break; }	/* Not this object */
+		}
+#endif
+		res = dir_next(dp, 0);		/* Next entry */
+	} while (res == FR_OK);
+
+	return res;
+}
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Directory handling - Hashed name index                                */
+/*-----------------------------------------------------------------------*/
+/* A directory is indexed on its first look up: every object is entered
+/  with the key of its SFN and, when it has one, the key of its up-cased
+/  LFN in an open addressed table of DirHashSlot[]. A slot holds a tag of
+/  the key and the index of the first entry of the object. The clusters of
+/  the directory follow the slots, so the entry is found without following
+/  the FAT chain and a hit is confirmed with dir_match() on it: a look up
+/  reads one sector, two when the LFN entries cross a sector boundary, and
+/  a miss none. dir_register() and dir_remove() keep the index up to date,
+/  an index that fills up is dropped and built anew. */
+#if _USE_DIRHASH
+
+#define DH_FREE		0		/* Tag of a free slot */
+#define DH_GONE		1		/* Tag of a slot whose object was removed */
+#define DH_MIN		16		/* Directories with fewer names are not indexed */
+#define DH_CLUST(fs, clst)	((!(clst) && (fs)->fs_type == FS_FAT32) ? (fs)->dirbase : (clst))
+
+static
+DWORD dh_mix (
+	DWORD x
+)
+{
+	x ^= x >> 16; x *= 0x7FEB352D;
+	x ^= x >> 15; x *= 0x846CA68B;
+	return x ^ (x >> 16);
+}
+
+
+/* The key of a name is the sum of its characters hashed with their position,
+/  so that the LFN entries can be added in the order they are stored in */
+
+static
+DWORD dh_sfn (		/* Key of an SFN */
+	const BYTE* sfn
+)
+{
+	DWORD h = 0;
+	UINT i;
+
+
+	for (i = 0; i < 11; i++) h += dh_mix(0x1000000 | i << 16 | sfn[i]);
+	return dh_mix(h);
+}
+
+
+#if _USE_LFN
+static
+DWORD dh_lfn (		/* Key of an LFN */
+	const WCHAR* lfn
+)
+{
+	DWORD h = 0;
+	UINT i;
+
+
+	for (i = 0; lfn[i]; i++) h += dh_mix(i << 16 | ff_wtoupper(lfn[i]));
+	return dh_mix(h + i);
+}
+
+
+static
+UINT dh_pick (		/* Add the characters of an LFN entry to the key, returns the index past the last one */
+	DWORD* h,
+	const BYTE* dir
+)
+{
+	UINT i, s;
+	WCHAR uc;
+
+
+	i = ((dir[LDIR_Ord] & ~LLEF) - 1) * 13;
+	for (s = 0; s < 13; s++) {
+		uc = LD_WORD(dir + LfnOfs[s]);
+		if (!uc) break;
+		*h += dh_mix(i++ << 16 | ff_wtoupper(uc));
+	}
+	return i;
+}
+#endif
+
+
+static
+UINT dh_tag (
+	DWORD key
+)
+{
+	UINT tag = (UINT)(key >> 16);
+
+	return (tag > DH_GONE) ? tag : tag + 2;
+}
+
+
+static
+DIRHASH* dh_dir (	/* Index of the directory, 0:Not indexed */
+	FATFS* fs,
+	DWORD clst		/* Start cluster of the directory */
+)
+{
+	UINT i;
+
+
+	clst = DH_CLUST(fs, clst);
+	for (i = 0; i < _DIRHASH_DIRS; i++) {
+		if (DirHash[i].fs == fs && DirHash[i].id == fs->id && DirHash[i].clust == clst) {
+			DirHash[i].use = ++DirHashUse;
+			return &DirHash[i];
+		}
+	}
+	return 0;
+}
+
+
+static
+DIRHASH* dh_alloc (	/* Claim slots, dropping the least recently used indexes for room */
+	UINT size,		/* Number of name slots */
+	UINT nclst		/* Number of clusters to list */
+)
+{
+	DIRHASH *dh, *fr, *lru;
+	UINT i, j, base;
+
+
+	for (;;) {
+		fr = lru = 0;
+		for (i = 0; i < _DIRHASH_DIRS; i++) {
+			dh = &DirHash[i];
+			if (!dh->fs) fr = dh;
+			else if (!lru || dh->use < lru->use) lru = dh;
+		}
+		for (i = 0; fr && i <= _DIRHASH_DIRS; i++) {	/* Try the start and the end of every index */
+			if (i == 0) {
+				base = 0;
+			} else {
+				dh = &DirHash[i - 1];
+				if (!dh->fs) continue;
+				base = dh->base + dh->size + dh->nclst;
+			}
+			if (base + size + nclst > _DIRHASH_SIZE) continue;
+			for (j = 0; j < _DIRHASH_DIRS; j++) {
+				dh = &DirHash[j];
+				if (dh->fs && dh->size && base < dh->base + dh->size + dh->nclst && dh->base < base + size + nclst) break;
+			}
+			if (j == _DIRHASH_DIRS) {
+				fr->base = base; fr->size = size; fr->nclst = nclst; fr->used = 0;
+				return fr;
+			}
+		}
+		if (!lru) return 0;
+		lru->fs = 0;
+	}
+}
+
+
+static
+void dh_insert (
+	DIRHASH* dh,
+	DWORD key,
+	UINT idx		/* Index of the first entry of the object */
+)
+{
+	DWORD *slot = DirHashSlot + dh->base;
+	UINT i;
+
+
+	for (i = key % dh->size; (slot[i] >> 16) > DH_GONE; i = (i + 1) % dh->size) ;
+	if ((slot[i] >> 16) == DH_FREE) dh->used++;
+	slot[i] = (DWORD)dh_tag(key) << 16 | idx;
+}
+
+
+static
+DIRHASH* dh_build (	/* Index the directory, 0:Disk error */
+	DIR* dp
+)
+{
+	FRESULT res;
+	DIR dj;
+	DIRHASH *dh = 0;
+	UINT n = 0, ncl = 0, pass, size;
+	DWORD clst;
+	BYTE c, a, *dir;
+#if _USE_LFN
+	BYTE ord, sum = 0xFF;
+	UINT i, start = 0, len = 0;
+	DWORD lh = 0;
+#endif
+
+
+	mem_cpy(&dj, dp, sizeof (DIR));
+	for (pass = 0; pass < 2; pass++) {
+		if (pass) {				/* Size the index to 1.5 slots per name */
+			size = (n >= DH_MIN && n + n / 2 + ncl <= _DIRHASH_SIZE) ? n + n / 2 : 0;
+			dh = dh_alloc(size, size ? ncl : 0);
+			if (!dh) return 0;
+			if (!size) { dh->used = n; break; }
+			mem_set(DirHashSlot + dh->base, 0, size * sizeof (DWORD));
+			ncl = 0;
+		}
+		res = dir_sdi(&dj, 0);
+		clst = 0;
+#if _USE_LFN
+		ord = 0xFF;
+#endif
+		while (res == FR_OK) {
+			if (dj.clust != clst) {		/* List the clusters */
+				clst = dj.clust;
+				if (pass) DirHashSlot[dh->base + dh->size + ncl] = clst;
+				ncl++;
+			}
+			res = move_window(dj.fs, dj.sect);
+			if (res != FR_OK) break;
+			dir = dj.dir;
+			c = dir[DIR_Name];
+			if (c == 0) break;			/* End of table */
+			a = dir[DIR_Attr] & AM_MASK;
+#if _USE_LFN	/* Mirrors dir_match() */
+			if (c == DDEM || ((a & AM_VOL) && a != AM_LFN)) {
+				ord = 0xFF;
+			} else if (a == AM_LFN) {
+				if (c & LLEF) {
+					sum = dir[LDIR_Chksum];
+					c &= ~LLEF; ord = c;
+					start = dj.index; lh = 0;
+				}
+				if (c == ord && sum == dir[LDIR_Chksum]) {
+					if (pass) {
+						i = dh_pick(&lh, dir);
+						if (dir[LDIR_Ord] & LLEF) len = i;
+					}
+					ord--;
+				} else {
+					ord = 0xFF;
+				}
+			} else {
+				if (!ord && sum == sum_sfn(dir)) {	/* With a valid LFN */
+					if (pass) {
+						dh_insert(dh, dh_mix(lh + len), start);
+						dh_insert(dh, dh_sfn(dir), start);
+					}
+					n += 2;
+				} else {
+					if (pass) dh_insert(dh, dh_sfn(dir), dj.index);
+					n++;
+				}
+				ord = 0xFF;
+			}
+#else
+			if (c != DDEM && !(a & AM_VOL)) {
+				if (pass) dh_insert(dh, dh_sfn(dir), dj.index);
+				n++;
+			}
+#endif
+			res = dir_next(&dj, 0);
+		}
+		if (res != FR_OK && res != FR_NO_FILE) {
+			if (dh) dh->size = 0;	/* Give back the slots */
+			return 0;
+		}
+	}
+	dh->fs = dj.fs;
+	dh->id = dj.fs->id;
+	dh->clust = DH_CLUST(dj.fs, dj.sclust);
+	dh->use = ++DirHashUse;
+	return dh;
+}
+
+
+static
+FRESULT dh_sdi (	/* dir_sdi() through the cluster list */
+	DIR* dp,
+	DIRHASH* dh,
+	UINT idx
+)
+{
+	UINT ic, n;
+
+
+	ic = SS(dp->fs) / SZ_DIRE * dp->fs->csize;	/* Entries per cluster */
+	n = idx / ic;
+	if (n >= dh->nclst) return dir_sdi(dp, idx);	/* Static table or not listed */
+	dp->index = (WORD)idx;
+	dp->clust = DirHashSlot[dh->base + dh->size + n];
+	dp->sect = clust2sect(dp->fs, dp->clust) + idx % ic / (SS(dp->fs) / SZ_DIRE);
+	dp->dir = dp->fs->win + (idx % (SS(dp->fs) / SZ_DIRE)) * SZ_DIRE;
+	return FR_OK;
+}
+
+
+static
+int dh_probe (		/* 1:Found or disk error, 0:Not found */
+	DIR* dp,
+	DIRHASH* dh,
+	DWORD key,
+	FRESULT* res
+)
+{
+	DWORD s, *slot = DirHashSlot + dh->base;
+	UINT i, tag = dh_tag(key);
+
+
+	for (i = key % dh->size; (s = slot[i]) >> 16 != DH_FREE; i = (i + 1) % dh->size) {
+		if ((s >> 16) != tag) continue;
+		*res = dh_sdi(dp, dh, (UINT)(s & 0xFFFF));
+		if (*res == FR_OK) *res = dir_match(dp, 1);	/* Is it the object? */
+		if (*res != FR_NO_FILE) return 1;
+	}
+	return 0;
+}
+
+
+static
+int dh_find (		/* 1:Answered by the index, 0:Search the directory */
+	DIR* dp,
+	FRESULT* res
+)
+{
+	DIRHASH *dh;
+
+
+	dh = dh_dir(dp->fs, dp->sclust);
+	if (!dh) dh = dh_build(dp);
+	if (!dh || !dh->size) return 0;
+#if _USE_LFN
+	if (dp->lfn && dh_probe(dp, dh, dh_lfn(dp->lfn), res)) return 1;
+	if (dp->fn[NSFLAG] & NS_LOSS) { *res = FR_NO_FILE; return 1; }
+#endif
+	if (!dh_probe(dp, dh, dh_sfn(dp->fn), res)) *res = FR_NO_FILE;
+	return 1;
+}
+
+
+#if !_FS_READONLY
+static
+void dh_register (	/* Enter the object registered by dir_register() */
+	DIR* dp
+)
+{
+	DIRHASH *dh;
+	UINT n = 1, start = dp->index;
+
+
+	dh = dh_dir(dp->fs, dp->sclust);
+	if (!dh) return;
+#if _USE_LFN
+	if (dp->fn[NSFLAG] & NS_LFN) {
+		for (n = 0; dp->lfn[n]; n++) ;
+		start -= (n + 12) / 13;		/* First LFN entry */
+		n = 2;
+	}
+#endif
+	if (!dh->size) {				/* Not indexed, index it when it has grown big enough */
+		dh->used += n;
+		if (dh->used >= DH_MIN && dh->used + dh->used / 2 <= _DIRHASH_SIZE) dh->fs = 0;
+		return;
+	}
+	if ((dh->used + n) * 8 > dh->size * 7) {	/* Full, build it anew on the next look up */
+		dh->fs = 0;
+		return;
+	}
+#if _USE_LFN
+	if (n == 2) dh_insert(dh, dh_lfn(dp->lfn), start);
+#endif
+	dh_insert(dh, dh_sfn(dp->fn), start);
+}
+
+
+static
+void dh_remove (	/* Remove the object removed by dir_remove() */
+	DIR* dp,
+	FRESULT res		/* Result of dir_remove() */
+)
+{
+	DIRHASH *dh;
+	DWORD *slot;
+	UINT i, idx, start = dp->index;
+
+
+	dh = dh_dir(dp->fs, dp->sclust);
+	if (!dh) return;
+	if (res != FR_OK) {				/* Partly removed */
+		dh->fs = 0;
+		return;
+	}
+#if _USE_LFN
+	if (dp->lfn_idx != 0xFFFF) start = dp->lfn_idx;
+#endif
+	slot = DirHashSlot + dh->base;
+	for (i = 0; i < dh->size; i++) {
+		idx = (UINT)(slot[i] & 0xFFFF);
+		if ((slot[i] >> 16) > DH_GONE && idx >= start && idx <= dp->index) slot[i] = (DWORD)DH_GONE << 16;
+	}
+}
+
+
+static
+void dh_drop (		/* Forget the index of a removed directory */
+	FATFS* fs,
+	DWORD clst
+)
+{
+	DIRHASH *dh = dh_dir(fs, clst);
 
-	do sum = (sum >> 1) + (sum << 7) + *dir++; while (--n);
-	return sum;
+	if (dh) dh->fs = 0;
 }
 #endif
+#endif	/* _USE_DIRHASH */
 
 
 
@@ -1413,52 +2232,15 @@ FRESULT dir_find (
 )
 {
 	FRESULT res;
-	BYTE c, *dir;
-#if _USE_LFN
-	BYTE a, ord, sum;
-#endif
 
-	res = dir_sdi(dp, 0);			/* Rewind directory object */
-	if (res != FR_OK) return res;
 
-#if _USE_LFN
-	ord = sum = 0xFF; dp->lfn_idx = 0xFFFF;	/* Reset LFN sequence */
-#endif
-	do {
-		res = move_window(dp->fs, dp->sect);
-		if (res != FR_OK) break;
-		dir = dp->dir;					/* Ptr to the directory entry of current index */
-		c = dir[DIR_Name];
-		if (c == 0) { res = FR_NO_FILE; break; }	/* Reached to end of table */
-#if _USE_LFN	/* LFN configuration */
-		a = dir[DIR_Attr] & AM_MASK;
-		if (c == DDEM || ((a & AM_VOL) && a != AM_LFN)) {	/* An entry without valid data */
-			ord = 0xFF; dp->lfn_idx = 0xFFFF;	/* Reset LFN sequence */
-		} else {
-			if (a == AM_LFN) {			/* An LFN entry is found */
-				if (dp->lfn) {
-					if (c & LLEF) {		/* Is it start of LFN sequence? */
-						sum = dir[LDIR_Chksum];
-						c &= ~LLEF; ord = c;	/* LFN start order */
-						dp->lfn_idx = dp->index;	/* Start index of LFN */
-					}
-					/* Check validity of the LFN entry and compare it with given name */
-					ord = (c == ord && sum == dir[LDIR_Chksum] && cmp_lfn(dp->lfn, dir)) ? ord - 1 : 0xFF;
-				}
-			} else {					/* An SFN entry is found */
-				if (!ord && sum == sum_sfn(dir)) break;	/* LFN matched? */
-				if (!(dp->fn[NSFLAG] & NS_LOSS) && !mem_cmp(dir, dp->fn, 11)) break;	/* SFN matched? */
-				ord = 0xFF; dp->lfn_idx = 0xFFFF;	/* Reset LFN sequence */
-			}
-		}
-#else		/* Non LFN configuration */
-		if (!(dir[DIR_Attr] & AM_VOL) && !mem_cmp(dir, dp->fn, 11)) /* Is it a valid entry? */
-			break;
+#if _USE_DIRHASH
+	if (dh_find(dp, &res)) return res;	/* Answered by the name index */
 #endif
-		res = dir_next(dp, 0);		/* Next entry */
-	} while (res == FR_OK);
+	res = dir_sdi(dp, 0);			/* Rewind directory object */
+	if (res != FR_OK) return res;
 
-	return res;
+	return dir_match(dp, 0);
 }
 
 
@@ -1593,6 +2375,9 @@ FRESULT dir_register (	/* FR_OK:Successful, FR_DENIED:No free entry or too many
 			dp->fs->wflag = 1;
 		}
 	}
+#if _USE_DIRHASH
+	if (res == FR_OK) dh_register(dp);
+#endif
 
 	return res;
 }
@@ -1640,6 +2425,9 @@ FRESULT dir_remove (	/* FR_OK: Successful, FR_DISK_ERR: A disk error */
 		}
 	}
 #endif
+#if _USE_DIRHASH
+	dh_remove(dp, res);
+#endif
 
 	return res;
 }
@@ -2304,6 +3092,17 @@ FRESULT find_volume (	/* FR_OK(0): successful, !=0: any error occurred */
 		}
 	}
 #endif
+#endif
+#if _USE_FREEMAP && !_FS_READONLY
+	/* Size the free cluster map, counted later by f_freemap() or f_getfree() */
+	fs->fmap_scan = 0;
+	if (fmt != FS_FAT12) {
+		for (i = 0; (fs->n_fatent - 1) >> i >= _FREEMAP_SIZE; i++) ;
+		if (i <= 15) {	/* A group has to fit a WORD */
+			fs->fmap_shift = (BYTE)i;
+			fs->fmap_scan = 2;
+		}
+	}
 #endif
 	fs->fs_type = fmt;	/* FAT sub-type */
 	fs->id = ++Fsid;	/* File system mount ID */
@@ -2565,6 +3364,9 @@ FRESULT f_read (
 		LEAVE_FF(fp->fs, (FRESULT)fp->err);
 	if (!(fp->flag & FA_READ)) 					/* Check access mode */
 		LEAVE_FF(fp->fs, FR_DENIED);
+#if _USE_FASTSEEK && _FASTSEEK_POOL
+	clmt_check(fp);								/* Automatic map still of this file? */
+#endif
 	remain = fp->fsize - fp->fptr;
 	if (btr > remain) btr = (UINT)remain;		/* Truncate btr by remaining bytes */
 
@@ -2678,6 +3480,9 @@ FRESULT f_write (
 	UINT wcnt, cc;
 	const BYTE *wbuff = (const BYTE*)buff;
 	BYTE csect;
+#if _USE_EXPAND
+	DWORD bcs, ncs;
+#endif
 
 
 	*bw = 0;	/* Clear write byte counter */
@@ -2688,6 +3493,9 @@ FRESULT f_write (
 		LEAVE_FF(fp->fs, (FRESULT)fp->err);
 	if (!(fp->flag & FA_WRITE))				/* Check access mode */
 		LEAVE_FF(fp->fs, FR_DENIED);
+#if _USE_FASTSEEK && _FASTSEEK_POOL
+	clmt_check(fp);							/* Automatic map still of this file? */
+#endif
 	if (fp->fptr + btw < fp->fptr) btw = 0;	/* File size cannot reach 4GB */
 
 	for ( ;  btw;							/* Repeat until all data written */
@@ -2701,11 +3509,30 @@ FRESULT f_write (
 						clst = create_chain(fp->fs, 0);	/* Create a new cluster chain */
 				} else {					/* Middle or end of the file */
 #if _USE_FASTSEEK
-					if (fp->cltbl)
+					if (fp->cltbl) {
 						clst = clmt_clust(fp, fp->fptr);	/* Get cluster# from the CLMT */
-					else
+#if _FASTSEEK_POOL
+						if (!clst && clmt_use(fp)) {		/* Beyond an automatic map? */
+							clst = create_chain(fp->fs, fp->clust);	/* Stretch the chain and the map */
+							if (clst >= 2 && clst != 0xFFFFFFFF) clmt_stretch(fp, clst);
+#if _USE_EXPAND
+							fp->flag &= ~FA__CONTIG;		/* Past the contiguous allocation from now on */
+#endif
+						}
+#endif
+					} else
+#endif
+#if _USE_EXPAND
+					if ((fp->flag & FA__CONTIG) && fp->fptr < fp->fsize) {	/* In the contiguous allocation */
+						clst = fp->sclust + fp->fptr / ((DWORD)fp->fs->csize * SS(fp->fs));
+					} else
+#endif
+					{
+#if _USE_EXPAND
+						fp->flag &= ~FA__CONTIG;	/* Stretching past the contiguous allocation */
 #endif
 						clst = create_chain(fp->fs, fp->clust);	/* Follow or stretch cluster chain on the FAT */
+					}
 				}
 				if (clst == 0) break;		/* Could not allocate a new cluster (disk full) */
 				if (clst == 1) ABORT(fp->fs, FR_INT_ERR);
@@ -2728,6 +3555,14 @@ FRESULT f_write (
 			sect += csect;
 			cc = btw / SS(fp->fs);			/* When remaining bytes >= sector size, */
 			if (cc) {						/* Write maximum contiguous sectors directly */
+#if _USE_EXPAND
+				if ((fp->flag & FA__CONTIG) && fp->fptr < fp->fsize) {	/* Clip at the end of the contiguous allocation */
+					bcs = (DWORD)fp->fs->csize * SS(fp->fs);
+					ncs = ((fp->fsize - 1) / bcs + 1) * fp->fs->csize - fp->fptr / SS(fp->fs);
+					if (cc > ncs) cc = (UINT)ncs;
+					fp->clust = fp->sclust + (fp->fptr + (DWORD)cc * SS(fp->fs) - 1) / bcs;	/* Cluster of the last sector */
+				} else
+#endif
 				if (csect + cc > fp->fs->csize)	/* Clip at cluster boundary */
 					cc = fp->fs->csize - csect;
 #if _FS_NO_DIRECT_SECTOR_TRANSFER
@@ -2866,6 +3701,9 @@ FRESULT f_close (
 #if _FS_REENTRANT
 			FATFS *fs = fp->fs;
 #endif
+#if _USE_FASTSEEK && _FASTSEEK_POOL
+			clmt_free(fp);				/* Give back the automatic link map */
+#endif
 #if _FS_LOCK
 			res = dec_lock(fp->lockid);	/* Decrement file open counter */
 			if (res == FR_OK)
@@ -3029,7 +3867,7 @@ FRESULT f_lseek (
 	FRESULT res;
 	DWORD clst, bcs, nsect, ifptr;
 #if _USE_FASTSEEK
-	DWORD cl, pcl, ncl, tcl, dsc, tlen, ulen, *tbl;
+	DWORD dsc;
 #endif
 
 
@@ -3039,31 +3877,28 @@ FRESULT f_lseek (
 		LEAVE_FF(fp->fs, (FRESULT)fp->err);
 
 #if _USE_FASTSEEK
+#if _FASTSEEK_POOL
+	clmt_check(fp);						/* Automatic map still of this file? */
+	if (ofs != CREATE_LINKMAP) {
+		if (fp->cltbl) {
+#if !_FS_READONLY
+			if (ofs > fp->fsize && (fp->flag & FA_WRITE))	/* Expanding the file, seek without an automatic map */
+				clmt_free(fp);
+#endif
+		} else if (ofs && ofs <= fp->fsize && fp->fsize >= _FASTSEEK_MIN) {
+			bcs = (DWORD)fp->fs->csize * SS(fp->fs);	/* Cluster size (byte) */
+			ifptr = (fp->fptr && (ofs - 1) / bcs >= (fp->fptr - 1) / bcs) ? (fp->fptr - 1) / bcs : 0;	/* Cluster the chain would be followed from */
+			if ((ofs - 1) / bcs > ifptr + 1) {	/* More than one link to follow? */
+				res = clmt_auto(fp);
+				if (res != FR_OK) ABORT(fp->fs, res);
+			}
+		}
+	}
+#endif
 	if (fp->cltbl) {	/* Fast seek */
 		if (ofs == CREATE_LINKMAP) {	/* Create CLMT */
-			tbl = fp->cltbl;
-			tlen = *tbl++; ulen = 2;	/* Given table size and required table size */
-			cl = fp->sclust;			/* Top of the chain */
-			if (cl) {
-				do {
-					/* Get a fragment */
-					tcl = cl; ncl = 0; ulen += 2;	/* Top, length and used items */
-					do {
-						pcl = cl; ncl++;
-						cl = get_fat(fp->fs, cl);
-						if (cl <= 1) ABORT(fp->fs, FR_INT_ERR);
-						if (cl == 0xFFFFFFFF) ABORT(fp->fs, FR_DISK_ERR);
-					} while (cl == pcl + 1);
-					if (ulen <= tlen) {		/* Store the length and top of the fragment */
-						*tbl++ = ncl; *tbl++ = tcl;
-					}
-				} while (cl < fp->fs->n_fatent);	/* Repeat until end of chain */
-			}
-			*fp->cltbl = ulen;	/* Number of items used */
-			if (ulen <= tlen)
-				*tbl = 0;		/* Terminate table */
-			else
-				res = FR_NOT_ENOUGH_CORE;	/* Given table size is smaller than required */
+			res = clmt_create(fp);
+			if (res == FR_INT_ERR || res == FR_DISK_ERR) ABORT(fp->fs, res);
 
 		} else {						/* Fast seek */
 			if (ofs > fp->fsize)		/* Clip offset at the file size */
@@ -3165,6 +4000,9 @@ FRESULT f_lseek (
 		if (fp->fptr > fp->fsize) {			/* Set file change flag if the file size is extended */
 			fp->fsize = fp->fptr;
 			fp->flag |= FA__WRITTEN;
+#if _USE_EXPAND
+			fp->flag &= ~FA__CONTIG;		/* The chain may now go on past the contiguous allocation */
+#endif
 		}
 #endif
 	}
@@ -3416,6 +4254,17 @@ FRESULT f_getfree (
 		/* If free_clust is valid, return it without full cluster scan */
 		if (fs->free_clust <= fs->n_fatent - 2) {
 			*nclst = fs->free_clust;
+#if _USE_FREEMAP
+		} else if (fs->fmap_scan) {
+#if _FREEMAP_ESTIMATE
+			/* Sample the FAT beyond the counted part of the map, f_freemap() counts the rest */
+			res = fmap_estimate(fs, nclst);
+#else
+			/* Count the rest into the free cluster map */
+			res = fmap_build(fs, 0);
+			*nclst = fs->free_clust;
+#endif
+#endif
 		} else {
 			/* Get number of free clusters */
 			fat = fs->fs_type;
@@ -3459,6 +4308,33 @@ FRESULT f_getfree (
 
 
 
+#if _USE_FREEMAP
+/*-----------------------------------------------------------------------*/
+/* Count Free Clusters in Steps                                          */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_freemap (
+	const TCHAR* path,	/* Path name of the logical drive number */
+	UINT nsect,			/* Number of FAT sectors to count in this call (0:all) */
+	DWORD* left			/* Pointer to return the number of clusters left to count (0:complete or no map) */
+)
+{
+	FRESULT res;
+	FATFS *fs;
+
+
+	res = find_volume(&fs, &path, 0);
+	if (res == FR_OK) {
+		res = fmap_build(fs, nsect);
+		*left = fs->fmap_scan ? fs->n_fatent - fs->fmap_scan : 0;
+	}
+	LEAVE_FF(fs, res);
+}
+#endif
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Truncate File                                                         */
 /*-----------------------------------------------------------------------*/
@@ -3482,6 +4358,9 @@ FRESULT f_truncate (
 	}
 	if (res == FR_OK) {
 		if (fp->fsize > fp->fptr) {
+#if _USE_FASTSEEK && _FASTSEEK_POOL
+			clmt_free(fp);			/* The automatic link map would hold removed clusters */
+#endif
 			fp->fsize = fp->fptr;	/* Set file size to current R/W point */
 			fp->flag |= FA__WRITTEN;
 			if (fp->fptr == 0) {	/* When set file size to zero, remove entire cluster chain */
@@ -3515,6 +4394,92 @@ FRESULT f_truncate (
 
 
 
+#if _USE_EXPAND
+/*-----------------------------------------------------------------------*/
+/* Allocate a Contiguous Blocks to the File                              */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_expand (
+	FIL* fp,		/* Pointer to the file object */
+	DWORD fsz,		/* File size to be expanded to */
+	BYTE opt		/* Operation mode 0:Find and prepare or 1:Find and allocate */
+)
+{
+	FRESULT res;
+	FATFS *fs;
+	DWORD n, clst, stcl, scl, ncl, tcl, lclst;
+
+
+	res = validate(fp);		/* Check validity of the object */
+	if (res != FR_OK) LEAVE_FF(fp->fs, res);
+	fs = fp->fs;
+	if (fp->err) LEAVE_FF(fs, (FRESULT)fp->err);
+	if (fsz == 0 || fp->fsize != 0 || fp->sclust != 0 || !(fp->flag & FA_WRITE)) LEAVE_FF(fs, FR_DENIED);
+
+	n = (DWORD)fs->csize * SS(fs);	/* Cluster size */
+	tcl = fsz / n + ((fsz % n) ? 1 : 0);	/* Number of clusters required */
+	stcl = fs->last_clust + 1; lclst = 0;
+	if (stcl < 2 || stcl >= fs->n_fatent) stcl = 2;
+
+	scl = clst = stcl; ncl = 0;
+	for (;;) {	/* Find a contiguous cluster block */
+#if _USE_FREEMAP
+		if (clst < fs->fmap_scan && fs->fmap[clst >> fs->fmap_shift] == 0) {	/* Skip a group without free clusters */
+			n = ((clst >> fs->fmap_shift) + 1) << fs->fmap_shift;
+			if (clst < stcl && stcl < n) { res = FR_DENIED; break; }
+			clst = (n >= fs->n_fatent) ? 2 : n;
+			scl = clst; ncl = 0;
+			if (clst == stcl) { res = FR_DENIED; break; }
+			continue;
+		}
+#endif
+		n = get_fat(fs, clst);
+		if (n == 1) { res = FR_INT_ERR; break; }
+		if (n == 0xFFFFFFFF) { res = FR_DISK_ERR; break; }
+		if (n == 0) {	/* Is it a free cluster? */
+			if (++ncl == tcl) break;	/* Break if a contiguous cluster block is found */
+		} else {
+			ncl = 0;
+		}
+		if (++clst >= fs->n_fatent) {	/* A block cannot wrap around the end of the FAT */
+			clst = 2; ncl = 0;
+		}
+		if (!ncl) scl = clst;			/* Next block starts here */
+		if (clst == stcl) { res = FR_DENIED; break; }	/* No contiguous cluster? */
+	}
+	if (res == FR_OK) {	/* A contiguous free area is found */
+		if (opt) {		/* Allocate it now */
+			for (clst = scl, n = tcl; n; clst++, n--) {	/* Create a cluster chain on the FAT */
+				res = put_fat(fs, clst, (n == 1) ? 0x0FFFFFFF : clst + 1);
+				if (res != FR_OK) break;
+				lclst = clst;
+			}
+		} else {		/* Set it as suggested point for next allocation */
+			lclst = scl - 1;
+		}
+	}
+
+	if (res == FR_OK) {
+		fs->last_clust = lclst;		/* Set suggested start cluster to start next */
+		if (opt) {	/* Is it allocated now? */
+			fp->sclust = scl;		/* Update object allocation information */
+			fp->clust = scl;
+			fp->fsize = fsz;
+			fp->flag |= FA__WRITTEN | FA__CONTIG;
+			if (fs->free_clust != 0xFFFFFFFF) {	/* Update FSINFO */
+				fs->free_clust -= tcl;
+				fs->fsi_flag |= 1;
+			}
+		}
+	}
+
+	LEAVE_FF(fs, res);
+}
+#endif /* _USE_EXPAND */
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Delete a File or Directory                                            */
 /*-----------------------------------------------------------------------*/
@@ -3572,6 +4537,9 @@ FRESULT f_unlink (
 				res = dir_remove(&dj);		/* Remove the directory entry */
 				if (res == FR_OK && dclst)	/* Remove the cluster chain if exist */
 					res = remove_chain(dj.fs, dclst);
+#if _USE_DIRHASH
+				if (res == FR_OK && dclst) dh_drop(dj.fs, dclst);	/* Forget the index of a removed directory */
+#endif
 				if (res == FR_OK) res = sync_fs(dj.fs);
 			}
 		}
@@ -4073,9 +5041,10 @@ FRESULT f_mkfs (
 	DWORD n_clst, vs, n, wsect;
 	UINT i;
 	DWORD b_vol, b_fat, b_dir, b_data;	/* LBA */
-	DWORD n_vol, n_rsv, n_fat, n_dir;	/* Size */
+	DWORD n_vol, n_rsv, n_fat, n_dir, n_blk;	/* Size */
 	FATFS *fs;
 	DSTATUS stat;
+	BYTE ez = 0;	/* The system area was erased and reads as zeros */
 #if _USE_TRIM
 	DWORD eb[2];
 #endif
@@ -4099,6 +5068,10 @@ FRESULT f_mkfs (
 	if (disk_ioctl(pdrv, GET_SECTOR_SIZE, &SS(fs)) != RES_OK || SS(fs) > _MAX_SS || SS(fs) < _MIN_SS)
 		return FR_DISK_ERR;
 #endif
+	/* Get the erase block size, the partition, FAT and data area are aligned to it (for flash memory media) */
+	if (disk_ioctl(pdrv, GET_BLOCK_SIZE, &n_blk) != RES_OK || !n_blk) n_blk = 1;
+	while (n_blk > 32768) n_blk /= 2;	/* Keep the reserved area within a WORD */
+
 	if (_MULTI_PARTITION && part) {
 		/* Get partition information from partition table in the MBR */
 		if (disk_read(pdrv, fs->win, 0, 1) != RES_OK) return FR_DISK_ERR;
@@ -4111,7 +5084,8 @@ FRESULT f_mkfs (
 		/* Create a partition in this function */
 		if (disk_ioctl(pdrv, GET_SECTOR_COUNT, &n_vol) != RES_OK || n_vol < 128)
 			return FR_DISK_ERR;
-		b_vol = (sfd) ? 0 : 63;		/* Volume start sector */
+		b_vol = (sfd) ? 0 : (63 + n_blk - 1) / n_blk * n_blk;	/* Volume start sector */
+		if (n_vol < b_vol + 128) return FR_MKFS_ABORTED;
 		n_vol -= b_vol;				/* Volume size */
 	}
 
@@ -4147,16 +5121,16 @@ FRESULT f_mkfs (
 	b_data = b_dir + n_dir;				/* Data area start sector */
 	if (n_vol < b_data + au - b_vol) return FR_MKFS_ABORTED;	/* Too small volume */
 
-	/* Align data start sector to erase block boundary (for flash memory media) */
-	if (disk_ioctl(pdrv, GET_BLOCK_SIZE, &n) != RES_OK || !n || n > 32768) n = 1;
-	n = (b_data + n - 1) & ~(n - 1);	/* Next nearest erase block from current data start */
-	n = (n - b_data) / N_FATS;
-	if (fmt == FS_FAT32) {		/* FAT32: Move FAT offset */
-		n_rsv += n;
-		b_fat += n;
-	} else {					/* FAT12/16: Expand FAT size */
-		n_fat += n;
-	}
+	/* Align FAT and data start sectors to erase block boundaries, as the SD card formatter does */
+	n = (b_fat + n_blk - 1) / n_blk * n_blk - b_fat;	/* Move FAT offset to the next erase block */
+	n_rsv += n;
+	b_fat += n;
+	b_data = b_fat + n_fat * N_FATS + n_dir;
+	n = (b_data + n_blk - 1) / n_blk * n_blk - b_data;	/* Expand FAT size up to the next erase block */
+	n_fat += n / N_FATS;
+	b_dir = b_fat + n_fat * N_FATS;
+	b_data = b_dir + n_dir;
+	if (n_vol < b_data + au - b_vol) return FR_MKFS_ABORTED;	/* Too small volume for the alignment */
 
 	/* Determine number of clusters and final check of validity of the FAT sub-type */
 	n_clst = (n_vol - n_rsv - n_fat * N_FATS - n_dir) / au;
@@ -4188,15 +5162,16 @@ FRESULT f_mkfs (
 		} else {	/* Create partition table (FDISK) */
 			mem_set(fs->win, 0, SS(fs));
 			tbl = fs->win + MBR_Table;	/* Create partition table for single partition in the drive */
-			tbl[1] = 1;						/* Partition start head */
-			tbl[2] = 1;						/* Partition start sector */
-			tbl[3] = 0;						/* Partition start cylinder */
+			n = b_vol / 63 / 255;
+			tbl[1] = (BYTE)(b_vol / 63 % 255);	/* Partition start head */
+			tbl[2] = (BYTE)(n >> 2 | (b_vol % 63 + 1));	/* Partition start sector */
+			tbl[3] = (BYTE)n;				/* Partition start cylinder */
 			tbl[4] = sys;					/* System type */
 			tbl[5] = 254;					/* Partition end head */
 			n = (b_vol + n_vol) / 63 / 255;
 			tbl[6] = (BYTE)(n >> 2 | 63);	/* Partition end sector */
 			tbl[7] = (BYTE)n;				/* End cylinder */
-			ST_DWORD(tbl + 8, 63);			/* Partition start in LBA */
+			ST_DWORD(tbl + 8, b_vol);		/* Partition start in LBA */
 			ST_DWORD(tbl + 12, n_vol);		/* Partition size in LBA */
 			ST_WORD(fs->win + BS_55AA, 0xAA55);	/* MBR signature */
 			if (disk_write(pdrv, fs->win, 0, 1) != RES_OK)	/* Write it to the MBR */
@@ -4205,6 +5180,11 @@ FRESULT f_mkfs (
 		}
 	}
 
+#if _USE_TRIM	/* Erase the system area and the FAT32 root directory, no need to write zeros there when it reads as zeros */
+	eb[0] = b_vol; eb[1] = b_data + ((fmt == FS_FAT32) ? au : 0) - 1;
+	if (disk_ioctl(pdrv, SECTOR_ERASE, eb) == RES_OK) ez = 1;
+#endif
+
 	/* Create BPB in the VBR */
 	tbl = fs->win;							/* Clear sector */
 	mem_set(tbl, 0, SS(fs));
@@ -4266,16 +5246,18 @@ FRESULT f_mkfs (
 			return FR_DISK_ERR;
 		mem_set(tbl, 0, SS(fs));			/* Fill following FAT entries with zero */
 		for (n = 1; n < n_fat; n++) {		/* This loop may take a time on FAT32 volume due to many single sector writes */
-			if (disk_write(pdrv, tbl, wsect++, 1) != RES_OK)
+			if (!ez && disk_write(pdrv, tbl, wsect, 1) != RES_OK)
 				return FR_DISK_ERR;
+			wsect++;
 		}
 	}
 
 	/* Initialize root directory */
 	i = (fmt == FS_FAT32) ? au : (UINT)n_dir;
 	do {
-		if (disk_write(pdrv, tbl, wsect++, 1) != RES_OK)
+		if (!ez && disk_write(pdrv, tbl, wsect, 1) != RES_OK)
 			return FR_DISK_ERR;
+		wsect++;
 	} while (--i);
 
 #if _USE_TRIM	/* Erase data area if needed */
@@ -4678,6 +5660,194 @@ int f_printf (
 
 
 
+#if _FS_MINIMIZE <= 1
+/*-----------------------------------------------------------------------*/
+/* Directory Entry Location Access                                       */
+/*-----------------------------------------------------------------------*/
+/* These let an object be found again from where its directory entry is, */
+/* without following the path from the root. The location is only valid */
+/* as long as the directory is not changed.                              */
+
+static
+FRESULT seek_loc (
+	DIR* dp,			/* Directory object to use, dp->fs set */
+	const FILLOC* loc	/* Location of the entry */
+)
+{
+	FRESULT res;
+	WORD idx;
+
+
+	if (!dp->fs || !dp->fs->fs_type) return FR_NOT_ENABLED;
+	dp->sclust = loc->dclust;
+	res = dir_sdi(dp, loc->index);
+	if (res == FR_OK) res = dir_read(dp, 0);
+#if _USE_LFN
+	idx = (dp->lfn_idx != 0xFFFF) ? dp->lfn_idx : dp->index;
+#else
+	idx = dp->index;
+#endif
+	if (res == FR_OK && idx != loc->index) res = FR_NO_FILE;	/* Entry was removed */
+	return res;
+}
+
+
+
+FRESULT f_readdir_loc (
+	DIR* dp,			/* Pointer to the open directory object */
+	FILINFO* fno,		/* Pointer to file information to return */
+	FILLOC* loc			/* Pointer to the entry location to return */
+)
+{
+	FRESULT res;
+	DEFINE_NAMEBUF;
+
+
+	res = validate(dp);						/* Check validity of the object */
+	if (res == FR_OK) {
+		INIT_BUF(*dp);
+		res = dir_read(dp, 0);				/* Read an item */
+		if (res == FR_NO_FILE) {			/* Reached end of directory */
+			dp->sect = 0;
+			fno->fname[0] = 0;
+			res = FR_OK;
+		} else if (res == FR_OK) {			/* A valid entry is found */
+			get_fileinfo(dp, fno);
+			loc->dclust = dp->sclust;
+#if _USE_LFN
+			loc->index = (dp->lfn_idx != 0xFFFF) ? dp->lfn_idx : dp->index;
+#else
+			loc->index = dp->index;
+#endif
+			loc->sclust = ld_clust(dp->fs, dp->dir);
+			res = dir_next(dp, 0);			/* Increment index for next */
+			if (res == FR_NO_FILE) {
+				dp->sect = 0;
+				res = FR_OK;
+			}
+		}
+		FREE_BUF();
+	}
+
+	LEAVE_FF(dp->fs, res);
+}
+
+
+
+FRESULT f_opendir_loc (
+	DIR* dp,			/* Pointer to directory object to create */
+	FATFS* fs,			/* Volume holding the directory */
+	const FILLOC* loc	/* Location of the entry of the directory (0:root) */
+)
+{
+	FRESULT res;
+
+
+	if (!dp) return FR_INVALID_OBJECT;
+	if (!fs || !fs->fs_type) return FR_NOT_ENABLED;
+	ENTER_FF(fs);
+	dp->fs = fs;
+	dp->sclust = loc ? loc->sclust : 0;	/* The entry itself need not be read */
+	dp->id = fs->id;
+	res = dir_sdi(dp, 0);
+#if _FS_LOCK
+	if (res == FR_OK) {
+		if (dp->sclust) {
+			dp->lockid = inc_lock(dp, 0);	/* Lock the sub directory */
+			if (!dp->lockid)
+				res = FR_TOO_MANY_OPEN_FILES;
+		} else {
+			dp->lockid = 0;
+		}
+	}
+#endif
+	if (res != FR_OK) dp->fs = 0;
+
+	LEAVE_FF(fs, res);
+}
+
+
+
+FRESULT f_stat_loc (
+	FATFS* fs,			/* Volume holding the object */
+	const FILLOC* loc,	/* Location of the directory entry */
+	FILINFO* fno		/* Pointer to file information to return */
+)
+{
+	FRESULT res;
+	DIR dj;
+	DEFINE_NAMEBUF;
+
+
+	if (!fs || !fs->fs_type) return FR_NOT_ENABLED;
+	ENTER_FF(fs);
+	dj.fs = fs;
+	INIT_BUF(dj);
+	res = seek_loc(&dj, loc);
+	if (res == FR_OK && ld_clust(fs, dj.dir) != loc->sclust) res = FR_NO_FILE;	/* Another object took the place of the entry */
+	if (res == FR_OK && fno) get_fileinfo(&dj, fno);
+	FREE_BUF();
+
+	LEAVE_FF(fs, res);
+}
+
+
+
+FRESULT f_open_loc (
+	FIL* fp,			/* Pointer to the blank file object */
+	FATFS* fs,			/* Volume holding the file */
+	const FILLOC* loc	/* Location of the directory entry */
+)
+{
+	FRESULT res;
+	DIR dj;
+	BYTE *dir;
+	DEFINE_NAMEBUF;
+
+
+	if (!fp) return FR_INVALID_OBJECT;
+	fp->fs = 0;
+	if (!fs || !fs->fs_type) return FR_NOT_ENABLED;
+	ENTER_FF(fs);
+	dj.fs = fs;
+	INIT_BUF(dj);
+	res = seek_loc(&dj, loc);
+	FREE_BUF();
+	dir = dj.dir;
+	if (res == FR_OK && (dir[DIR_Attr] & AM_DIR)) res = FR_NO_FILE;
+#if _FS_LOCK
+	if (res == FR_OK) res = chk_lock(&dj, 0);
+#endif
+	if (res == FR_OK) {
+#if !_FS_READONLY
+		fp->dir_sect = fs->winsect;			/* Pointer to the directory entry */
+		fp->dir_ptr = dir;
+#endif
+#if _FS_LOCK
+		fp->lockid = inc_lock(&dj, 0);
+		if (!fp->lockid) res = FR_INT_ERR;
+#endif
+	}
+	if (res == FR_OK) {
+		fp->flag = FA_READ;
+		fp->err = 0;
+		fp->sclust = ld_clust(fs, dir);
+		fp->fsize = LD_DWORD(dir + DIR_FileSize);
+		fp->fptr = 0;
+		fp->dsect = 0;
+#if _USE_FASTSEEK
+		fp->cltbl = 0;
+#endif
+		fp->fs = fs;
+		fp->id = fs->id;
+	}
+
+	LEAVE_FF(fs, res);
+}
+#endif /* _FS_MINIMIZE <= 1 */
+
+
+
 DWORD sect2clust (FATFS* fs, DWORD sect)
 {
     if (sect < fs->database) {
@@ -104,6 +104,11 @@ typedef struct {
 	DWORD	dirbase;		/* Root directory start sector (FAT32:Cluster#) */
 	DWORD	database;		/* Data start sector */
 	DWORD	winsect;		/* Current sector appearing in the win[] */
+#if _USE_FREEMAP && !_FS_READONLY
+	DWORD	fmap_scan;		/* Free cluster map: first cluster not yet counted (0:no map, n_fatent:complete) */
+	BYTE	fmap_shift;		/* Free cluster map: 2^fmap_shift clusters per group */
+	WORD	fmap[_FREEMAP_SIZE];	/* Free cluster map: free clusters per group */
+#endif
 	BYTE	win[_MAX_SS];	/* Disk access window for Directory, FAT (and file data at tiny cfg) */
 } FATFS;
 
@@ -182,6 +187,16 @@ typedef struct {
 
 
 
+/* Directory entry location (FILLOC) */
+
+typedef struct {
+	DWORD	dclust;			/* Start cluster of the directory holding the entry (0:root) */
+	DWORD	sclust;			/* Start cluster of the object itself */
+	WORD	index;			/* Index of the first entry of the object (LFN or SFN) */
+} FILLOC;
+
+
+
 /* File function return code (FRESULT) */
 
 typedef enum {
@@ -219,6 +234,7 @@ FRESULT f_write (FIL* fp, const void* buff, UINT btw, UINT* bw);	/* Write data t
 FRESULT f_forward (FIL* fp, UINT(*func)(const BYTE*,UINT), UINT btf, UINT* bf);	/* Forward data to the stream */
 FRESULT f_lseek (FIL* fp, DWORD ofs);								/* Move file pointer of a file object */
 FRESULT f_truncate (FIL* fp);										/* Truncate file */
+FRESULT f_expand (FIL* fp, DWORD fsz, BYTE opt);					/* Allocate a contiguous block to the file */
 FRESULT f_sync (FIL* fp);											/* Flush cached data of a writing file */
 FRESULT f_opendir (DIR* dp, const TCHAR* path);						/* Open a directory */
 FRESULT f_closedir (DIR* dp);										/* Close an open directory */
@@ -235,6 +251,7 @@ FRESULT f_chdir (const TCHAR* path);								/* Change current directory */
 FRESULT f_chdrive (const TCHAR* path);								/* Change current drive */
 FRESULT f_getcwd (TCHAR* buff, UINT len);							/* Get current directory */
 FRESULT f_getfree (const TCHAR* path, DWORD* nclst, FATFS** fatfs);	/* Get number of free clusters on the drive */
+FRESULT f_freemap (const TCHAR* path, UINT nsect, DWORD* left);		/* Count free clusters of the drive in steps */
 FRESULT f_getlabel (const TCHAR* path, TCHAR* label, DWORD* vsn);	/* Get volume label */
 FRESULT f_setlabel (const TCHAR* label);							/* Set volume label */
 FRESULT f_mount (FATFS* fs, const TCHAR* path, BYTE opt);			/* Mount/Unmount a logical drive */
@@ -259,6 +276,11 @@ TCHAR* f_gets (TCHAR* buff, int len, FIL* fp);						/* Get a string from the fil
 DWORD sect2clust (FATFS* fs, DWORD sect);
 DWORD find_sclust (FATFS* fs, DWORD clst);
 
+FRESULT f_readdir_loc (DIR* dp, FILINFO* fno, FILLOC* loc);		/* Read a directory item and the location of its entry */
+FRESULT f_opendir_loc (DIR* dp, FATFS* fs, const FILLOC* loc);	/* Open a directory by the location of its entry (0:root) */
+FRESULT f_stat_loc (FATFS* fs, const FILLOC* loc, FILINFO* fno);	/* Get file status from an entry location */
+FRESULT f_open_loc (FIL* fp, FATFS* fs, const FILLOC* loc);		/* Open a file for reading from an entry location */
+
 
 
 /*--------------------------------------------------------------*/
@@ -306,6 +328,7 @@ int ff_del_syncobj (_SYNC_t sobj);				/* Delete a sync object */
 #define	FA_OPEN_ALWAYS		0x10
 #define FA__WRITTEN			0x20
 #define FA__DIRTY			0x40
+#define FA__CONTIG			0x80
 #endif
 
 
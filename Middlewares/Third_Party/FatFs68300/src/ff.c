@@ -1965,6 +1965,8 @@ void get_xdir_info (
 	fno->fsize = (fno->fattrib & AM_DIR) ? 0 : ld_qword(dirb + XDIR_FileSize);	/* Size */
 	fno->ftime = ld_word(dirb + XDIR_ModTime + 0);	/* Time */
 	fno->fdate = ld_word(dirb + XDIR_ModTime + 2);	/* Date */
+	fno->fctime = ld_word(dirb + XDIR_CrtTime + 0);	/* Created time */
+	fno->fcdate = ld_word(dirb + XDIR_CrtTime + 2);	/* Created date */
 }
 
 #endif	/* _FS_MINIMIZE <= 1 || _FS_RPATH >= 2 */
@@ -2531,6 +2533,8 @@ void get_fileinfo (		/* No return code */
 	fno->fsize = ld_dword(dp->dir + DIR_FileSize);	/* Size */
 	tm = ld_dword(dp->dir + DIR_ModTime);			/* Timestamp */
 	fno->ftime = (WORD)tm; fno->fdate = (WORD)(tm >> 16);
+	tm = ld_dword(dp->dir + DIR_CrtTime);			/* Created timestamp */
+	fno->fctime = (WORD)tm; fno->fcdate = (WORD)(tm >> 16);
 }
 
 #endif /* _FS_MINIMIZE <= 1 || _FS_RPATH >= 2 */
@@ -3450,6 +3454,7 @@ FRESULT f_open (
 				fp->obj.sclust = ld_dword(fs->dirbuf + XDIR_FstClus);	/* Get object allocation info */
 				fp->obj.objsize = ld_qword(fs->dirbuf + XDIR_FileSize);
 				fp->obj.stat = fs->dirbuf[XDIR_GenFlags] & 2;
+				fp->obj.n_frag = 0;		/* No fragment pending, f_lseek() would flush a stale count */
 			} else
 #endif
 			{
@@ -4336,6 +4341,248 @@ FRESULT f_readdir (
 
 
 
+/*-----------------------------------------------------------------------*/
+/* Directory Entry Location Access                                       */
+/*-----------------------------------------------------------------------*/
+/* These let an object be found again from where its directory entry is, */
+/* without following the path from the root. The location is only valid */
+/* as long as the directory is not changed. On exFAT the location also   */
+/* carries the size and chain status of the directory holding the entry, */
+/* a contiguous directory cannot be followed without them.               */
+
+static
+DWORD loc_index (	/* Index of the first entry of the object */
+	DIR* dp			/* Directory object pointing the object */
+)
+{
+#if _USE_LFN != 0
+	if (dp->blk_ofs != 0xFFFFFFFF) return dp->blk_ofs / SZDIRE;	/* LFN or exFAT entry block */
+#endif
+	return dp->dptr / SZDIRE;
+}
+
+
+static
+FRESULT seek_loc (
+	DIR* dp,			/* Directory object to use, dp->obj.fs and name buffers set */
+	const FILLOC* loc	/* Location of the entry */
+)
+{
+	FRESULT res;
+
+
+	dp->obj.sclust = loc->dclust;
+#if _FS_EXFAT
+	dp->obj.stat = (BYTE)loc->dsize;
+	dp->obj.objsize = loc->dsize & 0xFFFFFF00;
+#endif
+	res = dir_sdi(dp, loc->index * SZDIRE);
+	if (res == FR_OK) res = dir_read(dp, 0);
+	if (res == FR_OK && loc_index(dp) != loc->index) res = FR_NO_FILE;	/* Entry was removed */
+	return res;
+}
+
+
+
+FRESULT f_readdir_loc (
+	DIR* dp,			/* Pointer to the open directory object */
+	FILINFO* fno,		/* Pointer to file information to return */
+	FILLOC* loc			/* Pointer to the entry location to return */
+)
+{
+	FRESULT res;
+	FATFS *fs;
+	DEF_NAMBUF
+
+
+	res = validate(&dp->obj, &fs);	/* Check validity of the directory object */
+	if (res == FR_OK) {
+		INIT_NAMBUF(fs);
+		res = dir_read(dp, 0);			/* Read an item */
+		if (res == FR_NO_FILE) res = FR_OK;	/* Ignore end of directory */
+		if (res == FR_OK) {				/* A valid entry is found */
+			get_fileinfo(dp, fno);		/* Get the object information */
+			if (dp->sect) {
+				loc->dclust = dp->obj.sclust;
+				loc->index = loc_index(dp);
+#if _FS_EXFAT
+				if (fs->fs_type == FS_EXFAT) {
+					loc->dsize = ((DWORD)dp->obj.objsize & 0xFFFFFF00) | dp->obj.stat;
+					loc->sclust = ld_dword(fs->dirbuf + XDIR_FstClus);
+				} else
+#endif
+				{
+					loc->sclust = ld_clust(fs, dp->dir);
+				}
+			}
+			res = dir_next(dp, 0);		/* Increment index for next */
+			if (res == FR_NO_FILE) res = FR_OK;	/* Ignore end of directory now */
+		}
+		FREE_NAMBUF();
+	}
+	LEAVE_FF(fs, res);
+}
+
+
+
+FRESULT f_opendir_loc (
+	DIR* dp,			/* Pointer to directory object to create */
+	FATFS* fs,			/* Volume holding the directory */
+	const FILLOC* loc	/* Location of the entry of the directory (0:root) */
+)
+{
+	FRESULT res = FR_OK;
+	_FDID *obj;
+#if _FS_EXFAT
+	DEF_NAMBUF
+#endif
+
+
+	if (!dp) return FR_INVALID_OBJECT;
+	obj = &dp->obj;
+	obj->fs = 0;
+	if (!fs || !fs->fs_type) return FR_NOT_ENABLED;
+	ENTER_FF(fs);
+	obj->fs = fs;
+	obj->sclust = loc ? loc->sclust : 0;	/* On FAT the entry itself need not be read */
+#if _FS_EXFAT
+	if (loc && fs->fs_type == FS_EXFAT) {	/* exFAT: size and chain status are in the entry */
+		INIT_NAMBUF(fs);
+		res = seek_loc(dp, loc);
+		if (res == FR_OK && (!(obj->attr & AM_DIR) || ld_dword(fs->dirbuf + XDIR_FstClus) != loc->sclust)) {
+			res = FR_NO_PATH;			/* Another object took the place of the entry */
+		}
+		if (res == FR_OK) {
+			obj->c_scl = obj->sclust;							/* Get containing directory inforamation */
+			obj->c_size = ((DWORD)obj->objsize & 0xFFFFFF00) | obj->stat;
+			obj->c_ofs = dp->blk_ofs;
+			obj->sclust = ld_dword(fs->dirbuf + XDIR_FstClus);	/* Get object allocation info */
+			obj->objsize = ld_qword(fs->dirbuf + XDIR_FileSize);
+			obj->stat = fs->dirbuf[XDIR_GenFlags] & 2;
+		}
+		FREE_NAMBUF();
+	}
+#endif
+	if (res == FR_OK) {
+		obj->id = fs->id;
+		res = dir_sdi(dp, 0);			/* Rewind directory */
+#if _FS_LOCK != 0
+		if (res == FR_OK) {
+			if (obj->sclust) {
+				obj->lockid = inc_lock(dp, 0);	/* Lock the sub directory */
+				if (!obj->lockid) res = FR_TOO_MANY_OPEN_FILES;
+			} else {
+				obj->lockid = 0;	/* Root directory need not to be locked */
+			}
+		}
+#endif
+	}
+	if (res != FR_OK) obj->fs = 0;		/* Invalidate the directory object if function faild */
+
+	LEAVE_FF(fs, res);
+}
+
+
+
+FRESULT f_stat_loc (
+	FATFS* fs,			/* Volume holding the object */
+	const FILLOC* loc,	/* Location of the directory entry */
+	FILINFO* fno		/* Pointer to file information to return */
+)
+{
+	FRESULT res;
+	DIR dj;
+	DEF_NAMBUF
+
+
+	if (!fs || !fs->fs_type) return FR_NOT_ENABLED;
+	ENTER_FF(fs);
+	dj.obj.fs = fs;
+	INIT_NAMBUF(fs);
+	res = seek_loc(&dj, loc);
+	if (res == FR_OK) {					/* Another object may have taken the place of the entry */
+#if _FS_EXFAT
+		if (fs->fs_type == FS_EXFAT) {
+			if (ld_dword(fs->dirbuf + XDIR_FstClus) != loc->sclust) res = FR_NO_FILE;
+		} else
+#endif
+		{
+			if (ld_clust(fs, dj.dir) != loc->sclust) res = FR_NO_FILE;
+		}
+	}
+	if (res == FR_OK && fno) get_fileinfo(&dj, fno);
+	FREE_NAMBUF();
+
+	LEAVE_FF(fs, res);
+}
+
+
+
+FRESULT f_open_loc (
+	FIL* fp,			/* Pointer to the blank file object */
+	FATFS* fs,			/* Volume holding the file */
+	const FILLOC* loc	/* Location of the directory entry */
+)
+{
+	FRESULT res;
+	DIR dj;
+	DEF_NAMBUF
+
+
+	if (!fp) return FR_INVALID_OBJECT;
+	fp->obj.fs = 0;
+	if (!fs || !fs->fs_type) return FR_NOT_ENABLED;
+	ENTER_FF(fs);
+	dj.obj.fs = fs;
+	INIT_NAMBUF(fs);
+	res = seek_loc(&dj, loc);
+	if (res == FR_OK && (dj.obj.attr & AM_DIR)) res = FR_NO_FILE;
+#if _FS_LOCK != 0
+	if (res == FR_OK) res = chk_lock(&dj, 0);
+#endif
+	if (res == FR_OK) {
+#if !_FS_READONLY
+		fp->dir_sect = fs->winsect;			/* Pointer to the directory entry */
+		fp->dir_ptr = dj.dir;
+#endif
+#if _FS_LOCK != 0
+		fp->obj.lockid = inc_lock(&dj, 0);
+		if (!fp->obj.lockid) res = FR_INT_ERR;
+#endif
+	}
+	if (res == FR_OK) {
+#if _FS_EXFAT
+		if (fs->fs_type == FS_EXFAT) {
+			fp->obj.c_scl = dj.obj.sclust;							/* Get containing directory info */
+			fp->obj.c_size = ((DWORD)dj.obj.objsize & 0xFFFFFF00) | dj.obj.stat;
+			fp->obj.c_ofs = dj.blk_ofs;
+			fp->obj.sclust = ld_dword(fs->dirbuf + XDIR_FstClus);	/* Get object allocation info */
+			fp->obj.objsize = ld_qword(fs->dirbuf + XDIR_FileSize);
+			fp->obj.stat = fs->dirbuf[XDIR_GenFlags] & 2;
+			fp->obj.n_frag = 0;
+		} else
+#endif
+		{
+			fp->obj.sclust = ld_clust(fs, dj.dir);					/* Get object allocation info */
+			fp->obj.objsize = ld_dword(dj.dir + DIR_FileSize);
+		}
+#if _USE_FASTSEEK
+		fp->cltbl = 0;			/* Disable fast seek mode */
+#endif
+		fp->obj.fs = fs;	 	/* Validate the file object */
+		fp->obj.id = fs->id;
+		fp->flag = FA_READ;		/* Set file access mode */
+		fp->err = 0;			/* Clear error flag */
+		fp->sect = 0;			/* Invalidate current data sector */
+		fp->fptr = 0;			/* Set file pointer top of the file */
+	}
+	FREE_NAMBUF();
+
+	LEAVE_FF(fs, res);
+}
+
+
+
 #if _USE_FIND
 /*-----------------------------------------------------------------------*/
 /* Find Next File                                                        */
@@ -4933,11 +5180,13 @@ FRESULT f_utime (
 #if _FS_EXFAT
 			if (fs->fs_type == FS_EXFAT) {
 				st_dword(fs->dirbuf + XDIR_ModTime, (DWORD)fno->fdate << 16 | fno->ftime);
+				st_dword(fs->dirbuf + XDIR_CrtTime, (DWORD)fno->fcdate << 16 | fno->fctime);
 				res = store_xdir(&dj);
 			} else
 #endif
 			{
 				st_dword(dj.dir + DIR_ModTime, (DWORD)fno->fdate << 16 | fno->ftime);
+				st_dword(dj.dir + DIR_CrtTime, (DWORD)fno->fcdate << 16 | fno->fctime);
 				fs->wflag = 1;
 			}
 			if (res == FR_OK) {
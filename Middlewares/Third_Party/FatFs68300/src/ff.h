@@ -196,6 +196,8 @@ typedef struct {
 
 typedef struct {
 	FSIZE_t	fsize;			/* File size */
+	WORD	fcdate;			/* Created date */
+	WORD	fctime;			/* Created time */
 	WORD	fdate;			/* Modified date */
 	WORD	ftime;			/* Modified time */
 	BYTE	fattrib;		/* File attribute */
@@ -209,6 +211,19 @@ typedef struct {
 
 
 
+/* Directory entry location (FILLOC) */
+
+typedef struct {
+	DWORD	dclust;			/* Start cluster of the directory holding the entry (0:root) */
+	DWORD	sclust;			/* Start cluster of the object itself */
+	DWORD	index;			/* Index of the first entry of the object (LFN or SFN, exFAT: 85 entry) */
+#if _FS_EXFAT
+	DWORD	dsize;			/* exFAT: b31-b8:Size of the directory holding the entry, b7-b0:Its chain status */
+#endif
+} FILLOC;
+
+
+
 /* File function return code (FRESULT) */
 
 typedef enum {
@@ -274,6 +289,11 @@ int f_puts (const TCHAR* str, FIL* cp);								/* Put a string to the file */
 int f_printf (FIL* fp, const TCHAR* str, ...);						/* Put a formatted string to the file */
 TCHAR* f_gets (TCHAR* buff, int len, FIL* fp);						/* Get a string from the file */
 
+FRESULT f_readdir_loc (DIR* dp, FILINFO* fno, FILLOC* loc);		/* Read a directory item and the location of its entry */
+FRESULT f_opendir_loc (DIR* dp, FATFS* fs, const FILLOC* loc);	/* Open a directory by the location of its entry (0:root) */
+FRESULT f_stat_loc (FATFS* fs, const FILLOC* loc, FILINFO* fno);	/* Get file status from an entry location */
+FRESULT f_open_loc (FIL* fp, FATFS* fs, const FILLOC* loc);		/* Open a file for reading from an entry location */
+
 #define f_eof(fp) ((int)((fp)->fptr == (fp)->obj.objsize))
 #define f_error(fp) ((fp)->err)
 #define f_tell(fp) ((fp)->fptr)
@@ -34,17 +34,20 @@
 
 /**
   * @brief  Disk IO Driver structure definition
+  * @note   Without the lun argument, as the drivers in FATFS/Target are
+  *         written for the R0.11 interface. The disk_* functions are in
+  *         Core/Src/vfs_conf.c, diskio.c of this core is not built.
   */
 typedef struct
 {
-  DSTATUS (*disk_initialize) (BYTE);                     /*!< Initialize Disk Drive                     */
-  DSTATUS (*disk_status)     (BYTE);                     /*!< Get Disk Status                           */
-  DRESULT (*disk_read)       (BYTE, BYTE*, DWORD, UINT);       /*!< Read Sector(s)                            */
+  DSTATUS (*disk_initialize) (void);                     /*!< Initialize Disk Drive                     */
+  DSTATUS (*disk_status)     (void);                     /*!< Get Disk Status                           */
+  DRESULT (*disk_read)       (BYTE*, DWORD, UINT);       /*!< Read Sector(s)                            */
 #if _USE_WRITE == 1
-  DRESULT (*disk_write)      (BYTE, const BYTE*, DWORD, UINT); /*!< Write Sector(s) when _USE_WRITE = 0       */
+  DRESULT (*disk_write)      (const BYTE*, DWORD, UINT); /*!< Write Sector(s) when _USE_WRITE = 0       */
 #endif /* _USE_WRITE == 1 */
 #if _USE_IOCTL == 1
-  DRESULT (*disk_ioctl)      (BYTE, BYTE, void*);              /*!< I/O control operation when _USE_IOCTL = 1 */
+  DRESULT (*disk_ioctl)      (BYTE, void*);              /*!< I/O control operation when _USE_IOCTL = 1 */
 #endif /* _USE_IOCTL == 1 */
 
 }Diskio_drvTypeDef;
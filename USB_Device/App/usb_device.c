@@ -73,7 +73,7 @@ void MX_USB_Device_Init(void)
   /* Init Device Library, add supported class and start the library. */
   USBD_Init(&hUsbDeviceFS, &MSC_Desc, DEVICE_FS);
 
-#if 0
+#if USBD_USE_MSC
   USBD_RegisterClass(&hUsbDeviceFS, &USBD_MSC);
   USBD_MSC_RegisterStorage(&hUsbDeviceFS, &USBD_Storage_Interface_fops_FS);
 #else
@@ -23,6 +23,9 @@
 
 /* USER CODE BEGIN INCLUDE */
 #include "main.h"
+#include "ff_gen_drv.h"
+#include "sd_diskio.h"
+#include "vfs_conf.h"
 /* USER CODE END INCLUDE */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -50,6 +53,14 @@
   */
 
 /* USER CODE BEGIN PRIVATE_TYPES */
+/* Asynchronous read, completed by the SD interrupt and delivered in the USB interrupt */
+typedef struct
+{
+  USBD_StorageDoneTypeDef done;
+  void *ctx;
+  volatile int8_t status;
+  volatile uint8_t complete;
+} STORAGE_Request_t;
 
 /* USER CODE END PRIVATE_TYPES */
 
@@ -62,12 +73,16 @@
   * @{
   */
 
-#define STORAGE_LUN_NBR                  1
+#define STORAGE_LUN_NBR                  2
 #define STORAGE_BLK_NBR                  0x10000
 #define STORAGE_BLK_SIZ                  0x200
 
 /* USER CODE BEGIN PRIVATE_DEFINES */
 #define BSP_ERROR_NONE 0
+#define STORAGE_TIMEOUT                  1000   /* ms */
+#define STORAGE_QUEUE_SIZE               4
+#define STORAGE_LUN_SD                   0
+#define STORAGE_LUN_FIXED                1      /* NOR flash, see vfs_conf.h */
 /* USER CODE END PRIVATE_DEFINES */
 
 /**
@@ -80,6 +95,16 @@
   */
 
 /* USER CODE BEGIN PRIVATE_MACRO */
+/* Disk driver of the fixed LUN, the same as its FatFs drive */
+#if USE_SPIFLASH
+#define FIXED_initialize                 SPIFLASH_initialize
+#define FIXED_status                     SPIFLASH_status
+#define FIXED_read                       SPIFLASH_read
+#define FIXED_write                      SPIFLASH_write
+#define FIXED_ioctl                      SPIFLASH_ioctl
+#define FIXED_sectors                    ftl_sectors
+#define FIXED_SECTOR_SIZE                FTL_SECTOR_SIZE
+#endif
 
 /* USER CODE END PRIVATE_MACRO */
 
@@ -108,11 +133,28 @@ const int8_t STORAGE_Inquirydata_FS[] = {/* 36 */
   'S', 'T', 'M', ' ', ' ', ' ', ' ', ' ', /* Manufacturer : 8 bytes */
   'P', 'r', 'o', 'd', 'u', 'c', 't', ' ', /* Product      : 16 Bytes */
   ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ',
+  '0', '.', '0' ,'1',                     /* Version      : 4 Bytes */
+
+  /* LUN 1 */
+  0x00,
+  0x00,
+  0x02,
+  0x02,
+  (STANDARD_INQUIRY_DATA_LEN - 5),
+  0x00,
+  0x00,
+  0x00,
+  'S', 'T', 'M', ' ', ' ', ' ', ' ', ' ', /* Manufacturer : 8 bytes */
+  'N', 'O', 'R', ' ', 'f', 'l', 'a', 's', /* Product      : 16 Bytes */
+  'h', ' ', ' ', ' ', ' ', ' ', ' ', ' ',
   '0', '.', '0' ,'1'                      /* Version      : 4 Bytes */
 };
 /* USER CODE END INQUIRY_DATA_FS */
 
 /* USER CODE BEGIN PRIVATE_VARIABLES */
+static STORAGE_Request_t Requests[STORAGE_QUEUE_SIZE];
+static uint8_t RequestHead;
+static uint8_t RequestCount;
 
 /* USER CODE END PRIVATE_VARIABLES */
 
@@ -149,6 +191,11 @@ static int8_t STORAGE_Write_FS(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uin
 static int8_t STORAGE_GetMaxLun_FS(void);
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_DECLARATION */
+static int8_t STORAGE_ReadAsync_FS(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len,
+                                   USBD_StorageDoneTypeDef done, void *ctx);
+static void STORAGE_SdDone(void *ctx, DRESULT res);
+static int8_t STORAGE_Sync_FS(uint8_t lun);
+static int8_t STORAGE_Unmap_FS(uint8_t lun, uint32_t blk_addr, uint32_t blk_len);
 
 /* USER CODE END PRIVATE_FUNCTIONS_DECLARATION */
 
@@ -165,7 +212,10 @@ USBD_StorageTypeDef USBD_Storage_Interface_fops_FS =
   STORAGE_Read_FS,
   STORAGE_Write_FS,
   STORAGE_GetMaxLun_FS,
-  (int8_t *)STORAGE_Inquirydata_FS
+  (int8_t *)STORAGE_Inquirydata_FS,
+  STORAGE_ReadAsync_FS,
+  STORAGE_Sync_FS,
+  STORAGE_Unmap_FS
 };
 
 /* Private functions ---------------------------------------------------------*/
@@ -177,7 +227,16 @@ USBD_StorageTypeDef USBD_Storage_Interface_fops_FS =
 int8_t STORAGE_Init_FS(uint8_t lun)
 {
   /* USER CODE BEGIN 2 */
-  BSP_SD_Init(0);
+#ifdef FIXED_initialize
+  if(lun == STORAGE_LUN_FIXED)
+  {
+    FIXED_initialize();
+  }
+  else
+#endif
+  {
+    BSP_SD_Init(0);
+  }
   return (USBD_OK);
   /* USER CODE END 2 */
 }
@@ -195,6 +254,15 @@ int8_t STORAGE_GetCapacity_FS(uint8_t lun, uint32_t *block_num, uint16_t *block_
   HAL_SD_CardInfoTypeDef info;
   int8_t ret = 0;
 
+#ifdef FIXED_initialize
+  if(lun == STORAGE_LUN_FIXED)
+  {
+    *block_num = FIXED_sectors();
+    *block_size = FIXED_SECTOR_SIZE;
+    return (*block_num != 0) ? 0 : -1;
+  }
+#endif
+
   if (BSP_SD_GetCardInfo(0, &info) != BSP_ERROR_NONE)
   {
     ret = -1;
@@ -219,15 +287,28 @@ int8_t STORAGE_IsReady_FS(uint8_t lun)
   static int8_t prev_status = 0;
   int8_t ret = -1;
 
-  if(prev_status < 0)
+#ifdef FIXED_initialize
+  if(lun == STORAGE_LUN_FIXED)
   {
-    BSP_SD_Init(0);
-    prev_status = 0;
+    return (FIXED_status() & STA_NOINIT) ? -1 : 0;
   }
-  if(BSP_SD_GetCardState(0) == BSP_ERROR_NONE)
+#endif
+
+  /* Called for every command, it must not wait. A write still programming
+     is waited for by the next request to the card */
+  if(BSP_SD_IsDetected(0) == SD_PRESENT)
   {
+    if(prev_status < 0)
+    {
+      BSP_SD_Init(0);
+      prev_status = 0;
+    }
     ret = 0;
   }
+  else
+  {
+    prev_status = -1;
+  }
 
   return ret;
   /* USER CODE END 4 */
@@ -254,17 +335,17 @@ int8_t STORAGE_Read_FS(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t bl
 {
   /* USER CODE BEGIN 6 */
   int8_t ret = -1;
-  uint32_t timeout = 100000;
-  BSP_SD_ReadBlocks(0,(uint32_t *)buf, blk_addr, blk_len);
-  while(BSP_SD_GetCardState(0) != BSP_ERROR_NONE)
+
+#ifdef FIXED_initialize
+  if(lun == STORAGE_LUN_FIXED)
   {
-    if (timeout-- == 0)
-    {
-      return ret;
-    }
+    return (FIXED_read(buf, blk_addr, blk_len) == RES_OK) ? 0 : -1;
+  }
+#endif
+  if(SD_read(buf, blk_addr, blk_len) == RES_OK)
+  {
+    ret = 0;
   }
-  ret = 0;
-
   return ret;
   /* USER CODE END 6 */
 }
@@ -278,17 +359,17 @@ int8_t STORAGE_Write_FS(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t b
 {
   /* USER CODE BEGIN 7 */
   int8_t ret = -1;
-  uint32_t timeout = 100000;
-  BSP_SD_WriteBlocks(0,(uint32_t *)buf, blk_addr, blk_len);
-  while(BSP_SD_GetCardState(0) != BSP_ERROR_NONE)
+
+#ifdef FIXED_initialize
+  if(lun == STORAGE_LUN_FIXED)
   {
-    if (timeout-- == 0)
-    {
-      return ret;
-    }
+    return (FIXED_write(buf, blk_addr, blk_len) == RES_OK) ? 0 : -1;
+  }
+#endif
+  if(SD_write(buf, blk_addr, blk_len) == RES_OK)
+  {
+    ret = 0;
   }
-  ret = 0;
-
   return ret;
   /* USER CODE END 7 */
 }
@@ -301,11 +382,140 @@ int8_t STORAGE_Write_FS(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t b
 int8_t STORAGE_GetMaxLun_FS(void)
 {
   /* USER CODE BEGIN 8 */
+#ifdef FIXED_initialize
   return (STORAGE_LUN_NBR - 1);
+#else
+  return STORAGE_LUN_SD;
+#endif
   /* USER CODE END 8 */
 }
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_IMPLEMENTATION */
+/**
+  * @brief  Queues a multi-block read of the card, 'done' is called from
+  *         STORAGE_Complete_FS() when it finished.
+  * @param  lun: .
+  * @retval USBD_OK if the read was queued else USBD_FAIL
+  */
+static int8_t STORAGE_ReadAsync_FS(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len,
+                                   USBD_StorageDoneTypeDef done, void *ctx)
+{
+  STORAGE_Request_t *req;
+
+  if(RequestCount == STORAGE_QUEUE_SIZE)
+  {
+    return -1;
+  }
+  req = &Requests[(RequestHead + RequestCount) % STORAGE_QUEUE_SIZE];
+  req->done = done;
+  req->ctx = ctx;
+  req->complete = 0;
+
+#ifdef FIXED_initialize
+  if(lun == STORAGE_LUN_FIXED)
+  {
+    /* Done right away, delivered from the USB interrupt like the card reads */
+    req->status = (FIXED_read(buf, blk_addr, blk_len) == RES_OK) ? 0 : -1;
+    req->complete = 1;
+    RequestCount++;
+    HAL_NVIC_SetPendingIRQ(USB_FS_IRQn);
+    return 0;
+  }
+#endif
+  if(SD_Submit(buf, blk_addr, blk_len, SD_READ, STORAGE_SdDone, req) != RES_OK)
+  {
+    return -1;
+  }
+  RequestCount++;
+  return 0;
+}
+
+/**
+  * @brief  SD completion, in SD interrupt context. Hands the request over
+  *         to the USB interrupt, where the MSC class runs.
+  */
+static void STORAGE_SdDone(void *ctx, DRESULT res)
+{
+  STORAGE_Request_t *req = (STORAGE_Request_t *)ctx;
+
+  req->status = (res == RES_OK) ? 0 : -1;
+  req->complete = 1;
+  HAL_NVIC_SetPendingIRQ(USB_FS_IRQn);
+}
+
+/**
+  * @brief  Waits until the card has programmed all written blocks.
+  * @param  lun: .
+  * @retval USBD_OK if all operations are OK else USBD_FAIL
+  */
+static int8_t STORAGE_Sync_FS(uint8_t lun)
+{
+  int8_t ret = -1;
+
+#ifdef FIXED_initialize
+  if(lun == STORAGE_LUN_FIXED)
+  {
+    /* Writes out the write back cache of the NOR flash */
+    return (FIXED_ioctl(CTRL_SYNC, NULL) == RES_OK) ? 0 : -1;
+  }
+#endif
+  if(SD_Flush(STORAGE_TIMEOUT) == RES_OK)
+  {
+    ret = 0;
+  }
+  return ret;
+}
+
+/**
+  * @brief  Erases the whole allocation units of the card within the blocks
+  *         the host released.
+  * @param  lun: .
+  * @retval USBD_OK if all operations are OK else USBD_FAIL
+  */
+static int8_t STORAGE_Unmap_FS(uint8_t lun, uint32_t blk_addr, uint32_t blk_len)
+{
+  int8_t ret = -1;
+
+#ifdef FIXED_initialize
+  if(lun == STORAGE_LUN_FIXED)
+  {
+    DWORD range[2] = {blk_addr, blk_addr + blk_len - 1};
+
+    return (FIXED_ioctl(CTRL_TRIM, range) == RES_OK) ? 0 : -1;
+  }
+#endif
+  if(SD_Trim(blk_addr, blk_len) == RES_OK)
+  {
+    ret = 0;
+  }
+  return ret;
+}
+
+/**
+  * @brief  Delivers the completed asynchronous reads, in order. To be called
+  *         from the USB interrupt handler.
+  * @param  None
+  * @retval None
+  */
+void STORAGE_Complete_FS(void)
+{
+  STORAGE_Request_t *req;
+  USBD_StorageDoneTypeDef done;
+  void *ctx;
+  int8_t status;
+
+  while(RequestCount && Requests[RequestHead].complete)
+  {
+    req = &Requests[RequestHead];
+    done = req->done;
+    ctx = req->ctx;
+    status = req->status;
+    req->complete = 0;
+    RequestHead = (RequestHead + 1) % STORAGE_QUEUE_SIZE;
+    RequestCount--;
+    done(ctx, status);
+  }
+}
 
 /* USER CODE END PRIVATE_FUNCTIONS_IMPLEMENTATION */
 
@@ -28,11 +28,23 @@
 #include "usbd_mtp.h"
 
 /* USER CODE BEGIN Includes */
-
+#include "mtp_trace.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
+/* USER CODE BEGIN PD */
+/* Packet memory of the USB FS device, buffer descriptor table included */
+#define PMA_SIZE              1024U
+/* One buffer descriptor table entry (ADDR_TX, COUNT_TX, ADDR_RX, COUNT_RX) per endpoint */
+#define PMA_BTABLE_ENTRY      8U
+/* Class whose endpoint list drives the PMA layout, must be the one registered in usb_device.c */
+#if USBD_USE_MSC
+#define PMA_CLASS             USBD_MSC
+#else
+#define PMA_CLASS             USBD_MTP
+#endif
+/* USER CODE END PD */
 /* Private macro -------------------------------------------------------------*/
 
 /* Private variables ---------------------------------------------------------*/
@@ -45,6 +57,85 @@ void Error_Handler(void);
 
 /* USER CODE BEGIN 0 */
 
+/**
+  * @brief  Take a buffer from the packet memory.
+  *         Receive buffers above 62 bytes are counted in 32 byte blocks.
+  * @param  next: Next free PMA offset
+  * @param  size: Buffer size (max packet size of the endpoint)
+  * @param  out: Non-zero for a receive buffer
+  * @retval PMA offset of the buffer
+  */
+static uint16_t PMA_Alloc(uint16_t *next, uint16_t size, uint8_t out)
+{
+  uint16_t addr = *next;
+
+  if ((out != 0U) && (size > 62U))
+  {
+    size = (size + 31U) & ~31U;
+  }
+  else
+  {
+    size = (size + 1U) & ~1U;
+  }
+
+  if ((uint32_t)addr + size > PMA_SIZE)
+  {
+    Error_Handler();
+  }
+  *next = addr + size;
+
+  return addr;
+}
+
+/**
+  * @brief  Assign PMA buffers to EP0 and to every endpoint of the class
+  *         configuration descriptor. Bulk endpoints get two buffers so the
+  *         next packet can be loaded while the host takes the current one.
+  * @param  hpcd: PCD handle
+  * @param  pConfDesc: Configuration descriptor of the class
+  * @retval None
+  */
+static void PMA_Layout(PCD_HandleTypeDef *hpcd, uint8_t *pConfDesc)
+{
+  USBD_ConfigDescTypeDef *desc = (USBD_ConfigDescTypeDef *)(void *)pConfDesc;
+  USBD_DescHeaderTypeDef *pdesc = (USBD_DescHeaderTypeDef *)(void *)pConfDesc;
+  uint16_t next = (uint16_t)(hpcd->Init.dev_endpoints * PMA_BTABLE_ENTRY);
+  uint16_t ptr = desc->bLength;
+
+  HAL_PCDEx_PMAConfig(hpcd, 0x00U, PCD_SNG_BUF, PMA_Alloc(&next, USB_MAX_EP0_SIZE, 1U));
+  HAL_PCDEx_PMAConfig(hpcd, 0x80U, PCD_SNG_BUF, PMA_Alloc(&next, USB_MAX_EP0_SIZE, 0U));
+
+  while (ptr < desc->wTotalLength)
+  {
+    pdesc = USBD_GetNextDesc((uint8_t *)pdesc, &ptr);
+
+    if (pdesc->bDescriptorType == USB_DESC_TYPE_ENDPOINT)
+    {
+      USBD_EpDescTypeDef *pEpDesc = (USBD_EpDescTypeDef *)(void *)pdesc;
+      uint8_t ep_addr = pEpDesc->bEndpointAddress;
+      uint8_t out = ((ep_addr & 0x80U) == 0U) ? 1U : 0U;
+      uint16_t mps = pEpDesc->wMaxPacketSize;
+
+      if ((ep_addr & EP_ADDR_MSK) >= hpcd->Init.dev_endpoints)
+      {
+        Error_Handler();
+      }
+
+      if ((pEpDesc->bmAttributes & 0x03U) == USBD_EP_TYPE_BULK)
+      {
+        uint32_t buf0 = PMA_Alloc(&next, mps, out);
+        uint32_t buf1 = PMA_Alloc(&next, mps, out);
+
+        HAL_PCDEx_PMAConfig(hpcd, ep_addr, PCD_DBL_BUF, buf0 | (buf1 << 16));
+      }
+      else
+      {
+        HAL_PCDEx_PMAConfig(hpcd, ep_addr, PCD_SNG_BUF, PMA_Alloc(&next, mps, out));
+      }
+    }
+  }
+}
+
 /* USER CODE END 0 */
 
 /* Exported function prototypes ----------------------------------------------*/
@@ -147,11 +238,11 @@ void HAL_PCD_SetupStageCallback(PCD_HandleTypeDef *hpcd)
 #endif /* USE_HAL_PCD_REGISTER_CALLBACKS */
 {
   /* USER CODE BEGIN HAL_PCD_SetupStageCallback_PreTreatment */
-
+  MTP_TRACE_ENTER(TRACE_USB_SETUP, ((uint8_t *)hpcd->Setup)[0] | (((uint8_t *)hpcd->Setup)[1] << 8), 0);
   /* USER CODE END  HAL_PCD_SetupStageCallback_PreTreatment */
   USBD_LL_SetupStage((USBD_HandleTypeDef*)hpcd->pData, (uint8_t *)hpcd->Setup);
   /* USER CODE BEGIN HAL_PCD_SetupStageCallback_PostTreatment */
-
+  MTP_TRACE_EXIT(TRACE_USB_SETUP, 0, 0);
   /* USER CODE END  HAL_PCD_SetupStageCallback_PostTreatment */
 }
 
@@ -168,11 +259,11 @@ void HAL_PCD_DataOutStageCallback(PCD_HandleTypeDef *hpcd, uint8_t epnum)
 #endif /* USE_HAL_PCD_REGISTER_CALLBACKS */
 {
   /* USER CODE BEGIN HAL_PCD_DataOutStageCallback_PreTreatment */
-
+  MTP_TRACE_ENTER(TRACE_USB_DATAOUT, epnum, hpcd->OUT_ep[epnum].xfer_count);
   /* USER CODE END HAL_PCD_DataOutStageCallback_PreTreatment */
   USBD_LL_DataOutStage((USBD_HandleTypeDef*)hpcd->pData, epnum, hpcd->OUT_ep[epnum].xfer_buff);
   /* USER CODE BEGIN HAL_PCD_DataOutStageCallback_PostTreatment */
-
+  MTP_TRACE_EXIT(TRACE_USB_DATAOUT, epnum, 0);
   /* USER CODE END HAL_PCD_DataOutStageCallback_PostTreatment */
 }
 
@@ -189,11 +280,11 @@ void HAL_PCD_DataInStageCallback(PCD_HandleTypeDef *hpcd, uint8_t epnum)
 #endif /* USE_HAL_PCD_REGISTER_CALLBACKS */
 {
   /* USER CODE BEGIN HAL_PCD_DataInStageCallback_PreTreatment */
-
+  MTP_TRACE_ENTER(TRACE_USB_DATAIN, epnum, hpcd->IN_ep[epnum].xfer_count);
   /* USER CODE END HAL_PCD_DataInStageCallback_PreTreatment */
   USBD_LL_DataInStage((USBD_HandleTypeDef*)hpcd->pData, epnum, hpcd->IN_ep[epnum].xfer_buff);
   /* USER CODE BEGIN HAL_PCD_DataInStageCallback_PostTreatment  */
-
+  MTP_TRACE_EXIT(TRACE_USB_DATAIN, epnum, 0);
   /* USER CODE END HAL_PCD_DataInStageCallback_PostTreatment */
 }
 
@@ -447,17 +538,15 @@ USBD_StatusTypeDef USBD_LL_Init(USBD_HandleTypeDef *pdev)
   /* USER CODE END RegisterCallBackSecondPart */
 #endif /* USE_HAL_PCD_REGISTER_CALLBACKS */
   /* USER CODE BEGIN EndPoint_Configuration */
-//  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , 0x00 , PCD_SNG_BUF, 0x18);
-//  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , 0x80 , PCD_SNG_BUF, 0x58);
-  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData, 0x00, PCD_SNG_BUF, 0x10);
-  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData, 0x80, PCD_SNG_BUF, 0x50);
+  {
+    uint16_t len;
+
+    /* The class is not registered yet at this point, take its descriptor directly */
+    PMA_Layout((PCD_HandleTypeDef*)pdev->pData, PMA_CLASS.GetFSConfigDescriptor(&len));
+  }
   /* USER CODE END EndPoint_Configuration */
   /* USER CODE BEGIN EndPoint_Configuration_MSC */
-//  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , 0x81 , PCD_SNG_BUF, 0x98);
-//  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , 0x01 , PCD_SNG_BUF, 0xD8);
-  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData, MTP_EPIN_ADDR, PCD_SNG_BUF, 0x90);
-  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData, MTP_EPOUT_ADDR, PCD_SNG_BUF, 0xD0);
-  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData, MTP_EP2IN_ADDR, PCD_SNG_BUF, 0x110);
+
   /* USER CODE END EndPoint_Configuration_MSC */
   return USBD_OK;
 }
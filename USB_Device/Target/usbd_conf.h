@@ -76,8 +76,20 @@
 #define USBD_LPM_ENABLED     1U
 /*---------- -----------*/
 #define USBD_SELF_POWERED     1U
+/*---------- Register the mass storage class instead of MTP -----------*/
+#ifndef USBD_USE_MSC
+#define USBD_USE_MSC     0U
+#endif
 /*---------- -----------*/
 #define MSC_MEDIA_PACKET     512U
+/*---------- -----------*/
+#define MSC_STAGE_SIZE     16384U
+/*---------- -----------*/
+#define MSC_WRITE_WINDOW     16384U
+/*---------- -----------*/
+#define MSC_UNMAP_MAX_BLOCKS     65536U
+/*---------- -----------*/
+#define MTP_MEDIA_PACKET     8192U
 
 /****************************************/
 /* #define for FS and HS identification */